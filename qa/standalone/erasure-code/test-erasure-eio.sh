@@ -353,6 +353,76 @@ function TEST_rados_get_with_subreadall_eio_shard_1() {
     delete_erasure_coded_pool $poolname
 }
 
+# inject eio into a shard of an object on a bluestore OSD
+function inject_bluestore_eio() {
+    local poolname=$1
+    shift
+    local objname=$1
+    shift
+    local shard_id=$1
+
+    local -a initial_osds=($(get_osds $poolname $objname))
+    local osd_id=${initial_osds[$shard_id]}
+    set_config osd $osd_id bluestore_debug_inject_read_err true || return 1
+    local loop=0
+    while ( CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$osd_id) \
+             injectdataerr $poolname $objname $shard_id | grep -q Invalid ); do
+        loop=$(expr $loop + 1)
+        if [ $loop = "10" ]; then
+            return 1
+        fi
+        sleep 1
+    done
+}
+
+#
+# Partial reads (osd_ec_partial_reads) on a pool with overwrites: a shard
+# read error makes the primary plan the read again from the shards left,
+# and the read is accounted as degraded.
+#
+function TEST_rados_get_partial_subread_eio() {
+    local dir=$1
+
+    for id in $(seq 0 3) ; do
+        run_osd_bluestore $dir $id || return 1
+    done
+    wait_for_clean || return 1
+
+    local poolname=pool-jerasure
+    create_erasure_coded_pool $poolname 2 1 || return 1
+    ceph osd pool set $poolname allow_ec_overwrites true || return 1
+
+    local objname=obj-partial-eio-$$
+    rados_put $dir $poolname $objname || return 1
+    local -a osds=($(get_osds $poolname $objname))
+    local primary=${osds[0]}
+
+    inject_bluestore_eio $poolname $objname 1 || return 1
+    rados_get $dir $poolname $objname || return 1
+    local degraded=$(CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$primary) \
+        dump_ec_read_stats | \
+        jq '[.. | objects | select(has("degraded_reads")) | .degraded_reads] | add')
+    test "$degraded" -gt 0 || return 1
+
+    # Now 2 out of 3 shards get an error, so should fail
+    inject_bluestore_eio $poolname $objname 2 || return 1
+    rados_get $dir $poolname $objname fail || return 1
+    rm $dir/ORIGINAL
+
+    # the stats go away with the pool
+    delete_erasure_coded_pool $poolname
+    local loop=0
+    while test "$(CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.$primary) \
+        dump_ec_read_stats | \
+        jq '[.. | objects | select(has("pool_id"))] | length')" != "0" ; do
+        loop=$(expr $loop + 1)
+        if [ $loop = "10" ]; then
+            return 1
+        fi
+        sleep 1
+    done
+}
+
 # Test recovery the object attr read error
 function TEST_ec_object_attr_read_error() {
     local dir=$1
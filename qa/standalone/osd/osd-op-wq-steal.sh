@@ -0,0 +1,82 @@
+#!/usr/bin/env bash
+#
+# Check the op queue work stealing counters reported by dump_op_pq_state
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7148" # git grep '\<7148\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+# sum a per shard field of dump_op_pq_state
+function pq_state_sum() {
+    local field=$1
+
+    CEPH_ARGS='' ceph --admin-daemon $(get_asok_path osd.0) dump_op_pq_state | \
+        jq "[.. | objects | select(has(\"$field\")) | .$field] | add"
+}
+
+function TEST_op_wq_steal() {
+    local dir=$1
+
+    run_mon $dir a --osd_pool_default_size=1 || return 1
+    run_mgr $dir x || return 1
+    # keep the shards' own threads busy so that the queues build up
+    run_osd $dir 0 --osd_op_num_shards=4 --osd_op_num_threads_per_shard=1 \
+        --osd_op_queue_work_stealing=true --osd_op_queue_steal_min_depth=1 \
+        --osd_debug_inject_dispatch_delay_probability=0.5 \
+        --osd_debug_inject_dispatch_delay_duration=0.01 || return 1
+
+    create_pool steal 16 || return 1
+    wait_for_clean || return 1
+
+    test "$(pq_state_sum queue_depth)" = "0" || return 1
+    rados -p steal bench 10 write -b 4096 -t 64 --no-cleanup || return 1
+    wait_for_clean || return 1
+
+    local steals=$(pq_state_sum steals)
+    local stolen=$(pq_state_sum stolen)
+    echo "steals $steals stolen $stolen"
+    # every item taken from a shard was taken by another one
+    test "$steals" = "$stolen" || return 1
+    test "$steals" -gt 0 || return 1
+    test "$(ceph daemon osd.0 perf dump | jq '.osd.op_wq_steal')" = "$steals" || return 1
+    # and nothing is left behind once the load is gone
+    test "$(pq_state_sum queue_depth)" = "0" || return 1
+
+    # with stealing disabled the counters stay put
+    ceph tell osd.0 injectargs --osd_op_queue_work_stealing=false || return 1
+    rados -p steal bench 5 write -b 4096 -t 64 --no-cleanup || return 1
+    test "$(pq_state_sum steals)" = "$steals" || return 1
+    test "$(pq_state_sum stolen)" = "$stolen" || return 1
+}
+
+main osd-op-wq-steal "$@"
+
+# Local Variables:
+# compile-command: "cd ../.. ; make -j4 && ../qa/run-standalone.sh osd-op-wq-steal.sh"
+# End:
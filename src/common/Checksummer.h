@@ -4,6 +4,7 @@
 #ifndef CEPH_OS_BLUESTORE_CHECKSUMMER
 #define CEPH_OS_BLUESTORE_CHECKSUMMER
 
+#include "include/buffer.h"
 #include "xxHash/xxhash.h"
 
 class Checksummer {
@@ -86,6 +87,14 @@ public:
       ) {
       return p.crc32c(len, init_value);
     }
+    static value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len);
+    }
   };
 
   struct crc32c_16 {
@@ -107,6 +116,14 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xffff;
     }
+    static value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xffff;
+    }
   };
 
   struct crc32c_8 {
@@ -128,6 +145,14 @@ public:
       ) {
       return p.crc32c(len, init_value) & 0xff;
     }
+    static value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return ceph_crc32c(init_value, (const unsigned char*)data, len) & 0xff;
+    }
   };
 
   struct xxhash32 {
@@ -157,6 +182,14 @@ public:
       }
       return XXH32_digest(state);
     }
+    static value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH32(data, len, init_value);
+    }
   };
 
   struct xxhash64 {
@@ -186,8 +219,52 @@ public:
       }
       return XXH64_digest(state);
     }
+    static value_t calc(
+      state_t state,
+      init_value_t init_value,
+      size_t len,
+      const char *data
+      ) {
+      return XXH64(data, len, init_value);
+    }
   };
 
+  /// Walk length bytes from p in csum_block_size blocks, passing the
+  /// checksum of each to f until it returns false.  Runs of whole blocks
+  /// within one contiguous segment are hashed straight from memory (and
+  /// with the one-shot xxhash variants); only blocks that straddle a
+  /// segment boundary go through the iterator.
+  template<class Alg, class F>
+  static void _for_each_block(
+    typename Alg::state_t state,
+    typename Alg::init_value_t init_value,
+    size_t csum_block_size,
+    size_t length,
+    bufferlist::const_iterator& p,
+    F&& f) {
+    while (length > 0) {
+      const char *data;
+      auto q = p;
+      size_t l = q.get_ptr_and_advance(length, &data);
+      size_t whole = l - l % csum_block_size;
+      if (!whole) {
+	length -= csum_block_size;
+	if (!f(Alg::calc(state, init_value, csum_block_size, p))) {
+	  return;
+	}
+	continue;
+      }
+      p.advance(whole);
+      length -= whole;
+      for (const char *end = data + whole; data < end;
+	   data += csum_block_size) {
+	if (!f(Alg::calc(state, init_value, csum_block_size, data))) {
+	  return;
+	}
+      }
+    }
+  }
+
   template<class Alg>
   static int calculate(
     size_t csum_block_size,
@@ -221,10 +298,12 @@ public:
     typename Alg::value_t *pv =
       reinterpret_cast<typename Alg::value_t*>(csum_data->c_str());
     pv += offset / csum_block_size;
-    while (blocks--) {
-      *pv = Alg::calc(state, init_value, csum_block_size, p);
-      ++pv;
-    }
+    _for_each_block<Alg>(
+      state, init_value, csum_block_size, blocks * csum_block_size, p,
+      [&pv](typename Alg::value_t v) {
+	*pv++ = v;
+	return true;
+      });
     Alg::fini(&state);
     return 0;
   }
@@ -249,21 +328,23 @@ public:
       reinterpret_cast<const typename Alg::value_t*>(csum_data.c_str());
     pv += offset / csum_block_size;
     size_t pos = offset;
-    while (length > 0) {
-      typename Alg::value_t v = Alg::calc(state, -1, csum_block_size, p);
-      if (*pv != v) {
-	if (bad_csum) {
-	  *bad_csum = v;
+    int bad_pos = -1;
+    _for_each_block<Alg>(
+      state, -1, csum_block_size, length, p,
+      [&](typename Alg::value_t v) {
+	if (*pv != v) {
+	  if (bad_csum) {
+	    *bad_csum = v;
+	  }
+	  bad_pos = pos;
+	  return false;
 	}
-	Alg::fini(&state);
-	return pos;
-      }
-      ++pv;
-      pos += csum_block_size;
-      length -= csum_block_size;
-    }
+	++pv;
+	pos += csum_block_size;
+	return true;
+      });
     Alg::fini(&state);
-    return -1;  // no errors
+    return bad_pos;  // -1 if no errors
   }
 };
 
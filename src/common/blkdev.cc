@@ -215,6 +215,29 @@ bool block_device_is_rotational(const char *devname)
   return get_block_device_int_property(devname, "queue/rotational") > 0;
 }
 
+int block_device_numa_node(const char *devname)
+{
+  // nvme namespaces hang off the controller, whose parent is the pci
+  // device; for scsi disks the attribute is one level further up
+  char buf[32];
+  int r = get_block_device_string_property(devname, "device/numa_node",
+					   buf, sizeof(buf));
+  if (r < 0) {
+    r = get_block_device_string_property(devname, "device/device/numa_node",
+					 buf, sizeof(buf));
+  }
+  if (r < 0) {
+    return r;
+  }
+  char *end = nullptr;
+  long node = strtol(buf, &end, 10);
+  if (end == buf || node < 0) {
+    // -1 means the platform did not report a node
+    return -ENOENT;
+  }
+  return node;
+}
+
 int block_device_vendor(const char *devname, char *vendor, size_t max)
 {
   return get_block_device_string_property(devname, "device/vendor", vendor, max);
@@ -469,6 +492,11 @@ bool block_device_is_rotational(const char *devname)
   return false;
 }
 
+int block_device_numa_node(const char *devname)
+{
+  return -EOPNOTSUPP;
+}
+
 void get_dm_parents(const std::string& dev, std::set<std::string> *ls)
 {
 }
@@ -514,6 +542,11 @@ bool block_device_is_rotational(const char *devname)
   return false;
 }
 
+int block_device_numa_node(const char *devname)
+{
+  return -EOPNOTSUPP;
+}
+
 int get_device_by_fd(int fd, char *partition, char *device, size_t max)
 {
   return -EOPNOTSUPP;
@@ -565,6 +598,11 @@ bool block_device_is_rotational(const char *devname)
   return false;
 }
 
+int block_device_numa_node(const char *devname)
+{
+  return -EOPNOTSUPP;
+}
+
 int get_device_by_fd(int fd, char *partition, char *device, size_t max)
 {
   return -EOPNOTSUPP;
@@ -23,6 +23,8 @@ extern int64_t get_block_device_string_property(
 	char *val, size_t maxlen);
 extern bool block_device_support_discard(const char *devname);
 extern bool block_device_is_rotational(const char *devname);
+/// NUMA node the device is attached to, or negative error
+extern int block_device_numa_node(const char *devname);
 extern int block_device_vendor(const char *devname, char *vendor, size_t max);
 extern int block_device_model(const char *devname, char *model, size_t max);
 extern int block_device_serial(const char *devname, char *serial, size_t max);
@@ -636,6 +636,8 @@ OPTION(osd_op_num_shards_ssd, OPT_INT)
 OPTION(osd_op_queue, OPT_STR)
 
 OPTION(osd_op_queue_cut_off, OPT_STR) // Min priority to go to strict queue. (low, high)
+OPTION(osd_op_queue_work_stealing, OPT_BOOL)
+OPTION(osd_op_queue_steal_min_depth, OPT_U64)
 
 // mClock priority queue parameters for five types of ops
 OPTION(osd_op_queue_mclock_client_op_res, OPT_DOUBLE)
@@ -668,6 +670,11 @@ OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL) // do not assert on divergen
 // decode the object, any error will be reported.
 OPTION(osd_read_ec_check_for_errors, OPT_BOOL) // return error if any ec shard has an error
 
+// update the parity of small overwrites with a delta instead of a
+// full stripe read-modify-write, if the plugin supports it
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL)
+OPTION(osd_ec_partial_reads, OPT_BOOL)
+
 // Only use clone_overlap for recovery if there are fewer than
 // osd_recover_clone_overlap_limit entries in the overlap set
 OPTION(osd_recover_clone_overlap_limit, OPT_INT)
@@ -938,6 +945,8 @@ OPTION(objectstore_blackhole, OPT_BOOL)
 
 OPTION(bluefs_alloc_size, OPT_U64)
 OPTION(bluefs_max_prefetch, OPT_U64)
+OPTION(bluefs_readahead_max, OPT_U64)
+OPTION(bluefs_readahead_total_max, OPT_U64)
 OPTION(bluefs_min_log_runway, OPT_U64)  // alloc when we get this low
 OPTION(bluefs_max_log_runway, OPT_U64)  // alloc this much at a time
 OPTION(bluefs_log_compact_min_ratio, OPT_FLOAT)      // before we consider
@@ -946,7 +955,7 @@ OPTION(bluefs_min_flush_size, OPT_U64)  // ignore flush until its this big
 OPTION(bluefs_compact_log_sync, OPT_BOOL)  // sync or async log compaction?
 OPTION(bluefs_buffered_io, OPT_BOOL)
 OPTION(bluefs_sync_write, OPT_BOOL)
-OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap | avl
 OPTION(bluefs_preextend_wal_files, OPT_BOOL)  // this *requires* that rocksdb has recycling enabled
 
 OPTION(bluestore_bluefs, OPT_BOOL)
@@ -1005,6 +1014,8 @@ OPTION(bluestore_gc_enable_blob_threshold, OPT_INT)
  * 
  */
 OPTION(bluestore_gc_enable_total_threshold, OPT_INT)  
+OPTION(bluestore_defrag_extent_threshold, OPT_U64)
+OPTION(bluestore_defrag_max_bytes_per_sec, OPT_U64)
 
 OPTION(bluestore_max_blob_size, OPT_U32)
 OPTION(bluestore_max_blob_size_hdd, OPT_U32)
@@ -1022,7 +1033,7 @@ OPTION(bluestore_extent_map_shard_target_size_slop, OPT_DOUBLE)
 OPTION(bluestore_extent_map_inline_shard_prealloc_size, OPT_U32)
 OPTION(bluestore_cache_trim_interval, OPT_DOUBLE)
 OPTION(bluestore_cache_trim_max_skip_pinned, OPT_U32) // skip this many onodes pinned in cache before we give up
-OPTION(bluestore_cache_type, OPT_STR)   // lru, 2q
+OPTION(bluestore_cache_type, OPT_STR)   // lru, 2q, clock
 OPTION(bluestore_2q_cache_kin_ratio, OPT_DOUBLE)    // kin page slot size / max page slot size
 OPTION(bluestore_2q_cache_kout_ratio, OPT_DOUBLE)   // number of kout page slot / total number of page slot
 OPTION(bluestore_cache_size, OPT_U64)
@@ -1031,7 +1042,7 @@ OPTION(bluestore_cache_size_ssd, OPT_U64)
 OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE)
 OPTION(bluestore_kvbackend, OPT_STR)
-OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap | avl
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT)
 OPTION(bluestore_bitmapallocator_blocks_per_zone, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_bitmapallocator_span_size, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
@@ -1056,6 +1067,7 @@ OPTION(bluestore_nid_prealloc, OPT_INT)
 OPTION(bluestore_blobid_prealloc, OPT_U64)
 OPTION(bluestore_clone_cow, OPT_BOOL)  // do copy-on-write for clones
 OPTION(bluestore_default_buffered_read, OPT_BOOL)
+OPTION(bluestore_cache_decompressed, OPT_BOOL)
 OPTION(bluestore_default_buffered_write, OPT_BOOL)
 OPTION(bluestore_debug_misc, OPT_BOOL)
 OPTION(bluestore_debug_no_reuse_blocks, OPT_BOOL)
@@ -1072,6 +1084,14 @@ OPTION(bluestore_debug_permit_any_bdev_label, OPT_BOOL)
 OPTION(bluestore_debug_random_read_err, OPT_DOUBLE)
 OPTION(bluestore_debug_inject_bug21040, OPT_BOOL)
 OPTION(bluestore_debug_inject_csum_err_probability, OPT_FLOAT)
+OPTION(bluestore_bulk_remove_rmrange_min_keys, OPT_U64)
+OPTION(bluestore_bulk_remove_compact, OPT_BOOL)
+OPTION(bluestore_tier_max_object_size, OPT_U64)
+OPTION(bluestore_tier_promote_reads, OPT_U64)
+OPTION(bluestore_tier_max_bytes, OPT_U64)
+OPTION(bluestore_tier_db_min_free_ratio, OPT_FLOAT)
+OPTION(bluestore_tier_demote_age, OPT_FLOAT)
+OPTION(bluestore_tier_interval, OPT_FLOAT)
 
 OPTION(kstore_max_ops, OPT_U64)
 OPTION(kstore_max_bytes, OPT_U64)
@@ -0,0 +1,165 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "numa.h"
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+
+#include "include/stringify.h"
+#include "common/safe_io.h"
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+int parse_cpu_set_list(const char *s,
+		       size_t *cpu_set_size,
+		       cpu_set_t *cpu_set)
+{
+  CPU_ZERO(cpu_set);
+  *cpu_set_size = 0;
+  while (*s) {
+    char *end;
+    int a = strtol(s, &end, 10);
+    if (end == s || a < 0 || a >= CPU_SETSIZE) {
+      return -EINVAL;
+    }
+    if (*end == '-') {
+      s = end + 1;
+      int b = strtol(s, &end, 10);
+      if (end == s || b < a || b >= CPU_SETSIZE) {
+	return -EINVAL;
+      }
+      for (int i = a; i <= b; ++i) {
+	CPU_SET(i, cpu_set);
+      }
+      a = b;
+    } else {
+      CPU_SET(a, cpu_set);
+    }
+    *cpu_set_size = std::max<size_t>(*cpu_set_size, a + 1);
+    if (*end == 0 || *end == '\n') {
+      break;
+    }
+    if (*end != ',') {
+      return -EINVAL;
+    }
+    s = end + 1;
+  }
+  return 0;
+}
+
+std::string cpu_set_to_str_list(size_t cpu_set_size,
+				const cpu_set_t *cpu_set)
+{
+  std::string r;
+  unsigned a = 0;
+  while (true) {
+    while (a < cpu_set_size && !CPU_ISSET(a, cpu_set)) {
+      ++a;
+    }
+    if (a >= cpu_set_size) {
+      break;
+    }
+    unsigned b = a + 1;
+    while (b < cpu_set_size && CPU_ISSET(b, cpu_set)) {
+      ++b;
+    }
+    if (r.size()) {
+      r += ",";
+    }
+    if (b > a + 1) {
+      r += stringify(a) + "-" + stringify(b - 1);
+    } else {
+      r += stringify(a);
+    }
+    a = b;
+  }
+  return r;
+}
+
+int get_numa_node_cpu_set(
+  int node,
+  size_t *cpu_set_size,
+  cpu_set_t *cpu_set)
+{
+  std::string fn = "/sys/devices/system/node/node";
+  fn += stringify(node);
+  fn += "/cpulist";
+  int fd = ::open(fn.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -errno;
+  }
+  char buf[1024];
+  int r = safe_read(fd, &buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (r < 0) {
+    return r;
+  }
+  buf[r] = 0;
+  return parse_cpu_set_list(buf, cpu_set_size, cpu_set);
+}
+
+int set_cpu_affinity_all_threads(size_t cpu_set_size, cpu_set_t *cpu_set)
+{
+  int pid = getpid();
+  std::string path = "/proc/" + stringify(pid) + "/task";
+  DIR *d = opendir(path.c_str());
+  if (!d) {
+    return -errno;
+  }
+  int r = 0;
+  struct dirent *de;
+  while ((de = ::readdir(d))) {
+    if (de->d_name[0] == '.') {
+      continue;
+    }
+    int tid = atoi(de->d_name);
+    if (!tid) {
+      continue;
+    }
+    if (sched_setaffinity(tid, sizeof(*cpu_set), cpu_set) < 0) {
+      r = -errno;
+      break;
+    }
+  }
+  closedir(d);
+  return r;
+}
+
+#else
+
+int parse_cpu_set_list(const char *s,
+		       size_t *cpu_set_size,
+		       cpu_set_t *cpu_set)
+{
+  return -ENOTSUP;
+}
+
+std::string cpu_set_to_str_list(size_t cpu_set_size,
+				const cpu_set_t *cpu_set)
+{
+  return {};
+}
+
+int get_numa_node_cpu_set(int node,
+			  size_t *cpu_set_size,
+			  cpu_set_t *cpu_set)
+{
+  return -ENOTSUP;
+}
+
+int set_cpu_affinity_all_threads(size_t cpu_set_size,
+				 cpu_set_t *cpu_set)
+{
+  return -ENOTSUP;
+}
+
+#endif
@@ -0,0 +1,26 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <sched.h>
+#include <string>
+
+/// parse a cpu list as found in sysfs (e.g., "0-3,8,10-11")
+int parse_cpu_set_list(const char *s,
+		       size_t *cpu_set_size,
+		       cpu_set_t *cpu_set);
+
+/// format a cpu set in the same list format
+std::string cpu_set_to_str_list(size_t cpu_set_size,
+				const cpu_set_t *cpu_set);
+
+/// the cpus that belong to a NUMA node
+int get_numa_node_cpu_set(int node,
+			  size_t *cpu_set_size,
+			  cpu_set_t *cpu_set);
+
+/// set the affinity of every thread in this process (threads created
+/// later inherit it from their creator)
+int set_cpu_affinity_all_threads(size_t cpu_set_size,
+				 cpu_set_t *cpu_set);
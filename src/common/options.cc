@@ -2377,6 +2377,20 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_STARTUP)
     .set_description(""),
 
+    Option("osd_numa_node", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+    .set_default(-1)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Run the OSD's threads on the CPUs of this NUMA node")
+    .set_long_description("A negative value means no explicit node; see osd_numa_auto_affinity.")
+    .add_see_also({"osd_numa_auto_affinity"}),
+
+    Option("osd_numa_auto_affinity", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Run the OSD's threads on the NUMA node of its storage devices")
+    .set_long_description("If all of the object store's devices are attached to the same NUMA node, restrict the op shard, object store (kv sync/finalize, aio) and messenger threads to that node's CPUs.  Memory for caches is then allocated from the local node as well.")
+    .add_see_also({"osd_numa_node"}),
+
     Option("osd_op_num_shards", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_flag(Option::FLAG_STARTUP)
@@ -2411,6 +2425,18 @@ std::vector<Option> get_global_options() {
     .set_long_description("the threshold between high priority ops that use strict priority ordering and low priority ops that use a fairness algorithm that may or may not incorporate priority")
     .add_see_also("osd_op_queue"),
 
+    Option("osd_op_queue_work_stealing", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("let idle op shard threads process items queued on busy shards")
+    .set_long_description("When a shard has nothing queued, its threads take the next item of the shard with the deepest queue, if that is at least osd_op_queue_steal_min_depth. The item is still ordered through the PG slot of the shard it was queued on, so per PG ordering is preserved, and it is left to that shard if its PG is already being processed there.")
+    .add_see_also("osd_op_queue_steal_min_depth"),
+
+    Option("osd_op_queue_steal_min_depth", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("queue depth of a shard above which idle shards take work from it")
+    .add_see_also("osd_op_queue_work_stealing"),
+
     Option("osd_op_queue_mclock_client_op_res", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(1000.0)
     .set_description("mclock reservation of client operator requests")
@@ -2867,6 +2893,59 @@ std::vector<Option> get_global_options() {
     .add_see_also("osd_op_queue_mclock_scrub_res")
     .add_see_also("osd_op_queue_mclock_scrub_wgt"),
 
+    Option("osd_mclock_profile", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("custom")
+    .set_enum_allowed({"custom", "high_client_ops", "balanced",
+	  "high_recovery_ops"})
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("mclock profile used to split the device between client ops and background work")
+    .set_long_description("when osd_op_queue is either 'mclock_opclass' or 'mclock_client', 'high_client_ops', 'balanced' and 'high_recovery_ops' set the reservation, weight and limit of client ops, recovery/backfill and the other background work (scrub, snap trim, pg deletion) relative to the device capacity implied by the cost model, and disable the recovery, scrub and snap trim sleeps; 'custom' uses the osd_op_queue_mclock_* settings")
+    .add_see_also("osd_op_queue")
+    .add_see_also("osd_mclock_cost_per_io_usec")
+    .add_see_also("osd_mclock_cost_per_byte_usec"),
+
+    Option("osd_mclock_cost_per_io_usec", Option::TYPE_FLOAT, Option::LEVEL_DEV)
+    .set_default(0.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken by a small random IO, in microseconds (overrides _ssd and _hdd if non-zero)")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_cost_per_io_usec_hdd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(5000.0)
+    .set_min(1.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken by a small random IO on rotational media, in microseconds")
+    .set_long_description("the mclock cost of an op is one plus its size multiplied by osd_mclock_cost_per_byte_usec and divided by this value, i.e. the number of small random IOs the op is worth; the inverse of this value is also the device capacity used by the mclock profiles")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_cost_per_io_usec_ssd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(50.0)
+    .set_min(1.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken by a small random IO on solid state media, in microseconds")
+    .set_long_description("the mclock cost of an op is one plus its size multiplied by osd_mclock_cost_per_byte_usec and divided by this value, i.e. the number of small random IOs the op is worth; the inverse of this value is also the device capacity used by the mclock profiles")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_cost_per_byte_usec", Option::TYPE_FLOAT, Option::LEVEL_DEV)
+    .set_default(0.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken to transfer a byte, in microseconds (overrides _ssd and _hdd if non-zero)")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_cost_per_byte_usec_hdd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.0067)
+    .set_min(0.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken to transfer a byte on rotational media, in microseconds")
+    .add_see_also("osd_mclock_cost_per_io_usec_hdd"),
+
+    Option("osd_mclock_cost_per_byte_usec_ssd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.002)
+    .set_min(0.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("device time taken to transfer a byte on solid state media, in microseconds")
+    .add_see_also("osd_mclock_cost_per_io_usec_ssd"),
+
     Option("osd_ignore_stale_divergent_priors", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -2875,6 +2954,16 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_parity_delta_writes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Apply small EC overwrites with a parity delta")
+    .set_long_description("When a partial stripe overwrite only touches a few data chunks and the plugin supports it, read back those chunks and the coding chunks and update the parity with the difference instead of reading and re-encoding the whole stripe."),
+
+    Option("osd_ec_partial_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Read only the needed chunk ranges for EC client reads")
+    .set_long_description("Instead of reading the whole stripes covering a client read, read from each shard only the page aligned ranges that back the requested bytes. When a shard is unavailable, only the missing ranges are decoded. Applies to pools with allow_ec_overwrites whose plugin supports parity delta updates."),
+
     Option("osd_recover_clone_overlap_limit", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description(""),
@@ -3460,6 +3549,11 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("memdb_persist", Option::TYPE_BOOL, Option::LEVEL_DEV)
+    .set_default(true)
+    .set_description("Save memdb contents to a file on close and load them on open")
+    .set_long_description("When false, memdb is purely ephemeral: nothing is written at shutdown and a reopened db starts out empty."),
+
     Option("kinetic_host", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
     .set_description(""),
@@ -3504,6 +3598,12 @@ std::vector<Option> get_global_options() {
     .set_default(4_K)
     .set_description(""),
 
+    Option("rocksdb_perf_prefixes", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("O M P L")
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Key prefixes to keep separate per-prefix rocksdb counters for")
+    .set_long_description("Each listed prefix (column family) gets its own rocksdb_prefix_<prefix> perf counters for op counts, bytes, get latency and iterator seeks; all other prefixes are accounted under rocksdb_prefix_other.  The counters and get latency percentiles are also reported by the dump_kv_stats admin socket command.  An empty value disables per-prefix accounting."),
+
     Option("rocksdb_perf", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -3766,6 +3866,17 @@ std::vector<Option> get_global_options() {
     .set_default(16)
     .set_description(""),
 
+    Option("bdev_ioring", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Enables Linux io_uring API instead of libaio")
+    .set_long_description("Falls back to libaio if ceph was built without liburing or the running kernel does not support io_uring. The aio queue depth, poll interval and reap settings apply to both backends."),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use a kernel submission queue polling thread for io_uring")
+    .set_long_description("A kernel thread polls the submission queue, so that submitting IO does not require a system call.")
+    .add_see_also("bdev_ioring"),
+
     Option("bdev_block_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(4_K)
     .set_description(""),
@@ -3802,6 +3913,15 @@ std::vector<Option> get_global_options() {
     .set_default(1_M)
     .set_description(""),
 
+    Option("bluefs_readahead_max", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_M)
+    .set_description("Maximum read-ahead window for sequential random-access reads (0 disables)")
+    .set_long_description("Files opened for random access (rocksdb SSTs) detect sequential access, e.g. from compaction or iterator scans, and read ahead with a window that doubles up to this size.  The next window is prefetched asynchronously."),
+
+    Option("bluefs_readahead_total_max", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("Maximum memory held in read-ahead buffers across all bluefs readers"),
+
     Option("bluefs_min_log_runway", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(1_M)
     .set_description(""),
@@ -3836,6 +3956,7 @@ std::vector<Option> get_global_options() {
 
     Option("bluefs_allocator", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("bitmap")
+    .set_enum_allowed({"bitmap", "stupid", "avl"})
     .set_description(""),
 
     Option("bluefs_preextend_wal_files", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
@@ -4064,6 +4185,26 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description(""),
 
+    Option("bluestore_defrag_extent_threshold", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Rewrite objects when a single read touches at least this many logical extents (0 disables)")
+    .set_long_description("A read (including scrub) that walks this many logical extents marks the object as fragmented.  The next write to the object then rewrites its data into fresh, contiguous blobs as part of the same transaction.")
+    .add_see_also("bluestore_defrag_max_bytes_per_sec"),
+
+    Option("bluestore_defrag_max_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(16_M)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Max rate at which fragmented objects are rewritten")
+    .add_see_also("bluestore_defrag_extent_threshold"),
+
+    Option("bluestore_defrag_min_free_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Do not rewrite fragmented objects when less than this fraction of the device would be free afterwards")
+    .set_long_description("A rewrite allocates new space before the old extents are released, within the client's transaction.")
+    .add_see_also("bluestore_defrag_extent_threshold"),
+
     Option("bluestore_max_blob_size", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(0)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4115,8 +4256,13 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_cache_type", Option::TYPE_STR, Option::LEVEL_DEV)
     .set_default("2q")
-    .set_enum_allowed({"2q", "lru"})
-    .set_description("Cache replacement algorithm"),
+    .set_enum_allowed({"2q", "lru", "clock"})
+    .set_description("Cache replacement algorithm")
+    .set_long_description("clock uses a second-chance reference bit instead of reordering a list on each hit, which lets onode cache hits avoid the cache shard lock."),
+
+    Option("bluestore_cache_clock_trim_batch", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(64)
+    .set_description("Max cache entries the clock cache examines before dropping the shard lock while trimming"),
 
     Option("bluestore_2q_cache_kin_ratio", Option::TYPE_FLOAT, Option::LEVEL_DEV)
     .set_default(.5)
@@ -4172,9 +4318,14 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_allocator", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("bitmap")
-    .set_enum_allowed({"bitmap", "stupid"})
+    .set_enum_allowed({"bitmap", "stupid", "avl"})
     .set_description("Allocator policy"),
 
+    Option("bluestore_alloc_snapshot", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Persist allocator state on clean umount and load it on mount")
+    .set_long_description("Instead of rebuilding the allocator from the freelist at mount time, which can take a long time on large devices, load the free extents saved by the last clean umount. The saved state is discarded as soon as the store is mounted, so after an unclean shutdown the freelist is used. Versions without this feature refuse to mount a store carrying saved state, so disable it and mount once before downgrading."),
+
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(128)
     .set_description("Block (and bits) per database key"),
@@ -4187,6 +4338,18 @@ std::vector<Option> get_global_options() {
     .set_default(1024)
     .set_description(""),
 
+    Option("bluestore_avl_alloc_bf_threshold", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(131072)
+    .set_description("Sets threshold at which shrinking max free chunk size triggers enabling best-fit mode.")
+    .set_long_description("The AVL allocator places new extents first-fit starting from a per-size cursor. Once the largest free extent shrinks below this size it switches to best-fit lookups by extent size.")
+    .add_see_also("bluestore_avl_alloc_bf_free_pct"),
+
+    Option("bluestore_avl_alloc_bf_free_pct", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(4)
+    .set_description("Sets threshold at which shrinking free space (in %, integer) triggers enabling best-fit mode.")
+    .set_long_description("Once the free space of the AVL allocator drops below this percentage of the device it switches from first-fit to best-fit lookups by extent size.")
+    .add_see_also("bluestore_avl_alloc_bf_threshold"),
+
     Option("bluestore_max_deferred_txc", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(32)
     .set_description("Max transactions with deferred writes that can accumulate before we force flush deferred writes"),
@@ -4200,8 +4363,9 @@ std::vector<Option> get_global_options() {
     .set_description("Enable use of rocksdb column families for bluestore metadata"),
 
     Option("bluestore_rocksdb_cfs", Option::TYPE_STR, Option::LEVEL_DEV)
-    .set_default("M= P= L=")
-    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options"),
+    .set_default("O= M= P= L=")
+    .set_description("List of whitespace-separate key/value pairs where key is CF name and value is CF options")
+    .set_long_description("Each CF name is the bluestore key prefix it holds (O=onodes, M/P=omap, L=deferred writes).  The value is a rocksdb column family option string, e.g. to pick the compaction style or write buffer size; block_cache_ratio=<fraction> additionally gives the CF a private block cache of that fraction of rocksdb_cache_size.  Existing stores can be converted offline with ceph-bluestore-tool migrate-cf."),
 
     Option("bluestore_fsck_on_mount", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
@@ -4211,6 +4375,58 @@ std::vector<Option> get_global_options() {
     .set_default(true)
     .set_description("Run deep fsck at mount"),
 
+    Option("bluestore_tier", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Keep copies of small, frequently read objects on the block.db device")
+    .set_long_description("Small objects that are read often are copied into the kv store, which lives on the (fast) block.db device, and later reads are served from there.  Writes drop the copy in the same transaction.  Only used if a dedicated block.db device is present.")
+    .add_see_also({"bluestore_tier_max_object_size", "bluestore_tier_promote_reads", "bluestore_tier_max_bytes"}),
+
+    Option("bluestore_tier_max_object_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Largest object that can be copied to the block.db tier"),
+
+    Option("bluestore_tier_promote_reads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("Reads of a cached object before it is copied to the block.db tier"),
+
+    Option("bluestore_tier_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_G)
+    .set_description("Total size of object data kept on the block.db tier"),
+
+    Option("bluestore_tier_db_min_free_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.5)
+    .set_description("Only promote while at least this fraction of block.db is free"),
+
+    Option("bluestore_tier_demote_age", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(600)
+    .set_description("Seconds without a read after which an object leaves the block.db tier"),
+
+    Option("bluestore_tier_interval", Option::TYPE_FLOAT, Option::LEVEL_DEV)
+    .set_default(5)
+    .set_description("How often the tier thread looks for objects to demote"),
+
+    Option("bluestore_bulk_remove_rmrange_min_keys", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(64)
+    .set_description("Minimum omap keys for an object removed by a collection range removal to be dropped with a single range delete")
+    .set_long_description("Smaller omaps are removed key by key, since many small range tombstones slow down later reads more than point deletes do."),
+
+    Option("bluestore_bulk_remove_compact", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Compact the key ranges range-deleted by collection range removal once the collection is removed"),
+
+    Option("bluestore_fsck_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Number of threads used to read and verify object data during deep fsck"),
+
+    Option("bluestore_txc_trace_size", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("Number of recently finished transactions to keep per-state latencies for")
+    .set_long_description("The trace can be dumped with the dump_bluestore_txc_trace and dump_bluestore_txc_histograms admin socket commands.  0 disables tracing."),
+
     Option("bluestore_fsck_on_umount", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
     .set_description("Run fsck at umount"),
@@ -4272,6 +4488,17 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description("Default bluestore_deferred_batch_ops for non-rotational (solid state) media"),
 
+    Option("bluestore_deferred_batch_adaptive", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Adapt deferred write batching to observed device latency and queue depth")
+    .set_long_description("When enabled, bluestore_deferred_batch_ops is a base batch size that grows with the number of deferred batches in flight, and a partial batch is submitted once its oldest transaction has waited about as long as a recent batch took to complete (capped by bluestore_deferred_batch_max_wait).")
+    .add_see_also({"bluestore_deferred_batch_ops", "bluestore_deferred_batch_max_wait"}),
+
+    Option("bluestore_deferred_batch_max_wait", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_description("Max seconds a deferred write may wait to be batched when bluestore_deferred_batch_adaptive is enabled")
+    .add_see_also("bluestore_deferred_batch_adaptive"),
+
     Option("bluestore_nid_prealloc", Option::TYPE_INT, Option::LEVEL_DEV)
     .set_default(1024)
     .set_description("Number of unique object ids to preallocate at a time"),
@@ -4290,6 +4517,13 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description("Cache read results by default (unless hinted NOCACHE or WONTNEED)"),
 
+    Option("bluestore_cache_decompressed", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Cache decompressed blob data even if bluestore_default_buffered_read is false (unless hinted NOCACHE or WONTNEED)")
+    .set_long_description("Reading any part of a compressed blob decompresses the whole blob; keeping the result in the buffer cache avoids repeating that work for hot objects.")
+    .add_see_also("bluestore_default_buffered_read"),
+
     Option("bluestore_default_buffered_write", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_flag(Option::FLAG_RUNTIME)
@@ -120,6 +120,15 @@ namespace ceph {
     int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    bool supports_parity_delta() const override {
+      return false;
+    }
+
+    int apply_parity_delta(const std::map<int, bufferlist> &delta,
+			   std::map<int, bufferlist> *parity) override {
+      return -EOPNOTSUPP;
+    }
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      std::ostream *ss);
@@ -459,6 +459,38 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the plugin is able to update coding chunks
+     * incrementally with **apply_parity_delta**, i.e. if each coding
+     * chunk is a linear combination of the data chunks.
+     *
+     * @return **true** if **apply_parity_delta** is implemented
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Update the coding chunks found in **parity** so that they
+     * reflect a modification of some of the data chunks, without
+     * reading the data chunks that did not change.
+     *
+     * The **delta** map contains, for each modified data chunk, the
+     * XOR of its old and new content. The **parity** map must contain
+     * the old content of every coding chunk, i.e. the chunks with
+     * indexes from **get_data_chunk_count()** to
+     * **get_chunk_count()** - 1, and is updated in place.
+     *
+     * All buffers in **delta** and **parity** must have the same
+     * size.
+     *
+     * Returns 0 on success.
+     *
+     * @param [in] delta map data chunk indexes to old XOR new content
+     * @param [in,out] parity map coding chunk indexes to chunk data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_parity_delta(const std::map<int, bufferlist> &delta,
+				   std::map<int, bufferlist> *parity) = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -131,6 +131,51 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_parity_delta(const map<int, bufferlist> &delta,
+                                          map<int, bufferlist> *parity)
+{
+  if (delta.empty() || parity->size() != (unsigned) m)
+    return -EINVAL;
+  unsigned blocksize = delta.begin()->second.length();
+  unsigned char *coding[m];
+  vector<bufferptr> ptrs(m);
+  for (int j = 0; j < m; j++) {
+    auto p = parity->find(k + j);
+    if (p == parity->end() || p->second.length() != blocksize)
+      return -EINVAL;
+    ptrs[j] = buffer::create_aligned(blocksize, SIMD_ALIGN);
+    p->second.copy(0, blocksize, ptrs[j].c_str());
+    coding[j] = (unsigned char*) ptrs[j].c_str();
+  }
+  for (auto &&i : delta) {
+    if (i.first < 0 || i.first >= k || i.second.length() != blocksize)
+      return -EINVAL;
+    bufferlist d = i.second;
+    d.rebuild_aligned(SIMD_ALIGN);
+    unsigned char *src = (unsigned char*) d.c_str();
+    if (m == 1) {
+      // single parity stripe
+      unsigned char *data[2] = { coding[0], src };
+      bufferptr out(buffer::create_aligned(blocksize, SIMD_ALIGN));
+      region_xor(data, (unsigned char*) out.c_str(), 2, blocksize);
+      ptrs[0] = out;
+      coding[0] = (unsigned char*) out.c_str();
+    } else {
+      ec_encode_data_update(blocksize, k, m, i.first, encode_tbls,
+                            src, coding);
+    }
+  }
+  for (int j = 0; j < m; j++) {
+    bufferlist &bl = (*parity)[k + j];
+    bl.clear();
+    bl.push_back(ptrs[j]);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
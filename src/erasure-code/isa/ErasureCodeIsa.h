@@ -145,6 +145,14 @@ public:
 
   void prepare() override;
 
+  bool supports_parity_delta() const override
+  {
+    return true;
+  }
+
+  int apply_parity_delta(const std::map<int, bufferlist> &delta,
+                         std::map<int, bufferlist> *parity) override;
+
  private:
   int parse(ErasureCodeProfile &profile,
                     std::ostream *ss) override;
@@ -130,6 +130,61 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::matrix_parity_delta(const int *matrix,
+					     const map<int, bufferlist> &delta,
+					     map<int, bufferlist> *parity)
+{
+  // each coding chunk is a linear combination of the data chunks:
+  // parity[j] ^= matrix[j - k][i] * delta[i] for every modified chunk i
+  if (delta.empty() || parity->size() != (unsigned)m)
+    return -EINVAL;
+  unsigned blocksize = delta.begin()->second.length();
+  map<int, bufferptr> coding;
+  for (int j = k; j < k + m; j++) {
+    auto p = parity->find(j);
+    if (p == parity->end() || p->second.length() != blocksize)
+      return -EINVAL;
+    bufferptr ptr(buffer::create_aligned(blocksize, SIMD_ALIGN));
+    p->second.copy(0, blocksize, ptr.c_str());
+    coding[j] = ptr;
+  }
+  for (auto &&i : delta) {
+    if (i.first < 0 || i.first >= k || i.second.length() != blocksize)
+      return -EINVAL;
+    bufferlist d = i.second;
+    d.rebuild_aligned(SIMD_ALIGN);
+    char *src = d.c_str();
+    for (auto &&j : coding) {
+      int coef = matrix[(j.first - k) * k + i.first];
+      if (coef == 0)
+	continue;
+      if (coef == 1) {
+	galois_region_xor(src, j.second.c_str(), blocksize);
+	continue;
+      }
+      switch (w) {
+      case 8:
+	galois_w08_region_multiply(src, coef, blocksize, j.second.c_str(), 1);
+	break;
+      case 16:
+	galois_w16_region_multiply(src, coef, blocksize, j.second.c_str(), 1);
+	break;
+      case 32:
+	galois_w32_region_multiply(src, coef, blocksize, j.second.c_str(), 1);
+	break;
+      default:
+	return -EINVAL;
+      }
+    }
+  }
+  for (auto &&j : coding) {
+    bufferlist &bl = (*parity)[j.first];
+    bl.clear();
+    bl.push_back(j.second);
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
@@ -77,6 +77,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, std::ostream *ss);
+  int matrix_parity_delta(const int *matrix,
+			  const std::map<int, bufferlist> &delta,
+			  std::map<int, bufferlist> *parity);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -103,6 +106,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_parity_delta(const std::map<int, bufferlist> &delta,
+			 std::map<int, bufferlist> *parity) override {
+    return matrix_parity_delta(matrix, delta, parity);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -132,6 +142,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize) override;
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_parity_delta(const std::map<int, bufferlist> &delta,
+			 std::map<int, bufferlist> *parity) override {
+    return matrix_parity_delta(matrix, delta, parity);
+  }
   unsigned get_alignment() const override;
   void prepare() override;
 private:
@@ -21,6 +21,7 @@
 #include <set>
 #include <vector>
 #include <list>
+#include <deque>
 #include <mutex>
 #include <atomic>
 #include <typeinfo>
@@ -431,6 +432,9 @@ public:
     using list = std::list<v,pool_allocator<v>>;			\
                                                                         \
     template<typename v>						\
+    using deque = std::deque<v,pool_allocator<v>>;			\
+                                                                        \
+    template<typename v>						\
     using vector = std::vector<v,pool_allocator<v>>;			\
                                                                         \
     template<typename k, typename v,					\
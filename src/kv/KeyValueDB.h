@@ -137,6 +137,16 @@ public:
       const string &end        ///< [in] The start bound of remove keys
       ) = 0;
 
+    /// Removes keys in [start, end) with a single range tombstone, where
+    /// the backend has them, even if range deletes are off by default
+    virtual void rm_range_keys_bulk(
+      const string &prefix,    ///< [in] Prefix by which to remove keys
+      const string &start,     ///< [in] The start bound of remove keys
+      const string &end        ///< [in] The end bound of remove keys
+      ) {
+      rm_range_keys(prefix, start, end);
+    }
+
     /// Merge value into key
     virtual void merge(
       const std::string &prefix,   ///< [in] Prefix/CF ==> MUST match some established merge operator
@@ -198,6 +208,24 @@ public:
 		  bufferlist *value) {
     return get(prefix, string(key, keylen), value);
   }
+  /// Retrieve many keys in one call
+  ///
+  /// (*values)[i] and (*found)[i] describe keys[i].  Backends with a
+  /// native batched lookup (e.g., rocksdb MultiGet) override this; the
+  /// default just issues one get() per key.
+  virtual int get_batch(
+    const std::string &prefix,               ///< [in] Prefix/CF for keys
+    const std::vector<std::string> &keys,    ///< [in] Keys to retrieve
+    std::vector<bufferlist> *values,         ///< [out] Values, in key order
+    std::vector<bool> *found) {              ///< [out] Whether each key exists
+    values->clear();
+    values->resize(keys.size());
+    found->assign(keys.size(), false);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      (*found)[i] = get(prefix, keys[i], &(*values)[i]) >= 0;
+    }
+    return 0;
+  }
 
   // This superclass is used both by kv iterators *and* by the ObjectMap
   // omap iterator.  The class hierarchies are unfortunately tied together
@@ -353,6 +381,13 @@ public:
     return cf_handles.count(prefix);
   }
 
+  /// create column family cf (if missing) and move all keys under the
+  /// prefix of the same name from the default key space into it
+  virtual int migrate_to_column_family(const ColumnFamily& cf,
+				       std::ostream &out) {
+    return -EOPNOTSUPP;
+  }
+
   virtual uint64_t get_estimated_size(std::map<std::string,uint64_t> &extra) = 0;
   virtual int get_statfs(struct store_statfs_t *buf) {
     return -EOPNOTSUPP;
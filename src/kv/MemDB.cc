@@ -51,12 +51,6 @@ static string make_key(const string &prefix, const string &value)
   return out;
 }
 
-void MemDB::_encode(mdb_iter_t iter, bufferlist &bl)
-{
-  encode(iter->first, bl);
-  encode(iter->second, bl);
-}
-
 std::string MemDB::_get_data_fn()
 {
   string fn = m_db_path + "/" + "MemDB.db";
@@ -65,7 +59,7 @@ std::string MemDB::_get_data_fn()
 
 void MemDB::_save()
 {
-  std::lock_guard<std::mutex> l(m_lock);
+  std::shared_lock<std::shared_mutex> l(m_stripes_lock);
   dout(10) << __func__ << " Saving MemDB to file: "<< _get_data_fn().c_str() << dendl;
   int mode = 0644;
   int fd = TEMP_FAILURE_RETRY(::open(_get_data_fn().c_str(),
@@ -77,11 +71,14 @@ void MemDB::_save()
     return;
   }
   bufferlist bl;
-  mdb_iter_t iter = m_map.begin();
-  while (iter != m_map.end()) {
-    dout(10) << __func__ << " Key:"<< iter->first << dendl;
-    _encode(iter, bl);
-    ++iter;
+  for (auto& p : m_stripes) {
+    Stripe *s = p.second.get();
+    std::shared_lock<std::shared_mutex> sl(s->lock);
+    for (auto& i : s->map) {
+      dout(10) << __func__ << " Key:"<< s->prefix << " " << i.first << dendl;
+      encode(make_key(s->prefix, i.first), bl);
+      encode(i.second, bl);
+    }
   }
   bl.write_fd(fd);
 
@@ -90,7 +87,7 @@ void MemDB::_save()
 
 int MemDB::_load()
 {
-  std::lock_guard<std::mutex> l(m_lock);
+  std::unique_lock<std::shared_mutex> l(m_stripes_lock);
   dout(10) << __func__ << " Reading MemDB from file: "<< _get_data_fn().c_str() << dendl;
   /*
    * Open file and read it in single shot.
@@ -116,15 +113,21 @@ int MemDB::_load()
   ssize_t file_size = st.st_size;
   ssize_t bytes_done = 0;
   while (bytes_done < file_size) {
-    string key;
+    string raw_key;
     bufferptr datap;
 
-    bytes_done += ::decode_file(fd, key);
+    bytes_done += ::decode_file(fd, raw_key);
     bytes_done += ::decode_file(fd, datap);
 
-    dout(10) << __func__ << " Key:"<< key << dendl;
-    m_map[key] = datap;
+    dout(10) << __func__ << " Key:"<< raw_key << dendl;
+    string prefix, key;
+    split_key(raw_key, &prefix, &key);
+    auto& s = m_stripes[prefix];
+    if (!s) {
+      s.reset(new Stripe(prefix));
+    }
     m_total_bytes += datap.length();
+    s->map[key] = std::move(datap);
   }
   VOID_TEMP_FAILURE_RETRY(::close(fd));
   return 0;
@@ -132,7 +135,7 @@ int MemDB::_load()
 
 int MemDB::_init(bool create)
 {
-  int r;
+  int r = 0;
   dout(1) << __func__ << dendl;
   if (create) {
     r = ::mkdir(m_db_path.c_str(), 0700);
@@ -144,7 +147,7 @@ int MemDB::_init(bool create)
       }
       r = 0; // ignore EEXIST
     }
-  } else {
+  } else if (m_persist) {
     r = _load();
   }
 
@@ -171,6 +174,7 @@ int MemDB::do_open(ostream &out, bool create)
 {
   m_total_bytes = 0;
   m_allocated_bytes = 1;
+  m_persist = m_cct->_conf.get_val<bool>("memdb_persist");
 
   return _init(create);
 }
@@ -200,11 +204,38 @@ void MemDB::close()
   /*
    * Save whatever in memory btree.
    */
-  _save();
+  if (m_persist) {
+    _save();
+  }
   if (logger)
     m_cct->get_perfcounters_collection()->remove(logger);
 }
 
+MemDB::Stripe *MemDB::_get_stripe(const string &prefix)
+{
+  std::shared_lock<std::shared_mutex> l(m_stripes_lock);
+  auto p = m_stripes.find(prefix);
+  if (p == m_stripes.end()) {
+    return nullptr;
+  }
+  return p->second.get();
+}
+
+MemDB::Stripe *MemDB::_get_or_create_stripe(const string &prefix)
+{
+  Stripe *s = _get_stripe(prefix);
+  if (s) {
+    return s;
+  }
+  std::unique_lock<std::shared_mutex> l(m_stripes_lock);
+  auto& p = m_stripes[prefix];
+  if (!p) {
+    dout(10) << __func__ << " new stripe " << prefix << dendl;
+    p.reset(new Stripe(prefix));
+  }
+  return p.get();
+}
+
 int MemDB::submit_transaction(KeyValueDB::Transaction t)
 {
   utime_t start = ceph_clock_now();
@@ -212,19 +243,34 @@ int MemDB::submit_transaction(KeyValueDB::Transaction t)
   MDBTransactionImpl* mt =  static_cast<MDBTransactionImpl*>(t.get());
 
   dtrace << __func__ << " " << mt->get_ops().size() << dendl;
-  for(auto& op : mt->get_ops()) {
-    if(op.first == MDBTransactionImpl::WRITE) {
-      ms_op_t set_op = op.second;
-      _setkey(set_op);
+
+  // Resolve every stripe first (never while holding a stripe lock), then
+  // lock them in prefix order so the whole transaction applies atomically.
+  std::map<std::string, Stripe*> stripes;
+  for (auto& op : mt->get_ops()) {
+    auto& prefix = op.second.first.first;
+    if (!stripes.count(prefix)) {
+      stripes[prefix] = _get_or_create_stripe(prefix);
+    }
+  }
+  for (auto& p : stripes) {
+    p.second->lock.lock();
+  }
+  for (auto& op : mt->get_ops()) {
+    Stripe *s = stripes[op.second.first.first];
+    if (op.first == MDBTransactionImpl::WRITE) {
+      _setkey(s, op.second);
     } else if (op.first == MDBTransactionImpl::MERGE) {
-      ms_op_t merge_op = op.second;
-      _merge(merge_op);
+      _merge(s, op.second);
     } else {
-      ms_op_t rm_op = op.second;
       ceph_assert(op.first == MDBTransactionImpl::DELETE);
-      _rmkey(rm_op);
+      _rmkey(s, op.second);
     }
   }
+  for (auto& p : stripes) {
+    p.second->seq++;
+    p.second->lock.unlock();
+  }
 
   utime_t lat = ceph_clock_now() - start;
   logger->inc(l_memdb_txns);
@@ -294,44 +340,35 @@ void MemDB::MDBTransactionImpl::merge(
   return;
 }
 
-int MemDB::_setkey(ms_op_t &op)
+/*
+ * Caller holds the stripe lock exclusively.
+ */
+int MemDB::_setkey(Stripe *s, const ms_op_t &op)
 {
-  std::lock_guard<std::mutex> l(m_lock);
-  std::string key = make_key(op.first.first, op.first.second);
-  bufferlist bl = op.second;
+  const bufferlist& bl = op.second;
+  bufferptr& v = s->map[op.first.second];
 
+  ceph_assert(m_total_bytes >= v.length());
   m_total_bytes += bl.length();
-
-  bufferlist bl_old;
-  if (_get(op.first.first, op.first.second, &bl_old)) {
-    /*
-     * delete and free existing key.
-     */
-    ceph_assert(m_total_bytes >= bl_old.length());
-    m_total_bytes -= bl_old.length();
-    m_map.erase(key);
-  }
-
-  m_map[key] = bufferptr((char *) bl.c_str(), bl.length());
-  iterator_seq_no++;
+  m_total_bytes -= v.length();
+  v = bufferptr(bl.length());
+  bl.copy(0, bl.length(), v.c_str());
   return 0;
 }
 
-int MemDB::_rmkey(ms_op_t &op)
+int MemDB::_rmkey(Stripe *s, const ms_op_t &op)
 {
-  std::lock_guard<std::mutex> l(m_lock);
-  std::string key = make_key(op.first.first, op.first.second);
-
-  bufferlist bl_old;
-  if (_get(op.first.first, op.first.second, &bl_old)) {
-    ceph_assert(m_total_bytes >= bl_old.length());
-    m_total_bytes -= bl_old.length();
+  auto p = s->map.find(op.first.second);
+  if (p == s->map.end()) {
+    return 0;
   }
-  iterator_seq_no++;
+  ceph_assert(m_total_bytes >= p->second.length());
+  m_total_bytes -= p->second.length();
   /*
    * Erase will call the destructor for bufferptr.
    */
-  return m_map.erase(key);
+  s->map.erase(p);
+  return 1;
 }
 
 std::shared_ptr<KeyValueDB::MergeOperator> MemDB::_find_merge_op(const std::string &prefix)
@@ -347,81 +384,69 @@ std::shared_ptr<KeyValueDB::MergeOperator> MemDB::_find_merge_op(const std::stri
 }
 
 
-int MemDB::_merge(ms_op_t &op)
+int MemDB::_merge(Stripe *s, const ms_op_t &op)
 {
-  std::lock_guard<std::mutex> l(m_lock);
-  std::string prefix = op.first.first;
-  std::string key = make_key(op.first.first, op.first.second);
-  bufferlist bl = op.second;
+  const bufferlist& bl = op.second;
   int64_t bytes_adjusted = bl.length();
 
   /*
    *  find the operator for this prefix
    */
-  std::shared_ptr<MergeOperator> mop = _find_merge_op(prefix);
+  std::shared_ptr<MergeOperator> mop = _find_merge_op(s->prefix);
   ceph_assert(mop);
 
   /*
    * call the merge operator with value and non value
    */
-  bufferlist bl_old;
-  if (_get(op.first.first, op.first.second, &bl_old) == false) {
-    std::string new_val;
+  std::string new_val;
+  bufferlist in(bl);
+  auto p = s->map.find(op.first.second);
+  if (p == s->map.end()) {
     /*
      * Merge non existent.
      */
-    mop->merge_nonexistent(bl.c_str(), bl.length(), &new_val);
-    m_map[key] = bufferptr(new_val.c_str(), new_val.length());
+    mop->merge_nonexistent(in.c_str(), in.length(), &new_val);
+    s->map[op.first.second] = bufferptr(new_val.c_str(), new_val.length());
   } else {
     /*
      * Merge existing.
      */
-    std::string new_val;
-    mop->merge(bl_old.c_str(), bl_old.length(), bl.c_str(), bl.length(), &new_val);
-    m_map[key] = bufferptr(new_val.c_str(), new_val.length());
-    bytes_adjusted -= bl_old.length();
-    bl_old.clear();
+    mop->merge(p->second.c_str(), p->second.length(), in.c_str(), in.length(),
+	       &new_val);
+    bytes_adjusted -= p->second.length();
+    p->second = bufferptr(new_val.c_str(), new_val.length());
   }
 
   ceph_assert((int64_t)m_total_bytes + bytes_adjusted >= 0);
   m_total_bytes += bytes_adjusted;
-  iterator_seq_no++;
   return 0;
 }
 
 /*
- * Caller take btree lock.
+ * Caller holds the stripe lock (shared is enough).
  */
-bool MemDB::_get(const string &prefix, const string &k, bufferlist *out)
+bool MemDB::_get(Stripe *s, const string &k, bufferlist *out)
 {
-  string key = make_key(prefix, k);
-
-  mdb_iter_t iter = m_map.find(key);
-  if (iter == m_map.end()) {
+  auto p = s->map.find(k);
+  if (p == s->map.end()) {
     return false;
   }
-
-  out->push_back((m_map[key].clone()));
+  out->push_back(p->second.clone());
   return true;
 }
 
-bool MemDB::_get_locked(const string &prefix, const string &k, bufferlist *out)
-{
-  std::lock_guard<std::mutex> l(m_lock);
-  return _get(prefix, k, out);
-}
-
-
 int MemDB::get(const string &prefix, const std::string& key,
                  bufferlist *out)
 {
   utime_t start = ceph_clock_now();
-  int ret;
+  int ret = -ENOENT;
 
-  if (_get_locked(prefix, key, out)) {
-    ret = 0;
-  } else {
-    ret = -ENOENT;
+  Stripe *s = _get_stripe(prefix);
+  if (s) {
+    std::shared_lock<std::shared_mutex> l(s->lock);
+    if (_get(s, key, out)) {
+      ret = 0;
+    }
   }
 
   utime_t lat = ceph_clock_now() - start;
@@ -436,10 +461,14 @@ int MemDB::get(const string &prefix, const std::set<string> &keys,
 {
   utime_t start = ceph_clock_now();
 
-  for (const auto& i : keys) {
-    bufferlist bl;
-    if (_get_locked(prefix, i, &bl))
-      out->insert(make_pair(i, bl));
+  Stripe *s = _get_stripe(prefix);
+  if (s) {
+    std::shared_lock<std::shared_mutex> l(s->lock);
+    for (const auto& i : keys) {
+      bufferlist bl;
+      if (_get(s, i, &bl))
+	out->insert(make_pair(i, bl));
+    }
   }
 
   utime_t lat = ceph_clock_now() - start;
@@ -449,162 +478,193 @@ int MemDB::get(const string &prefix, const std::set<string> &keys,
   return 0;
 }
 
+int MemDB::get_batch(const string &prefix,
+		     const std::vector<string> &keys,
+		     std::vector<bufferlist> *values,
+		     std::vector<bool> *found)
+{
+  utime_t start = ceph_clock_now();
+
+  values->clear();
+  values->resize(keys.size());
+  found->assign(keys.size(), false);
+  Stripe *s = _get_stripe(prefix);
+  if (s) {
+    std::shared_lock<std::shared_mutex> l(s->lock);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      (*found)[i] = _get(s, keys[i], &(*values)[i]);
+    }
+  }
+
+  utime_t lat = ceph_clock_now() - start;
+  logger->inc(l_memdb_gets);
+  logger->tinc(l_memdb_get_latency, lat);
+
+  return 0;
+}
+
+/*
+ * Iterator helpers below run with m_stripes_lock held shared and take
+ * at most one stripe lock at a time, after it.
+ */
 void MemDB::MDBWholeSpaceIteratorImpl::fill_current()
 {
-  bufferlist bl;
-  bl.append(m_iter->second.clone());
-  m_key_value = std::make_pair(m_iter->first, bl);
+  m_key = m_iter->first;
+  m_value.clear();
+  m_value.append(m_iter->second.clone());
 }
 
 bool MemDB::MDBWholeSpaceIteratorImpl::valid()
 {
-  if (m_key_value.first.empty()) {
-    return false;
-  }
-  return true;
+  return m_stripe != nullptr;
 }
 
-bool MemDB::MDBWholeSpaceIteratorImpl::iterator_validate() {
-
-  if (this_seq_no != *global_seq_no) {
-    auto key = m_key_value.first;
-    ceph_assert(!key.empty());
+void
+MemDB::MDBWholeSpaceIteratorImpl::free_last()
+{
+  m_stripe = nullptr;
+  m_key.clear();
+  m_value.clear();
+}
 
-    bool restart_iter = false;
-    if (!m_using_btree) {
-      /*
-       * Map is modified and marker key does not exists, 
-       * restart the iterator from next key.
-       */
-      if (m_map_p->find(key) == m_map_p->end()) {
-        restart_iter = true;
-      }
-    } else {
-      restart_iter = true;
+/*
+ * Position on the first key of the first non-empty stripe at or after p.
+ */
+int MemDB::MDBWholeSpaceIteratorImpl::_first_from(stripe_map_t::iterator p)
+{
+  for (; p != m_db->m_stripes.end(); ++p) {
+    Stripe *s = p->second.get();
+    std::shared_lock<std::shared_mutex> l(s->lock);
+    if (!s->map.empty()) {
+      m_stripe = s;
+      m_seq = s->seq;
+      m_iter = s->map.begin();
+      fill_current();
+      return 0;
     }
+  }
+  free_last();
+  return -1;
+}
 
-    if (restart_iter) {
-      m_iter = m_map_p->lower_bound(key);
-      if (m_iter == m_map_p->end()) {
-        return false;
-      }
+/*
+ * Position on the last key of the last non-empty stripe before p.
+ */
+int MemDB::MDBWholeSpaceIteratorImpl::_last_before(stripe_map_t::iterator p)
+{
+  while (p != m_db->m_stripes.begin()) {
+    --p;
+    Stripe *s = p->second.get();
+    std::shared_lock<std::shared_mutex> l(s->lock);
+    if (!s->map.empty()) {
+      m_stripe = s;
+      m_seq = s->seq;
+      m_iter = s->map.end();
+      --m_iter;
+      fill_current();
+      return 0;
     }
-
-    /*
-     * This iter is valid now.
-     */
-    this_seq_no = *global_seq_no;
   }
-
-  return true;
+  free_last();
+  return -1;
 }
 
-void
-MemDB::MDBWholeSpaceIteratorImpl::free_last()
+/*
+ * Caller holds the current stripe lock.  Re-seek m_iter to the last key
+ * we returned if the stripe changed underneath us; false if that key is
+ * gone, in which case m_iter points at its successor.
+ */
+bool MemDB::MDBWholeSpaceIteratorImpl::iterator_validate()
 {
-  m_key_value.first.clear();
-  m_key_value.second.clear();
+  if (m_seq == m_stripe->seq) {
+    return true;
+  }
+  m_seq = m_stripe->seq;
+  m_iter = m_stripe->map.lower_bound(m_key);
+  return m_iter != m_stripe->map.end() && m_iter->first == m_key;
 }
 
 string MemDB::MDBWholeSpaceIteratorImpl::key()
 {
-  dtrace << __func__ << " " << m_key_value.first << dendl;
-  string prefix, key;
-  split_key(m_key_value.first, &prefix, &key);
-  return key;
+  dtrace << __func__ << " " << m_key << dendl;
+  return m_key;
 }
 
 pair<string,string> MemDB::MDBWholeSpaceIteratorImpl::raw_key()
 {
-  string prefix, key;
-  split_key(m_key_value.first, &prefix, &key);
-  return make_pair(prefix, key);
+  return make_pair(m_stripe->prefix, m_key);
 }
 
 bool MemDB::MDBWholeSpaceIteratorImpl::raw_key_is_prefixed(
     const string &prefix)
 {
-  string p, k;
-  split_key(m_key_value.first, &p, &k);
-  return (p == prefix);
+  return m_stripe->prefix == prefix;
 }
 
 bufferlist MemDB::MDBWholeSpaceIteratorImpl::value()
 {
-  dtrace << __func__ << " " << m_key_value << dendl;
-  return m_key_value.second;
+  dtrace << __func__ << " " << m_key << dendl;
+  return m_value;
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl::next()
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
-  if (!iterator_validate()) {
-    free_last();
+  if (!m_stripe) {
     return -1;
   }
-  free_last();
-  ++m_iter;
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
-  } else {
-    return -1;
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
+  {
+    std::shared_lock<std::shared_mutex> sl(m_stripe->lock);
+    if (iterator_validate()) {
+      ++m_iter;
+    }
+    if (m_iter != m_stripe->map.end()) {
+      fill_current();
+      return 0;
+    }
   }
+  return _first_from(m_db->m_stripes.upper_bound(m_stripe->prefix));
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl:: prev()
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
-  if (!iterator_validate()) {
-    free_last();
+  if (!m_stripe) {
     return -1;
   }
-  free_last();
-  if (m_iter != m_map_p->begin()) {
-    --m_iter;
-    fill_current();
-    return 0;
-  } else {
-    return -1;
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
+  {
+    std::shared_lock<std::shared_mutex> sl(m_stripe->lock);
+    iterator_validate();
+    if (m_iter != m_stripe->map.begin()) {
+      --m_iter;
+      fill_current();
+      return 0;
+    }
   }
+  return _last_before(m_db->m_stripes.find(m_stripe->prefix));
 }
 
 /*
- * First key >= to given key, if key is null then first key in btree.
+ * First key of the first prefix >= k, if k is empty then the first key.
  */
 int MemDB::MDBWholeSpaceIteratorImpl::seek_to_first(const std::string &k)
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
   free_last();
-  if (k.empty()) {
-    m_iter = m_map_p->begin();
-  } else {
-    m_iter = m_map_p->lower_bound(k);
-  }
-  
-  if (m_iter == m_map_p->end()) {
-    return -1;
-  }
-  fill_current();
-  return 0;
+  return _first_from(m_db->m_stripes.lower_bound(k));
 }
 
+/*
+ * Last key of the last prefix <= k, if k is empty then the last key.
+ */
 int MemDB::MDBWholeSpaceIteratorImpl::seek_to_last(const std::string &k)
 {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
   free_last();
   if (k.empty()) {
-    m_iter = m_map_p->end();
-    --m_iter;
-  } else {
-    m_iter = m_map_p->lower_bound(k);
+    return _last_before(m_db->m_stripes.end());
   }
-
-  if (m_iter == m_map_p->end()) {
-    return -1;
-  }
-  fill_current();
-  return 0;
+  return _last_before(m_db->m_stripes.upper_bound(k));
 }
 
 MemDB::MDBWholeSpaceIteratorImpl::~MDBWholeSpaceIteratorImpl()
@@ -615,27 +675,45 @@ MemDB::MDBWholeSpaceIteratorImpl::~MDBWholeSpaceIteratorImpl()
 int MemDB::MDBWholeSpaceIteratorImpl::upper_bound(const std::string &prefix,
     const std::string &after) {
 
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
 
   dtrace << "upper_bound " << prefix.c_str() << after.c_str() << dendl;
-  string k = make_key(prefix, after);
-  m_iter = m_map_p->upper_bound(k);
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
+  free_last();
+  auto p = m_db->m_stripes.lower_bound(prefix);
+  if (p != m_db->m_stripes.end() && p->first == prefix) {
+    Stripe *s = p->second.get();
+    std::shared_lock<std::shared_mutex> sl(s->lock);
+    auto i = s->map.upper_bound(after);
+    if (i != s->map.end()) {
+      m_stripe = s;
+      m_seq = s->seq;
+      m_iter = i;
+      fill_current();
+      return 0;
+    }
+    ++p;
   }
-  return -1;
+  return _first_from(p);
 }
 
 int MemDB::MDBWholeSpaceIteratorImpl::lower_bound(const std::string &prefix,
     const std::string &to) {
-  std::lock_guard<std::mutex> l(*m_map_lock_p);
+  std::shared_lock<std::shared_mutex> l(m_db->m_stripes_lock);
   dtrace << "lower_bound " << prefix.c_str() << to.c_str() << dendl;
-  string k = make_key(prefix, to);
-  m_iter = m_map_p->lower_bound(k);
-  if (m_iter != m_map_p->end()) {
-    fill_current();
-    return 0;
+  free_last();
+  auto p = m_db->m_stripes.lower_bound(prefix);
+  if (p != m_db->m_stripes.end() && p->first == prefix) {
+    Stripe *s = p->second.get();
+    std::shared_lock<std::shared_mutex> sl(s->lock);
+    auto i = s->map.lower_bound(to);
+    if (i != s->map.end()) {
+      m_stripe = s;
+      m_seq = s->seq;
+      m_iter = i;
+      fill_current();
+      return 0;
+    }
+    ++p;
   }
-  return -1;
+  return _first_from(p);
 }
@@ -14,6 +14,8 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <shared_mutex>
 #include <boost/scoped_ptr.hpp>
 #include "include/encoding.h"
 #include "include/btree_map.h"
@@ -37,15 +39,31 @@ enum {
 class MemDB : public KeyValueDB
 {
   typedef std::pair<std::pair<std::string, std::string>, bufferlist> ms_op_t;
-  std::mutex m_lock;
-  uint64_t m_total_bytes;
-  uint64_t m_allocated_bytes;
-
-  typedef std::map<std::string, bufferptr> mdb_map_t;
+  typedef btree::btree_map<std::string, bufferptr> mdb_map_t;
   typedef mdb_map_t::iterator mdb_iter_t;
-  bool m_using_btree;
 
-  mdb_map_t m_map;
+  /*
+   * The keyspace is striped by prefix: each prefix has its own ordered
+   * map (keys are stored without the prefix) and its own reader/writer
+   * lock, so readers never serialize against each other and only
+   * contend with writers touching the same prefix.  Stripes are created
+   * on first use and live until the db is destroyed.
+   */
+  struct Stripe {
+    const std::string prefix;
+    std::shared_mutex lock;
+    mdb_map_t map;
+    uint64_t seq = 1;     ///< bumped on every modification (under lock)
+
+    explicit Stripe(const std::string& p) : prefix(p) {}
+  };
+  typedef std::map<std::string, std::unique_ptr<Stripe>> stripe_map_t;
+
+  std::shared_mutex m_stripes_lock;   ///< protects m_stripes
+  stripe_map_t m_stripes;
+  std::atomic<uint64_t> m_total_bytes;
+  uint64_t m_allocated_bytes;
+  bool m_persist;
 
   CephContext *m_cct;
   PerfCounters *logger;
@@ -56,18 +74,17 @@ class MemDB : public KeyValueDB
   int transaction_rollback(KeyValueDB::Transaction t);
   int _open(ostream &out);
   void close() override;
-  bool _get(const string &prefix, const string &k, bufferlist *out);
-  bool _get_locked(const string &prefix, const string &k, bufferlist *out);
+  Stripe *_get_stripe(const string &prefix);
+  Stripe *_get_or_create_stripe(const string &prefix);
+  bool _get(Stripe *s, const string &k, bufferlist *out);
   std::string _get_data_fn();
-  void _encode(mdb_iter_t iter, bufferlist &bl);
   void _save();
   int _load();
-  uint64_t iterator_seq_no;
 
 public:
   MemDB(CephContext *c, const string &path, void *p) :
-    m_total_bytes(0), m_allocated_bytes(0), m_using_btree(false),
-    m_cct(c), logger(NULL), m_priv(p), m_db_path(path), iterator_seq_no(1)
+    m_total_bytes(0), m_allocated_bytes(0), m_persist(true),
+    m_cct(c), logger(NULL), m_priv(p), m_db_path(path)
   {
     //Nothing as of now
   }
@@ -121,10 +138,9 @@ private:
   /*
    * Transaction states.
    */
-  int _merge(const std::string &k, bufferptr &bl);
-  int _merge(ms_op_t &op);
-  int _setkey(ms_op_t &op);
-  int _rmkey(ms_op_t &op);
+  int _merge(Stripe *s, const ms_op_t &op);
+  int _setkey(Stripe *s, const ms_op_t &op);
+  int _rmkey(Stripe *s, const ms_op_t &op);
 
 public:
 
@@ -151,30 +167,32 @@ public:
 
   using KeyValueDB::get;
 
-  class MDBWholeSpaceIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
-
-      mdb_iter_t m_iter;
-      std::pair<string, bufferlist> m_key_value;
-      mdb_map_t *m_map_p;
-      std::mutex *m_map_lock_p;
-      uint64_t *global_seq_no;
-      uint64_t this_seq_no;
-      bool m_using_btree;
+  int get_batch(const std::string &prefix,
+		const std::vector<std::string> &keys,
+		std::vector<bufferlist> *values,
+		std::vector<bool> *found) override;
 
-  public:
-    MDBWholeSpaceIteratorImpl(mdb_map_t *btree_p, std::mutex *btree_lock_p,
-                              uint64_t *iterator_seq_no, bool using_btree) {
-      m_map_p = btree_p;
-      m_map_lock_p = btree_lock_p;
-      std::lock_guard<std::mutex> l(*m_map_lock_p);
-      global_seq_no = iterator_seq_no;
-      this_seq_no = *iterator_seq_no;
-      m_using_btree = using_btree;
-    }
+  /*
+   * Iterators do not pin a snapshot.  Each one remembers the stripe
+   * sequence it last saw; if the stripe has been modified since, it
+   * re-seeks from the last key it returned before moving on.
+   */
+  class MDBWholeSpaceIteratorImpl : public KeyValueDB::WholeSpaceIteratorImpl {
+    MemDB *m_db;
+    Stripe *m_stripe = nullptr;  ///< stripe of the current key, if valid
+    mdb_iter_t m_iter;
+    uint64_t m_seq = 0;
+    std::string m_key;
+    bufferlist m_value;
 
     void fill_current();
     void free_last();
+    bool iterator_validate();
+    int _first_from(stripe_map_t::iterator p);
+    int _last_before(stripe_map_t::iterator p);
 
+  public:
+    explicit MDBWholeSpaceIteratorImpl(MemDB *db) : m_db(db) {}
 
     int seek_to_first(const std::string &k) override;
     int seek_to_last(const std::string &k) override;
@@ -185,7 +203,6 @@ public:
     int upper_bound(const std::string &prefix, const std::string &after) override;
     int lower_bound(const std::string &prefix, const std::string &to) override;
     bool valid() override;
-    bool iterator_validate();
 
     int next() override;
     int prev() override;
@@ -199,12 +216,10 @@ public:
   };
 
   uint64_t get_estimated_size(std::map<std::string,uint64_t> &extra) override {
-      std::lock_guard<std::mutex> l(m_lock);
       return m_allocated_bytes;
   };
 
   int get_statfs(struct store_statfs_t *buf) override {
-    std::lock_guard<std::mutex> l(m_lock);
     buf->reset();
     buf->total = m_total_bytes;
     buf->allocated = m_allocated_bytes;
@@ -214,7 +229,7 @@ public:
 
   WholeSpaceIterator get_wholespace_iterator() override {
     return std::shared_ptr<KeyValueDB::WholeSpaceIteratorImpl>(
-      new MDBWholeSpaceIteratorImpl(&m_map, &m_lock, &iterator_seq_no, m_using_btree));
+      new MDBWholeSpaceIteratorImpl(this));
   }
 };
 
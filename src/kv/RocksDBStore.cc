@@ -21,8 +21,10 @@
 #include "kv/rocksdb_cache/BinnedLRUCache.h"
 
 using std::string;
+#include "common/admin_socket.h"
 #include "common/perf_counters.h"
 #include "common/PriorityCache.h"
+#include "common/strtol.h"
 #include "include/str_list.h"
 #include "include/stringify.h"
 #include "include/str_map.h"
@@ -311,6 +313,55 @@ int RocksDBStore::install_cf_mergeop(
   return 0;
 }
 
+int RocksDBStore::parse_cf_options(
+  const string &cf_name,
+  const string &cf_options,
+  rocksdb::ColumnFamilyOptions *cf_opt)
+{
+  // block_cache_ratio is not a rocksdb option: it gives this CF a block
+  // cache of its own, sized as a fraction of rocksdb_cache_size, so that
+  // e.g. omap scans cannot evict onode blocks.
+  string opts = cf_options;
+  double block_cache_ratio = 0;
+  static const string ratio_key = "block_cache_ratio=";
+  auto pos = opts.find(ratio_key);
+  if (pos != string::npos) {
+    auto end = opts.find(';', pos);
+    string val = opts.substr(pos + ratio_key.size(),
+			     end == string::npos ? string::npos :
+			     end - pos - ratio_key.size());
+    string err;
+    block_cache_ratio = strict_strtod(val.c_str(), &err);
+    if (!err.empty() || block_cache_ratio < 0 || block_cache_ratio > 1) {
+      derr << __func__ << " invalid block_cache_ratio for CF '" << cf_name
+	   << "': " << val << dendl;
+      return -EINVAL;
+    }
+    opts.erase(pos, end == string::npos ? string::npos : end - pos + 1);
+  }
+
+  rocksdb::Status status = rocksdb::GetColumnFamilyOptionsFromString(
+    *cf_opt, opts, cf_opt);
+  if (!status.ok()) {
+    derr << __func__ << " invalid db column family options for CF '"
+	 << cf_name << "': " << opts << dendl;
+    return -EINVAL;
+  }
+
+  if (block_cache_ratio > 0 && !bbt_opts.no_block_cache) {
+    rocksdb::BlockBasedTableOptions cf_bbt_opts = bbt_opts;
+    cf_bbt_opts.block_cache = rocksdb::NewLRUCache(
+      cache_size * block_cache_ratio,
+      g_conf()->rocksdb_cache_shard_bits);
+    cf_opt->table_factory.reset(
+      rocksdb::NewBlockBasedTableFactory(cf_bbt_opts));
+    cf_block_caches[cf_name] = cf_bbt_opts.block_cache;
+    dout(10) << __func__ << " CF '" << cf_name << "' block cache "
+	     << byte_u_t(cache_size * block_cache_ratio) << dendl;
+  }
+  return 0;
+}
+
 int RocksDBStore::create_and_open(ostream &out,
 				  const vector<ColumnFamily>& cfs)
 {
@@ -486,12 +537,9 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
 	// the base for new CF
 	rocksdb::ColumnFamilyOptions cf_opt(opt);
 	// user input options will override the base options
-	status = rocksdb::GetColumnFamilyOptionsFromString(
-	  cf_opt, p.option, &cf_opt);
-	if (!status.ok()) {
-	  derr << __func__ << " invalid db column family option string for CF: "
-	       << p.name << dendl;
-	  return -EINVAL;
+	r = parse_cf_options(p.name, p.option, &cf_opt);
+	if (r < 0) {
+	  return r;
 	}
 	install_cf_mergeop(p.name, &cf_opt);
 	rocksdb::ColumnFamilyHandle *cf;
@@ -534,12 +582,9 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
 	  for (auto& i : *cfs) {
 	    if (i.name == n) {
 	      found = true;
-	      status = rocksdb::GetColumnFamilyOptionsFromString(
-		cf_opt, i.option, &cf_opt);
-	      if (!status.ok()) {
-		derr << __func__ << " invalid db column family options for CF '"
-		     << i.name << "': " << i.option << dendl;
-		return -EINVAL;
+	      r = parse_cf_options(i.name, i.option, &cf_opt);
+	      if (r < 0) {
+		return r;
 	      }
 	    }
 	  }
@@ -590,6 +635,7 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
       "rocksdb_write_pre_and_post_time", "total time spent on writing a record, excluding write process");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
+  _init_prefix_stats();
 
   if (compact_on_mount) {
     derr << "Compacting rocksdb store..." << dendl;
@@ -599,6 +645,239 @@ int RocksDBStore::do_open(ostream &out, bool create_if_missing,
   return 0;
 }
 
+class RocksDBStore::SocketHook : public AdminSocketHook {
+  RocksDBStore *db;
+public:
+  explicit SocketHook(RocksDBStore *db) : db(db) {}
+
+  bool call(std::string_view command, const cmdmap_t& cmdmap,
+	    std::string_view format, bufferlist& out) override {
+    Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
+    db->dump_prefix_stats(f);
+    f->flush(out);
+    delete f;
+    return true;
+  }
+};
+
+void RocksDBStore::PrefixStats::add_get(uint64_t n, uint64_t bytes,
+					utime_t lat)
+{
+  logger->inc(l_rocksdb_prefix_gets, n);
+  logger->inc(l_rocksdb_prefix_get_bytes, bytes);
+  logger->tinc(l_rocksdb_prefix_get_latency, lat);
+  uint64_t us = lat.to_nsec() / 1000;
+  unsigned b = us ? std::min<unsigned>(cbits(us), get_lat_hist.size() - 1) : 0;
+  get_lat_hist[b].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RocksDBStore::PrefixStats::dump(Formatter *f) const
+{
+  logger->dump_formatted(f, false);
+  uint64_t total = 0;
+  std::array<uint64_t, 32> h;
+  for (unsigned i = 0; i < h.size(); ++i) {
+    h[i] = get_lat_hist[i].load(std::memory_order_relaxed);
+    total += h[i];
+  }
+  f->open_object_section("get_latency_usec");
+  // report the upper bound of the bucket holding each percentile
+  for (auto pct : { 50.0, 90.0, 99.0, 99.9 }) {
+    uint64_t want = total * pct / 100.0;
+    uint64_t seen = 0;
+    unsigned i = 0;
+    for (; i < h.size() - 1; ++i) {
+      seen += h[i];
+      if (seen > want) {
+	break;
+      }
+    }
+    f->dump_unsigned(("p" + stringify(pct)).c_str(), total ? (1ull << i) : 0);
+  }
+  f->open_array_section("histogram");
+  for (unsigned i = 0; i < h.size(); ++i) {
+    if (h[i]) {
+      f->open_object_section("bucket");
+      f->dump_unsigned("le", 1ull << i);
+      f->dump_unsigned("count", h[i]);
+      f->close_section();
+    }
+  }
+  f->close_section();
+  f->close_section();
+}
+
+void RocksDBStore::_init_prefix_stats()
+{
+  list<string> prefixes;
+  get_str_list(cct->_conf.get_val<string>("rocksdb_perf_prefixes"),
+	       prefixes);
+  if (prefixes.empty()) {
+    return;
+  }
+  prefixes.push_back("other");
+
+  for (auto& prefix : prefixes) {
+    std::unique_ptr<PrefixStats> ps(new PrefixStats);
+    string name = "rocksdb_prefix_" + prefix;
+    PerfCountersBuilder plb(cct, name, l_rocksdb_prefix_first,
+			    l_rocksdb_prefix_last);
+    plb.add_u64_counter(l_rocksdb_prefix_gets, "get", "Keys read");
+    plb.add_u64_counter(l_rocksdb_prefix_get_bytes, "get_bytes",
+			"Value bytes read", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_time_avg(l_rocksdb_prefix_get_latency, "get_latency",
+		     "Get latency");
+    plb.add_u64_counter(l_rocksdb_prefix_sets, "set", "Keys written");
+    plb.add_u64_counter(l_rocksdb_prefix_set_bytes, "set_bytes",
+			"Value bytes written", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_rocksdb_prefix_rmkeys, "rmkey", "Keys removed");
+    plb.add_u64_counter(l_rocksdb_prefix_rm_ranges, "rm_range",
+			"Key ranges removed");
+    plb.add_u64_counter(l_rocksdb_prefix_merges, "merge", "Merges");
+    plb.add_u64_counter(l_rocksdb_prefix_seeks, "seek", "Iterator seeks");
+    ps->logger = plb.create_perf_counters();
+    cct->get_perfcounters_collection()->add(ps->logger);
+    if (prefix == "other") {
+      other_prefix_stats = std::move(ps);
+    } else {
+      prefix_stats[prefix] = std::move(ps);
+    }
+  }
+
+  asok_hook = new SocketHook(this);
+  int r = cct->get_admin_socket()->register_command(
+    "dump_kv_stats",
+    "dump_kv_stats",
+    asok_hook,
+    "dump per-prefix rocksdb op counts, bytes and get latency histograms");
+  // multiple stores may live in one process; first one wins
+  if (r < 0 && r != -EEXIST) {
+    derr << __func__ << " error registering admin socket command: "
+	 << cpp_strerror(r) << dendl;
+  }
+}
+
+void RocksDBStore::_shutdown_prefix_stats()
+{
+  if (asok_hook) {
+    cct->get_admin_socket()->unregister_commands(asok_hook);
+    delete asok_hook;
+    asok_hook = nullptr;
+  }
+  auto release = [this](PrefixStats *ps) {
+    cct->get_perfcounters_collection()->remove(ps->logger);
+    delete ps->logger;
+  };
+  for (auto& p : prefix_stats) {
+    release(p.second.get());
+  }
+  prefix_stats.clear();
+  if (other_prefix_stats) {
+    release(other_prefix_stats.get());
+    other_prefix_stats.reset();
+  }
+}
+
+void RocksDBStore::dump_prefix_stats(Formatter *f)
+{
+  f->open_object_section("kv_stats");
+  for (auto& p : prefix_stats) {
+    f->open_object_section(p.first.c_str());
+    p.second->dump(f);
+    f->close_section();
+  }
+  if (other_prefix_stats) {
+    f->open_object_section("other");
+    other_prefix_stats->dump(f);
+    f->close_section();
+  }
+  f->close_section();
+}
+
+int RocksDBStore::migrate_to_column_family(const ColumnFamily& cf,
+					   ostream &out)
+{
+  rocksdb::Status status;
+  auto cfh = get_cf_handle(cf.name);
+  if (!cfh) {
+    rocksdb::ColumnFamilyOptions cf_opt(db->GetOptions(default_cf));
+    int r = parse_cf_options(cf.name, cf.option, &cf_opt);
+    if (r < 0) {
+      return r;
+    }
+    install_cf_mergeop(cf.name, &cf_opt);
+    status = db->CreateColumnFamily(cf_opt, cf.name, &cfh);
+    if (!status.ok()) {
+      out << "failed to create column family " << cf.name << ": "
+	  << status.ToString() << std::endl;
+      return -EIO;
+    }
+    add_column_family(cf.name, static_cast<void*>(cfh));
+    out << "created column family " << cf.name << std::endl;
+  }
+
+  // copy keys over in bounded batches from one snapshot of the prefix,
+  // then drop the source range with a single range delete.  the copy is
+  // idempotent and the source is only removed once everything has been
+  // copied, so an interrupted migration is resumed by running it again.
+  // only that final batch needs to be synced.
+  const unsigned batch_size = 1024;
+  const string start = combine_strings(cf.name, string());
+  const string end = combine_strings(past_prefix(cf.name), string());
+  uint64_t moved = 0;
+  {
+    const rocksdb::Snapshot *snap = db->GetSnapshot();
+    rocksdb::ReadOptions roptions;
+    roptions.snapshot = snap;
+    std::unique_ptr<rocksdb::Iterator> it(
+      db->NewIterator(roptions, default_cf));
+    rocksdb::WriteBatch bat;
+    unsigned n = 0;
+    for (it->Seek(start); it->Valid(); it->Next()) {
+      string prefix, key;
+      if (split_key(it->key(), &prefix, &key) < 0 || prefix != cf.name) {
+	break;
+      }
+      bat.Put(cfh, key, it->value());
+      ++moved;
+      if (++n == batch_size) {
+	status = db->Write(rocksdb::WriteOptions(), &bat);
+	if (!status.ok()) {
+	  break;
+	}
+	bat.Clear();
+	n = 0;
+      }
+    }
+    if (status.ok() && !it->status().ok()) {
+      out << "error iterating prefix " << cf.name << ": "
+	  << it->status().ToString() << std::endl;
+      it.reset();
+      db->ReleaseSnapshot(snap);
+      return -EIO;
+    }
+    if (status.ok() && moved) {
+      bat.DeleteRange(default_cf, start, end);
+      rocksdb::WriteOptions woptions;
+      woptions.sync = true;
+      status = db->Write(woptions, &bat);
+    }
+    it.reset();
+    db->ReleaseSnapshot(snap);
+    if (!status.ok()) {
+      out << "error moving keys to column family " << cf.name << ": "
+	  << status.ToString() << std::endl;
+      return -EIO;
+    }
+  }
+  out << "moved " << moved << " keys to column family " << cf.name
+      << std::endl;
+  if (moved) {
+    compact_prefix(cf.name);
+  }
+  return 0;
+}
+
 int RocksDBStore::_test_init(const string& dir)
 {
   rocksdb::Options options;
@@ -647,6 +926,7 @@ void RocksDBStore::close()
     compact_queue_lock.Unlock();
   }
 
+  _shutdown_prefix_stats();
   if (logger)
     cct->get_perfcounters_collection()->remove(logger);
 }
@@ -748,6 +1028,10 @@ void RocksDBStore::get_statistics(Formatter *f)
       f->dump_string("block_cache_pinned_blocks_usage", str);
       str.clear();
     }
+    for (auto& p : cf_block_caches) {
+      f->dump_unsigned((p.first + "_block_cache_usage").c_str(),
+		       p.second->GetUsage());
+    }
     db->GetProperty("rocksdb.cur-size-all-mem-tables", &str);
     f->dump_string("rocksdb_memtable_usage", str);
     str.clear();
@@ -865,6 +1149,10 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   const string &k,
   const bufferlist &to_set_bl)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_sets);
+    ps->logger->inc(l_rocksdb_prefix_set_bytes, to_set_bl.length());
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     put_bat(bat, cf, k, to_set_bl);
@@ -879,6 +1167,10 @@ void RocksDBStore::RocksDBTransactionImpl::set(
   const char *k, size_t keylen,
   const bufferlist &to_set_bl)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_sets);
+    ps->logger->inc(l_rocksdb_prefix_set_bytes, to_set_bl.length());
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     string key(k, keylen);  // fixme?
@@ -893,6 +1185,9 @@ void RocksDBStore::RocksDBTransactionImpl::set(
 void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const string &k)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rmkeys);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k));
@@ -905,6 +1200,9 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 					         const char *k,
 						 size_t keylen)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rmkeys);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     bat.Delete(cf, rocksdb::Slice(k, keylen));
@@ -918,6 +1216,9 @@ void RocksDBStore::RocksDBTransactionImpl::rmkey(const string &prefix,
 void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 					                 const string &k)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rmkeys);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     bat.SingleDelete(cf, k);
@@ -928,6 +1229,9 @@ void RocksDBStore::RocksDBTransactionImpl::rm_single_key(const string &prefix,
 
 void RocksDBStore::RocksDBTransactionImpl::rmkeys_by_prefix(const string &prefix)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rm_ranges);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     if (db->enable_rmrange) {
@@ -963,6 +1267,9 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
                                                          const string &start,
                                                          const string &end)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rm_ranges);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     if (db->enable_rmrange) {
@@ -999,11 +1306,33 @@ void RocksDBStore::RocksDBTransactionImpl::rm_range_keys(const string &prefix,
   }
 }
 
+void RocksDBStore::RocksDBTransactionImpl::rm_range_keys_bulk(
+  const string &prefix,
+  const string &start,
+  const string &end)
+{
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_rm_ranges);
+  }
+  auto cf = db->get_cf_handle(prefix);
+  if (cf) {
+    bat.DeleteRange(cf, rocksdb::Slice(start), rocksdb::Slice(end));
+  } else {
+    bat.DeleteRange(
+      db->default_cf,
+      rocksdb::Slice(combine_strings(prefix, start)),
+      rocksdb::Slice(combine_strings(prefix, end)));
+  }
+}
+
 void RocksDBStore::RocksDBTransactionImpl::merge(
   const string &prefix,
   const string &k,
   const bufferlist &to_set_bl)
 {
+  if (auto ps = db->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_merges);
+  }
   auto cf = db->get_cf_handle(prefix);
   if (cf) {
     // bufferlist::c_str() is non-constant, so we can't call c_str()
@@ -1043,40 +1372,67 @@ int RocksDBStore::get(
     const string &prefix,
     const std::set<string> &keys,
     std::map<string, bufferlist> *out)
+{
+  std::vector<string> kv(keys.begin(), keys.end());
+  std::vector<bufferlist> values;
+  std::vector<bool> found;
+  get_batch(prefix, kv, &values, &found);
+  for (size_t i = 0; i < kv.size(); ++i) {
+    if (found[i]) {
+      (*out)[kv[i]].claim_append(values[i]);
+    }
+  }
+  return 0;
+}
+
+int RocksDBStore::get_batch(
+    const string &prefix,
+    const std::vector<string> &keys,
+    std::vector<bufferlist> *values,
+    std::vector<bool> *found)
 {
   utime_t start = ceph_clock_now();
+  values->clear();
+  values->resize(keys.size());
+  found->assign(keys.size(), false);
+  if (keys.empty()) {
+    return 0;
+  }
   auto cf = get_cf_handle(prefix);
+  std::vector<string> combined;  // backs the slices for the default cf
+  std::vector<rocksdb::Slice> slices;
+  slices.reserve(keys.size());
   if (cf) {
     for (auto& key : keys) {
-      std::string value;
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    cf,
-			    rocksdb::Slice(key),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value);
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
+      slices.emplace_back(key);
     }
   } else {
+    cf = default_cf;
+    combined.reserve(keys.size());
     for (auto& key : keys) {
-      std::string value;
-      string k = combine_strings(prefix, key);
-      auto status = db->Get(rocksdb::ReadOptions(),
-			    default_cf,
-			    rocksdb::Slice(k),
-			    &value);
-      if (status.ok()) {
-	(*out)[key].append(value);
-      } else if (status.IsIOError()) {
-	ceph_abort_msg(status.getState());
-      }
+      combined.push_back(combine_strings(prefix, key));
+      slices.emplace_back(combined.back());
+    }
+  }
+  std::vector<rocksdb::ColumnFamilyHandle*> cfs(keys.size(), cf);
+  std::vector<std::string> raw;
+  auto statuses = db->MultiGet(rocksdb::ReadOptions(), cfs, slices, &raw);
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (statuses[i].ok()) {
+      (*values)[i].append(raw[i]);
+      (*found)[i] = true;
+      bytes += raw[i].size();
+    } else if (statuses[i].IsIOError()) {
+      ceph_abort_msg(statuses[i].getState());
     }
   }
   utime_t lat = ceph_clock_now() - start;
   logger->inc(l_rocksdb_gets);
   logger->tinc(l_rocksdb_get_latency, lat);
+  if (auto ps = get_prefix_stats(prefix)) {
+    ps->add_get(keys.size(), bytes, lat);
+  }
   return 0;
 }
 
@@ -1113,6 +1469,9 @@ int RocksDBStore::get(
   utime_t lat = ceph_clock_now() - start;
   logger->inc(l_rocksdb_gets);
   logger->tinc(l_rocksdb_get_latency, lat);
+  if (auto ps = get_prefix_stats(prefix)) {
+    ps->add_get(1, value.size(), lat);
+  }
   return r;
 }
 
@@ -1151,6 +1510,9 @@ int RocksDBStore::get(
   utime_t lat = ceph_clock_now() - start;
   logger->inc(l_rocksdb_gets);
   logger->tinc(l_rocksdb_get_latency, lat);
+  if (auto ps = get_prefix_stats(prefix)) {
+    ps->add_get(1, value.size(), lat);
+  }
   return r;
 }
 
@@ -1341,6 +1703,13 @@ RocksDBStore::RocksDBWholeSpaceIteratorImpl::~RocksDBWholeSpaceIteratorImpl()
 {
   delete dbiter;
 }
+void RocksDBStore::RocksDBWholeSpaceIteratorImpl::note_seek(
+  const string &prefix)
+{
+  if (auto ps = store->get_prefix_stats(prefix)) {
+    ps->logger->inc(l_rocksdb_prefix_seeks);
+  }
+}
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_first()
 {
   dbiter->SeekToFirst();
@@ -1349,6 +1718,7 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_first()
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_first(const string &prefix)
 {
+  note_seek(prefix);
   rocksdb::Slice slice_prefix(prefix);
   dbiter->Seek(slice_prefix);
   ceph_assert(!dbiter->status().IsIOError());
@@ -1362,6 +1732,7 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_last()
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::seek_to_last(const string &prefix)
 {
+  note_seek(prefix);
   string limit = past_prefix(prefix);
   rocksdb::Slice slice_limit(limit);
   dbiter->Seek(slice_limit);
@@ -1385,6 +1756,7 @@ int RocksDBStore::RocksDBWholeSpaceIteratorImpl::upper_bound(const string &prefi
 }
 int RocksDBStore::RocksDBWholeSpaceIteratorImpl::lower_bound(const string &prefix, const string &to)
 {
+  note_seek(prefix);
   string bound = combine_strings(prefix, to);
   rocksdb::Slice slice_bound(bound);
   dbiter->Seek(slice_bound);
@@ -1469,26 +1841,35 @@ string RocksDBStore::past_prefix(const string &prefix)
 RocksDBStore::WholeSpaceIterator RocksDBStore::get_wholespace_iterator()
 {
   return std::make_shared<RocksDBWholeSpaceIteratorImpl>(
-    db->NewIterator(rocksdb::ReadOptions(), default_cf));
+    this, db->NewIterator(rocksdb::ReadOptions(), default_cf));
 }
 
 class CFIteratorImpl : public KeyValueDB::IteratorImpl {
 protected:
   string prefix;
   rocksdb::Iterator *dbiter;
+  PerfCounters *prefix_logger;  ///< per-prefix counters, if tracked
+  void note_seek() {
+    if (prefix_logger) {
+      prefix_logger->inc(l_rocksdb_prefix_seeks);
+    }
+  }
 public:
   explicit CFIteratorImpl(const std::string& p,
-				 rocksdb::Iterator *iter)
-    : prefix(p), dbiter(iter) { }
+			  rocksdb::Iterator *iter,
+			  PerfCounters *prefix_logger)
+    : prefix(p), dbiter(iter), prefix_logger(prefix_logger) { }
   ~CFIteratorImpl() {
     delete dbiter;
   }
 
   int seek_to_first() override {
+    note_seek();
     dbiter->SeekToFirst();
     return dbiter->status().ok() ? 0 : -1;
   }
   int seek_to_last() override {
+    note_seek();
     dbiter->SeekToLast();
     return dbiter->status().ok() ? 0 : -1;
   }
@@ -1500,6 +1881,7 @@ public:
     return dbiter->status().ok() ? 0 : -1;
   }
   int lower_bound(const string &to) override {
+    note_seek();
     rocksdb::Slice slice_bound(to);
     dbiter->Seek(slice_bound);
     return dbiter->status().ok() ? 0 : -1;
@@ -1542,9 +1924,11 @@ KeyValueDB::Iterator RocksDBStore::get_iterator(const std::string& prefix)
   rocksdb::ColumnFamilyHandle *cf_handle =
     static_cast<rocksdb::ColumnFamilyHandle*>(get_cf_handle(prefix));
   if (cf_handle) {
+    auto ps = get_prefix_stats(prefix);
     return std::make_shared<CFIteratorImpl>(
       prefix,
-      db->NewIterator(rocksdb::ReadOptions(), cf_handle));
+      db->NewIterator(rocksdb::ReadOptions(), cf_handle),
+      ps ? ps->logger : nullptr);
   } else {
     return KeyValueDB::get_iterator(prefix);
   }
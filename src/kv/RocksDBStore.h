@@ -10,6 +10,8 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <array>
+#include <atomic>
 #include <boost/scoped_ptr.hpp>
 #include "rocksdb/write_batch.h"
 #include "rocksdb/perf_context.h"
@@ -46,6 +48,21 @@ enum {
   l_rocksdb_last,
 };
 
+// per-prefix counters, one PerfCounters instance per tracked prefix
+enum {
+  l_rocksdb_prefix_first = 34320,
+  l_rocksdb_prefix_gets,
+  l_rocksdb_prefix_get_bytes,
+  l_rocksdb_prefix_get_latency,
+  l_rocksdb_prefix_sets,
+  l_rocksdb_prefix_set_bytes,
+  l_rocksdb_prefix_rmkeys,
+  l_rocksdb_prefix_rm_ranges,
+  l_rocksdb_prefix_merges,
+  l_rocksdb_prefix_seeks,
+  l_rocksdb_prefix_last,
+};
+
 namespace rocksdb{
   class DB;
   class Env;
@@ -57,6 +74,7 @@ namespace rocksdb{
   class Iterator;
   class Logger;
   class ColumnFamilyHandle;
+  class Cache;
   struct Options;
   struct BlockBasedTableOptions;
   struct DBOptions;
@@ -86,8 +104,43 @@ class RocksDBStore : public KeyValueDB {
   bool must_close_default_cf = false;
   rocksdb::ColumnFamilyHandle *default_cf = nullptr;
 
+  /**
+   * Per-prefix accounting for the prefixes listed in
+   * rocksdb_perf_prefixes; everything else lands in "other".  The map is
+   * filled at open and never changes afterwards, so the hot path only
+   * does a lookup and a few atomic increments.
+   */
+  struct PrefixStats {
+    PerfCounters *logger = nullptr;
+    /// get latency histogram, bucket i counts [2^(i-1), 2^i) usec
+    std::array<std::atomic<uint64_t>, 32> get_lat_hist = {};
+
+    void add_get(uint64_t n, uint64_t bytes, utime_t lat);
+    void dump(Formatter *f) const;
+  };
+  map<string, std::unique_ptr<PrefixStats>> prefix_stats;
+  std::unique_ptr<PrefixStats> other_prefix_stats;
+
+  PrefixStats *get_prefix_stats(const string& prefix) {
+    auto p = prefix_stats.find(prefix);
+    if (p != prefix_stats.end()) {
+      return p->second.get();
+    }
+    return other_prefix_stats.get();
+  }
+  void _init_prefix_stats();
+  void _shutdown_prefix_stats();
+  void dump_prefix_stats(Formatter *f);
+
+  class SocketHook;
+  SocketHook *asok_hook = nullptr;
+
   int submit_common(rocksdb::WriteOptions& woptions, KeyValueDB::Transaction t);
   int install_cf_mergeop(const string &cf_name, rocksdb::ColumnFamilyOptions *cf_opt);
+  int parse_cf_options(const string &cf_name, const string &cf_options,
+		       rocksdb::ColumnFamilyOptions *cf_opt);
+  /// CFs given their own block cache via block_cache_ratio
+  map<string, std::shared_ptr<rocksdb::Cache>> cf_block_caches;
   int create_db_dir();
   int do_open(ostream &out, bool create_if_missing,
 	      const vector<ColumnFamily>* cfs = nullptr);
@@ -184,6 +237,8 @@ public:
       return static_cast<rocksdb::ColumnFamilyHandle*>(iter->second);
   }
   int repair(std::ostream &out) override;
+  int migrate_to_column_family(const ColumnFamily& cf,
+			       std::ostream &out) override;
   void split_stats(const std::string &s, char delim, std::vector<std::string> &elems);
   void get_statistics(Formatter *f) override;
 
@@ -324,6 +379,10 @@ public:
       const string &prefix,
       const string &start,
       const string &end) override;
+    void rm_range_keys_bulk(
+      const string &prefix,
+      const string &start,
+      const string &end) override;
     void merge(
       const string& prefix,
       const string& k,
@@ -351,15 +410,23 @@ public:
     const char *key,
     size_t keylen,
     bufferlist *out) override;
+  int get_batch(
+    const string &prefix,
+    const std::vector<string> &keys,
+    std::vector<bufferlist> *values,
+    std::vector<bool> *found) override;
 
 
   class RocksDBWholeSpaceIteratorImpl :
     public KeyValueDB::WholeSpaceIteratorImpl {
   protected:
+    RocksDBStore *store;
     rocksdb::Iterator *dbiter;
+    void note_seek(const string &prefix);
   public:
-    explicit RocksDBWholeSpaceIteratorImpl(rocksdb::Iterator *iter) :
-      dbiter(iter) { }
+    RocksDBWholeSpaceIteratorImpl(RocksDBStore *store,
+				  rocksdb::Iterator *iter) :
+      store(store), dbiter(iter) { }
     //virtual ~RocksDBWholeSpaceIteratorImpl() { }
     ~RocksDBWholeSpaceIteratorImpl() override;
 
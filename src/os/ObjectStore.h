@@ -351,6 +351,8 @@ public:
       OP_COLL_SET_BITS = 42, // cid, bits
 
       OP_MERGE_COLLECTION = 43, // cid, destination
+
+      OP_COLL_REMOVE_RANGE = 44, // cid, oid (first), dest_oid (end)
     };
 
     // Transaction hint type
@@ -629,6 +631,7 @@ public:
 
       case OP_CLONERANGE2:
       case OP_CLONE:
+      case OP_COLL_REMOVE_RANGE:
         ceph_assert(op->cid < cm.size());
         ceph_assert(op->oid < om.size());
         ceph_assert(op->dest_oid < om.size());
@@ -1083,6 +1086,24 @@ public:
       _op->oid = _get_object_id(oid);
       data.ops++;
     }
+    /**
+     * Remove every object in [first, end) of a collection, except its
+     * pgmeta object, in one op.
+     *
+     * This is meant for bulk removal (e.g., PG deletion), where the store
+     * can drop metadata more cheaply than with one OP_REMOVE per object.
+     * Objects created earlier in the same transaction are not guaranteed
+     * to be removed.
+     */
+    void collection_remove_range(const coll_t& cid, const ghobject_t& first,
+				 const ghobject_t& end) {
+      Op* _op = _get_next_op();
+      _op->op = OP_COLL_REMOVE_RANGE;
+      _op->cid = _get_coll_id(cid);
+      _op->oid = _get_object_id(first);
+      _op->dest_oid = _get_object_id(end);
+      data.ops++;
+    }
     /// Set an xattr of an object
     void setattr(const coll_t& cid, const ghobject_t& oid, const char* name, bufferlist& val) {
       string n(name);
@@ -1517,6 +1538,22 @@ public:
     return -EOPNOTSUPP;
   }
 
+  /**
+   * NUMA placement of the backing devices
+   *
+   * @param numa_node [out] the node, if every device is on the same one
+   * @param nodes [out] all nodes the devices are attached to
+   * @param failed [out] devices whose node could not be determined
+   * @return 0 if all devices are on one node, -EXDEV if they are spread
+   *   over several, other negative error if unknown
+   */
+  virtual int get_numa_node(
+    int *numa_node,
+    std::set<int> *nodes,
+    std::set<string> *failed) {
+    return -EOPNOTSUPP;
+  }
+
   /// true if a txn is readable immediately after it is queued.
   virtual bool is_sync_onreadable() const {
     return true;
@@ -1862,6 +1899,20 @@ public:
     set<string> *out         ///< [out] Subset of keys defined on oid
     ) = 0;
 
+  /**
+   * prefetch_objects -- hint that the metadata of oids is about to be read
+   *
+   * Stores may use this to load the objects' metadata in one batch
+   * instead of one lookup per subsequent stat/getattr.  Objects that do
+   * not exist are ignored.
+   *
+   * @param c collection
+   * @param oids objects to prefetch
+   */
+  virtual void prefetch_objects(
+    CollectionHandle &c,
+    const vector<ghobject_t>& oids) {}
+
   /**
    * Returns an object map iterator
    *
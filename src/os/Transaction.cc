@@ -89,6 +89,18 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
       }
       break;
       
+    case Transaction::OP_COLL_REMOVE_RANGE:
+      {
+        coll_t cid = i.get_cid(op->cid);
+        ghobject_t first = i.get_oid(op->oid);
+        ghobject_t end = i.get_oid(op->dest_oid);
+	f->dump_string("op_name", "coll_remove_range");
+	f->dump_stream("collection") << cid;
+	f->dump_stream("first") << first;
+	f->dump_stream("end") << end;
+      }
+      break;
+
     case Transaction::OP_SETATTR:
       {
         coll_t cid = i.get_cid(op->cid);
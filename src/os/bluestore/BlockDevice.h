@@ -145,6 +145,10 @@ public:
   virtual int get_devname(std::string *out) {
     return -ENOENT;
   }
+  /// NUMA node the device hangs off, if the platform tells us
+  virtual int get_numa_node(int *node) const {
+    return -EOPNOTSUPP;
+  }
   virtual int get_devices(std::set<std::string> *ls) {
     std::string s;
     if (get_devname(&s) == 0) {
@@ -118,6 +118,20 @@ void BlueFS::_init_logger()
   b.add_u64_counter(l_bluefs_bytes_written_slow, "bytes_written_slow",
 		    "Bytes written to WAL/SSTs at slow device", NULL,
 		    PerfCountersBuilder::PRIO_USEFUL, unit_t(UNIT_BYTES));
+  b.add_time_avg(l_bluefs_lock_wait_lat, "lock_wait_lat",
+		 "Average time writers waited for the bluefs lock");
+  b.add_time_avg(l_bluefs_log_flush_lat, "log_flush_lat",
+		 "Average time to write and sync a metadata log record");
+  b.add_time_avg(l_bluefs_log_flush_wait_lat, "log_flush_wait_lat",
+		 "Average time spent waiting for an in-progress log flush");
+  b.add_u64_counter(l_bluefs_log_group_commits, "log_group_commits",
+		    "Metadata syncs satisfied by another thread's log flush");
+  b.add_u64_counter(l_bluefs_readahead_bytes, "readahead_bytes",
+		    "Bytes read ahead for sequential read_random() callers",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluefs_readahead_hit_bytes, "readahead_hit_bytes",
+		    "Bytes of read_random() served from read-ahead",
+		    NULL, 0, unit_t(UNIT_BYTES));
   logger = b.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -508,6 +522,20 @@ void BlueFS::get_devices(set<string> *ls)
   }
 }
 
+void BlueFS::get_numa_nodes(set<int> *nodes, set<string> *failed)
+{
+  for (unsigned i = 0; i < MAX_BDEV; ++i) {
+    if (bdev[i]) {
+      int n;
+      if (bdev[i]->get_numa_node(&n) == 0) {
+	nodes->insert(n);
+      } else {
+	bdev[i]->get_devices(failed);
+      }
+    }
+  }
+}
+
 int BlueFS::fsck()
 {
   std::lock_guard<std::mutex> l(lock);
@@ -1035,6 +1063,17 @@ int BlueFS::_read_random(
 	     << std::hex << len << std::dec << dendl;
   }
 
+  if (len && cct->_conf->bluefs_readahead_max) {
+    std::unique_lock<std::mutex> l(h->ra_lock, std::try_to_lock);
+    if (l.owns_lock()) {
+      int r = _read_random_ahead(h, off, len, out);
+      if (r >= 0) {
+	--h->file->num_reading;
+	return r;
+      }
+    }
+  }
+
   int ret = 0;
   while (len > 0) {
     uint64_t x_off = 0;
@@ -1057,6 +1096,148 @@ int BlueFS::_read_random(
   return ret;
 }
 
+int BlueFS::_read_random_ahead(
+  FileReader *h,
+  uint64_t off,
+  size_t len,
+  char *out)
+{
+  // caller holds h->ra_lock
+  bool sequential = (off == h->ra_next);
+  h->ra_next = off + len;
+  if (!sequential) {
+    if (h->ra_seq) {
+      dout(20) << __func__ << " h " << h << " random access at 0x" << std::hex
+	       << off << std::dec << ", dropping read-ahead" << dendl;
+      h->ra_reset();
+      h->ra_seq = 0;
+      h->ra_window = 0;
+    }
+    return -1;
+  }
+  // a single sequential pair is common for random workloads too
+  if (++h->ra_seq < 2) {
+    return -1;
+  }
+
+  auto covers = [&](uint64_t bl_off, const bufferlist& bl) {
+    return off >= bl_off && off + len <= bl_off + bl.length();
+  };
+  // the read-ahead data before this read will not be asked for again
+  uint64_t consumed = std::min<uint64_t>(
+    off > h->ra_off ? off - h->ra_off : 0, h->ra_bl.length());
+  if (consumed) {
+    h->ra_bl.splice(0, consumed);
+    h->ra_off += consumed;
+    *h->ra_budget -= consumed;
+  }
+  uint64_t max_window = cct->_conf->bluefs_readahead_max;
+  bool hit = true;
+  if (!covers(h->ra_off, h->ra_bl)) {
+    if (h->ra_ioc) {
+      h->ra_ioc->aio_wait();
+      if (h->ra_ioc->get_return_value() < 0) {
+	*h->ra_budget -= h->ra_next_bl.length();
+	h->ra_next_bl.clear();
+      }
+      h->ra_ioc.reset();
+    }
+    // unaligned reads straddle the two windows, so join them
+    if (h->ra_next_bl.length()) {
+      if (h->ra_bl.length() == 0) {
+	h->ra_bl.swap(h->ra_next_bl);
+	h->ra_off = h->ra_next_off;
+      } else if (h->ra_next_off == h->ra_off + h->ra_bl.length()) {
+	h->ra_bl.claim_append(h->ra_next_bl);
+      }
+    }
+    if (!covers(h->ra_off, h->ra_bl)) {
+      h->ra_reset();
+      h->ra_window = std::min(max_window,
+			      std::max<uint64_t>(h->ra_window * 2, 64 * 1024));
+      int r = _read_ahead_fetch(h, off, std::max<uint64_t>(len, h->ra_window),
+				&h->ra_off, &h->ra_bl, nullptr);
+      if (r < 0 || !covers(h->ra_off, h->ra_bl)) {
+	h->ra_reset();
+	return -1;
+      }
+      hit = false;
+    }
+  }
+  dout(20) << __func__ << " h " << h << " 0x" << std::hex << off << "~" << len
+	   << " from read-ahead 0x" << h->ra_off << "~" << h->ra_bl.length()
+	   << std::dec << (hit ? "" : " (miss)") << dendl;
+  h->ra_bl.copy(off - h->ra_off, len, out);
+  if (hit) {
+    logger->inc(l_bluefs_readahead_hit_bytes, len);
+  }
+
+  // prefetch the next window while the caller consumes this one
+  uint64_t end = h->ra_off + h->ra_bl.length();
+  if (!h->ra_ioc && h->ra_next_bl.length() == 0 &&
+      end < h->file->fnode.size) {
+    h->ra_ioc.reset(new IOContext(cct, NULL));
+    int r = _read_ahead_fetch(h, end, h->ra_window, &h->ra_next_off,
+			      &h->ra_next_bl, h->ra_ioc.get());
+    if (r < 0) {
+      h->ra_ioc.reset();
+    }
+  }
+  return len;
+}
+
+int BlueFS::_read_ahead_fetch(
+  FileReader *h,
+  uint64_t off,
+  uint64_t len,
+  uint64_t *bl_off,
+  bufferlist *bl,
+  IOContext *aio)
+{
+  uint64_t start = off & super.block_mask();
+  uint64_t eof = round_up_to(h->file->fnode.size, super.block_size);
+  if (start >= eof) {
+    return -ERANGE;
+  }
+  uint64_t x_off = 0;
+  auto p = h->file->fnode.seek(start, &x_off);
+  if (p == h->file->fnode.extents.end()) {
+    return -ERANGE;
+  }
+  uint64_t l = round_up_to(off + len - start, super.block_size);
+  l = std::min(l, p->length - x_off);
+  l = std::min(l, eof - start);
+  uint64_t max = cct->_conf->bluefs_readahead_total_max;
+  uint64_t cur = readahead_bytes;
+  do {
+    if (cur + l > max) {
+      dout(20) << __func__ << " read-ahead budget exhausted" << dendl;
+      return -ENOMEM;
+    }
+  } while (!readahead_bytes.compare_exchange_weak(cur, cur + l));
+  h->ra_budget = &readahead_bytes;
+  *bl_off = start;
+  dout(20) << __func__ << " h " << h << " 0x" << std::hex << start << "~" << l
+	   << std::dec << (aio ? " (async)" : "") << dendl;
+  int r;
+  if (aio) {
+    r = bdev[p->bdev]->aio_read(p->offset + x_off, l, bl, aio);
+    if (r == 0 && aio->has_pending_aios()) {
+      bdev[p->bdev]->aio_submit(aio);
+    }
+  } else {
+    r = bdev[p->bdev]->read(p->offset + x_off, l, bl, ioc[p->bdev],
+			    cct->_conf->bluefs_buffered_io);
+  }
+  if (r < 0) {
+    readahead_bytes -= l;
+    bl->clear();
+    return r;
+  }
+  logger->inc(l_bluefs_readahead_bytes, l);
+  return 0;
+}
+
 int BlueFS::_read(
   FileReader *h,         ///< [in] read from here
   FileReaderBuffer *buf, ///< [in] reader state
@@ -1480,16 +1661,22 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
 				uint64_t want_seq,
 				uint64_t jump_to)
 {
-  while (log_flushing) {
-    dout(10) << __func__ << " want_seq " << want_seq
-	     << " log is currently flushing, waiting" << dendl;
-    ceph_assert(!jump_to);
-    log_cond.wait(l);
+  if (log_flushing) {
+    auto start = mono_clock::now();
+    while (log_flushing) {
+      dout(10) << __func__ << " want_seq " << want_seq
+	       << " log is currently flushing, waiting" << dendl;
+      ceph_assert(!jump_to);
+      log_cond.wait(l);
+    }
+    logger->tinc(l_bluefs_log_flush_wait_lat, mono_clock::now() - start);
   }
   if (want_seq && want_seq <= log_seq_stable) {
     dout(10) << __func__ << " want_seq " << want_seq << " <= log_seq_stable "
 	     << log_seq_stable << ", done" << dendl;
     ceph_assert(!jump_to);
+    // everything we dirtied went out with someone else's log record
+    logger->inc(l_bluefs_log_group_commits);
     return 0;
   }
   if (log_t.empty() && dirty_files.empty()) {
@@ -1499,6 +1686,7 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
     return 0;
   }
 
+  auto flush_start = mono_clock::now();
   vector<interval_set<uint64_t>> to_release(pending_release.size());
   to_release.swap(pending_release);
 
@@ -1566,6 +1754,7 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
 
   log_flushing = false;
   log_cond.notify_all();
+  logger->tinc(l_bluefs_log_flush_lat, mono_clock::now() - flush_start);
 
   // clean dirty files
   if (seq > log_seq_stable) {
@@ -1620,6 +1809,30 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<std::mutex>& l,
   return 0;
 }
 
+void BlueFS::_wait_for_tail_aio(FileWriter *h)
+{
+  if (!h->tail_block.length()) {
+    return;
+  }
+  // we are about to rewrite the partial tail block, so the previous aio
+  // must land first.  only this writer touches h, so do not make every
+  // other writer wait on our device behind the global lock; the log
+  // writer is the exception, it runs under the lock throughout.
+  dout(20) << __func__ << " waiting for previous aio to complete" << dendl;
+  bool unlock = h->file->fnode.ino > 1;
+  if (unlock) {
+    lock.unlock();
+  }
+  for (auto p : h->iocv) {
+    if (p) {
+      p->aio_wait();
+    }
+  }
+  if (unlock) {
+    lock.lock();
+  }
+}
+
 int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
 {
   dout(10) << __func__ << " " << h << " pos 0x" << std::hex << h->pos
@@ -1629,6 +1842,7 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   ceph_assert(h->file->num_readers.load() == 0);
 
   h->buffer_appender.flush();
+  _wait_for_tail_aio(h);
 
   bool buffered;
   if (h->file->fnode.ino == 1)
@@ -1730,12 +1944,6 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
     x_off -= partial;
     offset -= partial;
     length += partial;
-    dout(20) << __func__ << " waiting for previous aio to complete" << dendl;
-    for (auto p : h->iocv) {
-      if (p) {
-	p->aio_wait();
-      }
-    }
   }
   if (length == partial + h->buffer.length()) {
     bl.claim_append_piecewise(h->buffer);
@@ -1962,6 +2170,16 @@ void BlueFS::_flush_bdev_safely(FileWriter *h)
   }
 }
 
+void BlueFS::_lock_tracked(std::unique_lock<std::mutex>& l)
+{
+  if (l.try_lock()) {
+    return;
+  }
+  auto start = mono_clock::now();
+  l.lock();
+  logger->tinc(l_bluefs_lock_wait_lat, mono_clock::now() - start);
+}
+
 void BlueFS::flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs)
 {
   // NOTE: this is safe to call without a lock.
@@ -2063,7 +2281,10 @@ void BlueFS::sync_metadata()
   } else {
     dout(10) << __func__ << dendl;
     utime_t start = ceph_clock_now();
+    // no need to hold the lock while the devices flush
+    l.unlock();
     flush_bdev(); // FIXME?
+    l.lock();
     _flush_and_sync_log(l);
     dout(10) << __func__ << " done in " << (ceph_clock_now() - start) << dendl;
   }
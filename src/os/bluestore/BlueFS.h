@@ -36,6 +36,12 @@ enum {
   l_bluefs_bytes_written_wal,
   l_bluefs_bytes_written_sst,
   l_bluefs_bytes_written_slow,
+  l_bluefs_lock_wait_lat,
+  l_bluefs_log_flush_lat,
+  l_bluefs_log_flush_wait_lat,
+  l_bluefs_log_group_commits,
+  l_bluefs_readahead_bytes,
+  l_bluefs_readahead_hit_bytes,
   l_bluefs_last,
 };
 
@@ -199,6 +205,19 @@ public:
     bool random;
     bool ignore_eof;        ///< used when reading our log file
 
+    // read-ahead for read_random().  rocksdb may read one file from
+    // several threads at once; whoever finds ra_lock busy reads directly.
+    std::mutex ra_lock;
+    uint64_t ra_next = 0;      ///< offset a sequential read would start at
+    unsigned ra_seq = 0;       ///< consecutive sequential reads seen
+    uint64_t ra_window = 0;    ///< current read-ahead size
+    uint64_t ra_off = 0;       ///< logical offset of ra_bl
+    bufferlist ra_bl;          ///< data read ahead
+    uint64_t ra_next_off = 0;  ///< logical offset of ra_next_bl
+    bufferlist ra_next_bl;     ///< target of the in-flight prefetch
+    std::unique_ptr<IOContext> ra_ioc;  ///< set while a prefetch is in flight
+    std::atomic<uint64_t> *ra_budget = nullptr;  ///< bytes held by all readers
+
     FileReader(FileRef f, uint64_t mpf, bool rand, bool ie)
       : file(f),
 	buf(mpf),
@@ -207,8 +226,22 @@ public:
       ++file->num_readers;
     }
     ~FileReader() {
+      ra_reset();
       --file->num_readers;
     }
+
+    /// wait for any prefetch and drop all read-ahead data
+    void ra_reset() {
+      if (ra_ioc) {
+	ra_ioc->aio_wait();
+	ra_ioc.reset();
+      }
+      if (ra_budget) {
+	*ra_budget -= ra_bl.length() + ra_next_bl.length();
+      }
+      ra_bl.clear();
+      ra_next_bl.clear();
+    }
   };
 
   struct FileLock {
@@ -273,6 +306,7 @@ private:
 
   int _allocate(uint8_t bdev, uint64_t len,
 		bluefs_fnode_t* node);
+  void _wait_for_tail_aio(FileWriter *h);  ///< before rewriting the tail block
   int _flush_range(FileWriter *h, uint64_t offset, uint64_t length);
   int _flush(FileWriter *h, bool force);
   int _fsync(FileWriter *h, std::unique_lock<std::mutex>& l);
@@ -294,6 +328,9 @@ private:
   //void _aio_finish(void *priv);
 
   void _flush_bdev_safely(FileWriter *h);
+
+  /// take the global lock, accounting any time spent waiting for it
+  void _lock_tracked(std::unique_lock<std::mutex>& l);
   void flush_bdev();  // this is safe to call without a lock
   void flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs);  // this is safe to call without a lock
 
@@ -312,6 +349,14 @@ private:
     uint64_t offset, ///< [in] offset
     size_t len,      ///< [in] this many bytes
     char *out);      ///< [out] optional: or copy it here
+  /// serve a read_random() from read-ahead; -1 if the caller should read
+  int _read_random_ahead(FileReader *h, uint64_t offset, size_t len,
+			 char *out);
+  /// fill *bl from offset on, staying within one extent and the budget
+  int _read_ahead_fetch(FileReader *h, uint64_t offset, uint64_t len,
+			uint64_t *bl_off, bufferlist *bl, IOContext *aio);
+
+  std::atomic<uint64_t> readahead_bytes = {0};  ///< held by all FileReaders
 
   void _invalidate_cache(FileRef f, uint64_t offset, uint64_t length);
 
@@ -344,6 +389,7 @@ public:
 
   void collect_metadata(map<string,string> *pm, unsigned skip_bdev_id);
   void get_devices(set<string> *ls);
+  void get_numa_nodes(set<int> *nodes, set<string> *failed);
   int fsck();
 
   uint64_t get_used();
@@ -351,6 +397,9 @@ public:
   uint64_t get_free(unsigned id);
   void get_usage(vector<pair<uint64_t,uint64_t>> *usage); // [<free,total> ...]
   void dump_perf_counters(Formatter *f);
+  PerfCounters *get_perf_counters() {
+    return logger;
+  }
 
   void dump_block_extents(ostream& out);
 
@@ -412,15 +461,18 @@ public:
   void handle_discard(unsigned dev, interval_set<uint64_t>& to_release);
 
   void flush(FileWriter *h) {
-    std::lock_guard<std::mutex> l(lock);
+    std::unique_lock<std::mutex> l(lock, std::defer_lock);
+    _lock_tracked(l);
     _flush(h, false);
   }
   void flush_range(FileWriter *h, uint64_t offset, uint64_t length) {
-    std::lock_guard<std::mutex> l(lock);
+    std::unique_lock<std::mutex> l(lock, std::defer_lock);
+    _lock_tracked(l);
     _flush_range(h, offset, length);
   }
   int fsync(FileWriter *h) {
-    std::unique_lock<std::mutex> l(lock);
+    std::unique_lock<std::mutex> l(lock, std::defer_lock);
+    _lock_tracked(l);
     return _fsync(h, l);
   }
   int read(FileReader *h, FileReaderBuffer *buf, uint64_t offset, size_t len,
@@ -72,6 +72,8 @@ const string PREFIX_DEFERRED = "L";  // id -> deferred_transaction_t
 const string PREFIX_ALLOC = "B";   // u64 offset -> u64 length (freelist)
 const string PREFIX_ALLOC_BITMAP = "b"; // (see BitmapFreelistManager)
 const string PREFIX_SHARED_BLOB = "X"; // u64 offset -> shared_blob_t
+const string PREFIX_TIER = "H";    // onode key -> object data copy
+const string PREFIX_ALLOC_SNAPSHOT = "A"; // u64 chunk -> interval_set (free)
 
 // write a label in the first block.  always use this size.  note that
 // bluefs makes a matching assumption about the location of its
@@ -776,6 +778,8 @@ BlueStore::Cache *BlueStore::Cache::create(CephContext* cct, string type,
     c = new LRUCache(cct);
   else if (type == "2q")
     c = new TwoQCache(cct);
+  else if (type == "clock")
+    c = new ClockCache(cct);
   else
     ceph_abort_msg("unrecognized cache type");
 
@@ -1214,6 +1218,130 @@ void BlueStore::TwoQCache::_audit(const char *when)
 #endif
 
 
+// ClockCache
+#undef dout_prefix
+#define dout_prefix *_dout << "bluestore.ClockCache(" << this << ") "
+
+void BlueStore::ClockCache::trim(uint64_t onode_max, uint64_t buffer_max)
+{
+  // trim in batches so that readers and writers waiting on the shard
+  // lock are not stalled behind a long sweep
+  uint64_t batch = cct->_conf.get_val<uint64_t>(
+    "bluestore_cache_clock_trim_batch");
+  trim_state_t ts;
+  bool more;
+  do {
+    std::lock_guard<std::recursive_mutex> l(lock);
+    more = _trim_some(onode_max, buffer_max, batch, &ts);
+  } while (more);
+}
+
+void BlueStore::ClockCache::_trim(uint64_t onode_max, uint64_t buffer_max)
+{
+  trim_state_t ts;
+  while (_trim_some(onode_max, buffer_max,
+		    std::numeric_limits<unsigned>::max(), &ts)) ;
+}
+
+bool BlueStore::ClockCache::_trim_some(uint64_t onode_max,
+				       uint64_t buffer_max,
+				       unsigned max_work,
+				       trim_state_t *ts)
+{
+  dout(20) << __func__ << " onodes " << onode_ring.size() << " / " << onode_max
+	   << " buffers " << buffer_size << " / " << buffer_max
+	   << dendl;
+
+  _audit("trim start");
+
+  if (!ts->started) {
+    // visit each ring entry at most once per trim(), no matter how many
+    // batches it takes or how often entries are re-referenced meanwhile
+    ts->started = true;
+    ts->buffers_left = buffer_ring.size();
+    ts->onodes_left = onode_ring.size();
+  }
+
+  unsigned work = 0;
+
+  // buffers
+  while (buffer_size > buffer_max) {
+    if (buffer_ring.empty() || ts->buffers_left == 0) {
+      break;
+    }
+    if (work++ >= max_work) {
+      return true;
+    }
+    --ts->buffers_left;
+    Buffer *b = &buffer_ring.back();
+    if (b->cache_private) {
+      // referenced since the last sweep: second chance
+      b->cache_private = 0;
+      buffer_ring.erase(buffer_ring.iterator_to(*b));
+      buffer_ring.push_front(*b);
+      continue;
+    }
+    ceph_assert(b->is_clean());
+    dout(20) << __func__ << " rm " << *b << dendl;
+    b->space->_rm_buffer(this, b);
+  }
+
+  // onodes
+  int max_skipped = g_conf()->bluestore_cache_trim_max_skip_pinned;
+  while (onode_ring.size() > onode_max) {
+    if (ts->onodes_left == 0) {
+      dout(20) << __func__ << " full pass done; stopping with "
+	       << (onode_ring.size() - onode_max) << " left to trim" << dendl;
+      break;
+    }
+    if (work++ >= max_work) {
+      return true;
+    }
+    --ts->onodes_left;
+    Onode *o = &onode_ring.back();
+    bool pinned = false;
+    if (o->cache_ref.exchange(false, std::memory_order_relaxed)) {
+      // referenced since the last sweep: second chance
+    } else if (o->nref.load() > 1 ||
+	       !o->c->onode_map.remove_if_unpinned(o)) {
+      int refs = o->nref.load();
+      dout(20) << __func__ << "  " << o->oid << " has " << refs
+	       << " refs, skipping" << dendl;
+      pinned = true;
+    } else {
+      // o is gone
+      continue;
+    }
+    onode_ring.erase(onode_ring.iterator_to(*o));
+    onode_ring.push_front(*o);
+    if (pinned && ++ts->skipped >= max_skipped) {
+      dout(20) << __func__ << " maximum skip pinned reached; stopping with "
+	       << (onode_ring.size() - onode_max) << " left to trim" << dendl;
+      break;
+    }
+  }
+  return false;
+}
+
+#ifdef DEBUG_CACHE
+void BlueStore::ClockCache::_audit(const char *when)
+{
+  dout(10) << __func__ << " " << when << " start" << dendl;
+  uint64_t s = 0;
+  for (auto i = buffer_ring.begin(); i != buffer_ring.end(); ++i) {
+    s += i->length;
+  }
+  if (s != buffer_size) {
+    derr << __func__ << " buffer_size " << buffer_size << " actual " << s
+	 << dendl;
+    ceph_assert(s == buffer_size);
+  }
+  dout(20) << __func__ << " " << when << " buffer_size " << buffer_size
+	   << " ok" << dendl;
+}
+#endif
+
+
 // BufferSpace
 
 #undef dout_prefix
@@ -1315,7 +1443,7 @@ void BlueStore::BufferSpace::read(
   uint32_t end = offset + length;
 
   {
-    std::lock_guard<std::recursive_mutex> l(cache->lock);
+    auto l = cache->lock_and_track();
     for (auto i = _data_lower_bound(offset);
          i != buffer_map.end() && offset < end && i->first < end;
          ++i) {
@@ -1464,6 +1592,7 @@ void BlueStore::BufferSpace::split(Cache* cache, size_t pos, BlueStore::BufferSp
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  std::unique_lock<std::shared_mutex> ml(map_lock);
   auto p = onode_map.find(oid);
   if (p != onode_map.end()) {
     ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
@@ -1477,6 +1606,23 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o
   return o;
 }
 
+bool BlueStore::OnodeSpace::remove_if_unpinned(Onode *o)
+{
+  // note: we already hold cache->lock.  Lockless lookups take their
+  // reference under the shared map_lock, so nref is stable while we
+  // hold it exclusively.
+  std::unique_lock<std::shared_mutex> ml(map_lock);
+  auto p = onode_map.find(o->oid);
+  ceph_assert(p != onode_map.end() && p->second == o);
+  if (o->nref.load() > 1) {
+    return false;
+  }
+  ldout(cache->cct, 30) << __func__ << " " << o->oid << dendl;
+  cache->_rm_onode(p->second);
+  onode_map.erase(p);
+  return true;
+}
+
 BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
   ldout(cache->cct, 30) << __func__ << dendl;
@@ -1484,7 +1630,14 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
   bool hit = false;
 
   {
-    std::lock_guard<std::recursive_mutex> l(cache->lock);
+    // with a lockless cache a hit only needs the (shared) map_lock
+    std::unique_lock<std::recursive_mutex> l;
+    std::shared_lock<std::shared_mutex> ml;
+    if (cache->lockless_onode_hits()) {
+      ml = std::shared_lock<std::shared_mutex>(map_lock);
+    } else {
+      l = cache->lock_and_track();
+    }
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
     if (p == onode_map.end()) {
       ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
@@ -1508,6 +1661,7 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  std::unique_lock<std::shared_mutex> ml(map_lock);
   ldout(cache->cct, 10) << __func__ << dendl;
   for (auto &p : onode_map) {
     cache->_rm_onode(p.second);
@@ -1528,6 +1682,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_other::string& new_okey)
 {
   std::lock_guard<std::recursive_mutex> l(cache->lock);
+  std::unique_lock<std::shared_mutex> ml(map_lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -3335,29 +3490,83 @@ BlueStore::OnodeRef BlueStore::Collection::get_onode(
   } else {
     // loaded
     ceph_assert(r >= 0);
-    on = new Onode(this, oid, key);
-    on->exists = true;
-    auto p = v.front().begin_deep();
-    on->onode.decode(p);
-    for (auto& i : on->onode.attrs) {
-      i.second.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
-    }
-
-    // initialize extent_map
-    on->extent_map.decode_spanning_blobs(p);
-    if (on->onode.extent_map_shards.empty()) {
-      denc(on->extent_map.inline_bl, p);
-      on->extent_map.decode_some(on->extent_map.inline_bl);
-      on->extent_map.inline_bl.reassign_to_mempool(
-	mempool::mempool_bluestore_cache_other);
-    } else {
-      on->extent_map.init_shards(false, false);
-    }
+    on = _decode_onode(oid, key, v);
   }
   o.reset(on);
   return onode_map.add(oid, o);
 }
 
+BlueStore::Onode *BlueStore::Collection::_decode_onode(
+  const ghobject_t& oid,
+  const mempool::bluestore_cache_other::string& key,
+  const bufferlist& v)
+{
+  Onode *on = new Onode(this, oid, key);
+  on->exists = true;
+  auto p = v.front().begin_deep();
+  on->onode.decode(p);
+  for (auto& i : on->onode.attrs) {
+    i.second.reassign_to_mempool(mempool::mempool_bluestore_cache_other);
+  }
+
+  // initialize extent_map
+  on->extent_map.decode_spanning_blobs(p);
+  if (on->onode.extent_map_shards.empty()) {
+    denc(on->extent_map.inline_bl, p);
+    on->extent_map.decode_some(on->extent_map.inline_bl);
+    on->extent_map.inline_bl.reassign_to_mempool(
+      mempool::mempool_bluestore_cache_other);
+  } else {
+    on->extent_map.init_shards(false, false);
+  }
+  return on;
+}
+
+void BlueStore::Collection::prefetch_onodes(const vector<ghobject_t>& oids)
+{
+  ceph_assert(lock.is_locked());
+
+  spg_t pgid;
+  bool is_pg = cid.is_pg(&pgid);
+  vector<const ghobject_t*> want;
+  vector<string> keys;
+  want.reserve(oids.size());
+  keys.reserve(oids.size());
+  for (auto& oid : oids) {
+    if (is_pg && !oid.match(cnode.bits, pgid.ps())) {
+      continue;
+    }
+    if (onode_map.lookup(oid)) {
+      continue;
+    }
+    string key;
+    get_object_key(store->cct, oid, &key);
+    want.push_back(&oid);
+    keys.push_back(std::move(key));
+  }
+  if (keys.empty()) {
+    return;
+  }
+
+  vector<bufferlist> values;
+  vector<bool> found;
+  store->db->get_batch(PREFIX_OBJ, keys, &values, &found);
+  unsigned loaded = 0;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (!found[i] || values[i].length() == 0) {
+      continue;
+    }
+    mempool::bluestore_cache_other::string key(keys[i].begin(),
+						keys[i].end());
+    OnodeRef o(_decode_onode(*want[i], key, values[i]));
+    onode_map.add(*want[i], o);
+    ++loaded;
+  }
+  ldout(store->cct, 20) << __func__ << " " << cid << " loaded " << loaded
+			<< "/" << keys.size() << " of " << oids.size()
+			<< dendl;
+}
+
 void BlueStore::Collection::split_cache(
   Collection *dest)
 {
@@ -3367,6 +3576,10 @@ void BlueStore::Collection::split_cache(
   std::lock(cache->lock, dest->cache->lock);
   std::lock_guard<std::recursive_mutex> l(cache->lock, std::adopt_lock);
   std::lock_guard<std::recursive_mutex> l2(dest->cache->lock, std::adopt_lock);
+  std::lock(onode_map.map_lock, dest->onode_map.map_lock);
+  std::unique_lock<std::shared_mutex> ml(onode_map.map_lock, std::adopt_lock);
+  std::unique_lock<std::shared_mutex> ml2(dest->onode_map.map_lock,
+					  std::adopt_lock);
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
@@ -3845,9 +4058,11 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    tier_thread(this),
     mempool_thread(this)
 {
   _init_logger();
+  _init_asok();
   cct->_conf.add_observer(this);
   set_cache_shards(1);
 }
@@ -3865,11 +4080,13 @@ BlueStore::BlueStore(CephContext *cct,
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    tier_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(ctz(_min_alloc_size)),
     mempool_thread(this)
 {
   _init_logger();
+  _init_asok();
   cct->_conf.add_observer(this);
   set_cache_shards(1);
 }
@@ -3877,6 +4094,7 @@ BlueStore::BlueStore(CephContext *cct,
 BlueStore::~BlueStore()
 {
   cct->_conf.remove_observer(this);
+  _shutdown_asok();
   _shutdown_logger();
   ceph_assert(!mounted);
   ceph_assert(db == NULL);
@@ -3909,6 +4127,8 @@ const char **BlueStore::get_tracked_conf_keys() const
     "bluestore_deferred_batch_ops",
     "bluestore_deferred_batch_ops_hdd",
     "bluestore_deferred_batch_ops_ssd",
+    "bluestore_deferred_batch_adaptive",
+    "bluestore_deferred_batch_max_wait",
     "bluestore_throttle_bytes",
     "bluestore_throttle_deferred_bytes",
     "bluestore_throttle_cost_per_io_hdd",
@@ -3950,7 +4170,9 @@ void BlueStore::handle_conf_change(const ConfigProxy& conf,
       changed.count("bluestore_max_alloc_size") ||
       changed.count("bluestore_deferred_batch_ops") ||
       changed.count("bluestore_deferred_batch_ops_hdd") ||
-      changed.count("bluestore_deferred_batch_ops_ssd")) {
+      changed.count("bluestore_deferred_batch_ops_ssd") ||
+      changed.count("bluestore_deferred_batch_adaptive") ||
+      changed.count("bluestore_deferred_batch_max_wait")) {
     if (bdev) {
       // only after startup
       _set_alloc_sizes();
@@ -4225,10 +4447,22 @@ void BlueStore::_init_logger()
     "Average read onode metadata latency");
   b.add_time_avg(l_bluestore_read_wait_aio_lat, "read_wait_aio_lat",
     "Average read latency");
+  b.add_u64_counter(l_bluestore_read_sliced_bytes, "read_sliced_bytes",
+    "Sum for bytes returned by reference to device or cache buffers",
+    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_read_copied_bytes, "read_copied_bytes",
+    "Sum for bytes returned in newly built buffers (holes, decompressed data)",
+    NULL, 0, unit_t(UNIT_BYTES));
   b.add_time_avg(l_bluestore_compress_lat, "compress_lat",
     "Average compress latency");
   b.add_time_avg(l_bluestore_decompress_lat, "decompress_lat",
     "Average decompress latency");
+  b.add_u64_counter(l_bluestore_decompress_cache_hit_bytes,
+    "decompress_cache_hit_bytes",
+    "Sum for bytes of compressed blobs read from the cache",
+    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_time(l_bluestore_decompress_saved_time, "decompress_saved_time",
+    "Estimated decompression time avoided by compressed blob cache hits");
   b.add_time_avg(l_bluestore_csum_lat, "csum_lat",
     "Average checksum latency");
   b.add_u64_counter(l_bluestore_compress_success_count, "compress_success_count",
@@ -4241,6 +4475,35 @@ void BlueStore::_init_logger()
 		    "Sum for deferred write op");
   b.add_u64_counter(l_bluestore_deferred_write_bytes, "deferred_write_bytes",
 		    "Sum for deferred write bytes", "def", 0, unit_t(UNIT_BYTES));
+  PerfHistogramCommon::axis_config_d deferred_txc_axis{
+    "Batch size (txcs)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    1,
+    16,
+  };
+  PerfHistogramCommon::axis_config_d deferred_bytes_axis{
+    "Batch size (bytes)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    4096,
+    20,
+  };
+  PerfHistogramCommon::axis_config_d deferred_wait_axis{
+    "Queue wait (usec)",
+    PerfHistogramCommon::SCALE_LOG2,
+    0,
+    10,  ///< 10usec
+    20,  ///< up to ~2.6s
+  };
+  b.add_u64_counter_histogram(
+    l_bluestore_deferred_batch_hist, "deferred_batch_txc_bytes_histogram",
+    deferred_txc_axis, deferred_bytes_axis,
+    "Histogram of deferred batch size in txcs + bytes");
+  b.add_u64_counter_histogram(
+    l_bluestore_deferred_wait_hist, "deferred_batch_wait_txc_histogram",
+    deferred_wait_axis, deferred_txc_axis,
+    "Histogram of deferred batch queue wait + size in txcs");
   b.add_u64_counter(l_bluestore_write_penalty_read_ops, "write_penalty_read_ops",
 		    "Sum for write penalty read ops");
   b.add_u64(l_bluestore_allocated, "bluestore_allocated",
@@ -4277,6 +4540,12 @@ void BlueStore::_init_logger()
 	    "Sum for bytes of read hit in the cache", NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_buffer_miss_bytes, "bluestore_buffer_miss_bytes",
 	    "Sum for bytes of read missed in the cache", NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64(l_bluestore_onode_hit_permille, "bluestore_onode_hit_permille",
+	    "Onode cache hit ratio (per mille) over the last trim interval");
+  b.add_u64(l_bluestore_buffer_hit_permille, "bluestore_buffer_hit_permille",
+	    "Buffer cache hit ratio (per mille, by bytes) over the last trim interval");
+  b.add_time_avg(l_bluestore_cache_lock_wait_lat, "cache_lock_wait_lat",
+		 "Average time spent waiting for a contended cache shard lock");
 
   b.add_u64_counter(l_bluestore_write_big, "bluestore_write_big",
 		    "Large aligned writes into fresh blobs");
@@ -4311,10 +4580,40 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_gc_merged, "bluestore_gc_merged",
 		    "Sum for extents that have been merged due to garbage "
 		    "collection");
+  b.add_u64_counter(l_bluestore_defrag_candidates,
+		    "bluestore_defrag_candidates",
+		    "Objects found fragmented on read");
+  b.add_u64_counter(l_bluestore_defrag_objects, "bluestore_defrag_objects",
+		    "Fragmented objects rewritten");
+  b.add_u64_counter(l_bluestore_defrag_bytes, "bluestore_defrag_bytes",
+		    "Sum for bytes rewritten by defragmentation",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_defrag_extents_removed,
+		    "bluestore_defrag_extents_removed",
+		    "Sum for logical extents removed by defragmentation");
+  b.add_u64_counter(l_bluestore_defrag_reclaimed_bytes,
+		    "bluestore_defrag_reclaimed_bytes",
+		    "Sum for allocated bytes released by defragmentation",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_read_eio, "bluestore_read_eio",
                     "Read EIO errors propagated to high level callers");
   b.add_u64_counter(l_bluestore_reads_with_retries, "bluestore_reads_with_retries",
                     "Read operations that required at least one retry due to failed checksum validation");
+  b.add_u64_counter(l_bluestore_bulk_remove_objects,
+		    "bluestore_bulk_remove_objects",
+		    "Objects removed by collection range removal");
+  b.add_u64_counter(l_bluestore_bulk_remove_omap_rmrange,
+		    "bluestore_bulk_remove_omap_rmrange",
+		    "Omaps dropped with a single range delete by collection "
+		    "range removal");
+  b.add_u64_counter(l_bluestore_tier_hit, "bluestore_tier_hit",
+		    "Reads served from the block.db tier");
+  b.add_u64_counter(l_bluestore_tier_promote, "bluestore_tier_promote",
+		    "Objects copied to the block.db tier");
+  b.add_u64_counter(l_bluestore_tier_demote, "bluestore_tier_demote",
+		    "Objects dropped from the block.db tier");
+  b.add_u64(l_bluestore_tier_bytes, "bluestore_tier_bytes",
+	    "Object data kept on the block.db tier");
   b.add_u64(l_bluestore_fragmentation, "bluestore_fragmentation_micros",
             "How fragmented bluestore free space is (free extents / max possible number of free extents) * 1000");
   logger = b.create_perf_counters();
@@ -4342,6 +4641,260 @@ void BlueStore::_shutdown_logger()
   delete logger;
 }
 
+// TxcTrace
+
+void BlueStore::TxcTrace::record(const TransContext *txc)
+{
+  uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+  slot_t& s = slots[n % size];
+  s.version.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.seq = txc->seq;
+  s.is_pg = txc->osr->cid.is_pg(&s.pgid);
+  s.start = txc->start;
+  s.bytes = txc->bytes;
+  std::copy(std::begin(txc->state_lat), std::end(txc->state_lat),
+	    std::begin(s.state_lat));
+  s.version.store(2 * n + 2, std::memory_order_release);
+}
+
+void BlueStore::TxcTrace::snapshot(vector<record_t> *out) const
+{
+  uint64_t h = head.load(std::memory_order_acquire);
+  for (uint64_t n = h > size ? h - size : 0; n < h; ++n) {
+    const slot_t& s = slots[n % size];
+    uint64_t v = s.version.load(std::memory_order_acquire);
+    if (v != 2 * n + 2) {
+      continue;  // still being written, or already recycled
+    }
+    record_t r;
+    r.seq = s.seq;
+    r.cid = s.is_pg ? coll_t(s.pgid) : coll_t::meta();
+    r.start = s.start;
+    r.bytes = s.bytes;
+    std::copy(std::begin(s.state_lat), std::end(s.state_lat),
+	      std::begin(r.state_lat));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.version.load(std::memory_order_relaxed) != v) {
+      continue;
+    }
+    out->push_back(std::move(r));
+  }
+}
+
+void BlueStore::TxcTrace::dump(Formatter *f) const
+{
+  vector<record_t> v;
+  snapshot(&v);
+  f->open_array_section("txcs");
+  for (auto& r : v) {
+    f->open_object_section("txc");
+    f->dump_unsigned("seq", r.seq);
+    f->dump_stream("cid") << r.cid;
+    f->dump_stream("start") << r.start;
+    f->dump_unsigned("bytes", r.bytes);
+    f->open_object_section("state_lat_usec");
+    for (int i = 0; i < TransContext::NUM_STATE_LAT; ++i) {
+      f->dump_unsigned(
+	TransContext::get_state_latency_name(l_bluestore_state_prepare_lat + i),
+	r.state_lat[i]);
+    }
+    f->close_section();
+    f->close_section();
+  }
+  f->close_section();
+}
+
+// dump percentiles and a log2(usec) histogram of the given latencies
+static void dump_lat_distribution(Formatter *f, vector<uint32_t>& lat)
+{
+  std::sort(lat.begin(), lat.end());
+  uint64_t sum = 0;
+  vector<uint64_t> hist;
+  for (auto l : lat) {
+    sum += l;
+    unsigned b = cbits(l);
+    if (hist.size() <= b) {
+      hist.resize(b + 1);
+    }
+    ++hist[b];
+  }
+  auto pct = [&](unsigned permille) -> uint32_t {
+    if (lat.empty()) {
+      return 0;
+    }
+    return lat[std::min<size_t>(lat.size() - 1,
+				lat.size() * permille / 1000)];
+  };
+  f->dump_unsigned("count", lat.size());
+  f->dump_unsigned("avg", lat.empty() ? 0 : sum / lat.size());
+  f->dump_unsigned("p50", pct(500));
+  f->dump_unsigned("p99", pct(990));
+  f->dump_unsigned("p999", pct(999));
+  f->dump_unsigned("max", lat.empty() ? 0 : lat.back());
+  f->open_array_section("log2_usec_histogram");
+  for (auto h : hist) {
+    f->dump_unsigned("count", h);
+  }
+  f->close_section();
+}
+
+void BlueStore::TxcTrace::dump_histograms(Formatter *f) const
+{
+  vector<record_t> v;
+  snapshot(&v);
+  map<coll_t, vector<const record_t*>> by_osr;
+  for (auto& r : v) {
+    by_osr[r.cid].push_back(&r);
+  }
+  auto dump_states = [&](const vector<const record_t*>& rs) {
+    f->open_object_section("states");
+    vector<uint32_t> lat;
+    lat.reserve(rs.size());
+    for (int i = 0; i < TransContext::NUM_STATE_LAT; ++i) {
+      lat.clear();
+      for (auto r : rs) {
+	lat.push_back(r->state_lat[i]);
+      }
+      f->open_object_section(
+	TransContext::get_state_latency_name(l_bluestore_state_prepare_lat + i));
+      dump_lat_distribution(f, lat);
+      f->close_section();
+    }
+    f->close_section();
+  };
+
+  vector<const record_t*> all;
+  all.reserve(v.size());
+  for (auto& r : v) {
+    all.push_back(&r);
+  }
+  f->open_object_section("txc_histograms");
+  f->dump_unsigned("num_txcs", v.size());
+  dump_states(all);
+  f->open_array_section("osrs");
+  for (auto& p : by_osr) {
+    f->open_object_section("osr");
+    f->dump_stream("cid") << p.first;
+    dump_states(p.second);
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
+void BlueStore::dump_txc_trace(Formatter *f)
+{
+  if (!txc_trace) {
+    f->dump_string("error", "bluestore_txc_trace_size is 0");
+    return;
+  }
+  txc_trace->dump(f);
+}
+
+void BlueStore::dump_txc_histograms(Formatter *f)
+{
+  if (!txc_trace) {
+    f->dump_string("error", "bluestore_txc_trace_size is 0");
+    return;
+  }
+  txc_trace->dump_histograms(f);
+}
+
+// SocketHook
+
+/*
+ * The commands are registered once per CephContext and dump every store
+ * that is alive in it, so that they keep working when several stores
+ * share a process (e.g., tests) and one of them goes away.
+ */
+class BlueStore::SocketHook : public AdminSocketHook {
+  std::mutex lock;  ///< protects stores
+  std::set<BlueStore*> stores;
+public:
+  void add(BlueStore *store) {
+    std::lock_guard<std::mutex> l(lock);
+    stores.insert(store);
+  }
+  /// return true if that was the last store
+  bool remove(BlueStore *store) {
+    std::lock_guard<std::mutex> l(lock);
+    stores.erase(store);
+    return stores.empty();
+  }
+
+  bool call(std::string_view command, const cmdmap_t& cmdmap,
+	    std::string_view format, bufferlist& out) override {
+    Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
+    f->open_array_section("stores");
+    {
+      std::lock_guard<std::mutex> l(lock);
+      for (auto store : stores) {
+	f->open_object_section("store");
+	f->dump_string("path", store->path);
+	if (command == "dump_bluestore_txc_trace") {
+	  store->dump_txc_trace(f);
+	} else if (command == "dump_bluestore_txc_histograms") {
+	  store->dump_txc_histograms(f);
+	}
+	f->close_section();
+      }
+    }
+    f->close_section();
+    f->flush(out);
+    delete f;
+    return true;
+  }
+};
+
+static std::mutex asok_hooks_lock;
+static std::map<CephContext*, AdminSocketHook*> asok_hooks;
+
+void BlueStore::_init_asok()
+{
+  uint64_t n = cct->_conf.get_val<uint64_t>("bluestore_txc_trace_size");
+  if (n) {
+    txc_trace.reset(new TxcTrace(n));
+  }
+
+  std::lock_guard<std::mutex> l(asok_hooks_lock);
+  auto& hook = asok_hooks[cct];
+  if (!hook) {
+    hook = new SocketHook;
+    AdminSocket *admin_socket = cct->get_admin_socket();
+    int r = admin_socket->register_command(
+      "dump_bluestore_txc_trace",
+      "dump_bluestore_txc_trace",
+      hook,
+      "dump per-state latencies of recently finished bluestore transactions");
+    if (r == 0) {
+      r = admin_socket->register_command(
+	"dump_bluestore_txc_histograms",
+	"dump_bluestore_txc_histograms",
+	hook,
+	"dump per-state latency histograms of recent bluestore transactions, "
+	"overall and per collection");
+    }
+    if (r < 0) {
+      derr << __func__ << " error registering admin socket command: "
+	   << cpp_strerror(r) << dendl;
+    }
+  }
+  asok_hook = static_cast<SocketHook*>(hook);
+  asok_hook->add(this);
+}
+
+void BlueStore::_shutdown_asok()
+{
+  std::lock_guard<std::mutex> l(asok_hooks_lock);
+  if (asok_hook->remove(this)) {
+    cct->get_admin_socket()->unregister_commands(asok_hook);
+    delete asok_hook;
+    asok_hooks.erase(cct);
+  }
+  asok_hook = nullptr;
+}
+
 int BlueStore::get_block_device_fsid(CephContext* cct, const string& path,
 				     uuid_d *fsid)
 {
@@ -4514,6 +5067,10 @@ void BlueStore::_set_alloc_sizes(void)
       deferred_batch_ops = cct->_conf->bluestore_deferred_batch_ops_ssd;
     }
   }
+  deferred_batch_adaptive =
+    cct->_conf.get_val<bool>("bluestore_deferred_batch_adaptive");
+  deferred_batch_max_wait =
+    cct->_conf.get_val<double>("bluestore_deferred_batch_max_wait");
 
   dout(10) << __func__ << " min_alloc_size 0x" << std::hex << min_alloc_size
 	   << std::dec << " order " << (int)min_alloc_size_order
@@ -4521,6 +5078,7 @@ void BlueStore::_set_alloc_sizes(void)
 	   << " prefer_deferred_size 0x" << prefer_deferred_size
 	   << std::dec
 	   << " deferred_batch_ops " << deferred_batch_ops
+	   << (deferred_batch_adaptive ? " (adaptive)" : "")
 	   << dendl;
 }
 
@@ -4706,6 +5264,34 @@ int BlueStore::_open_alloc()
   uint64_t num = 0, bytes = 0;
 
   dout(1) << __func__ << " opening allocation metadata" << dendl;
+  if (cct->_conf.get_val<bool>("bluestore_alloc_snapshot")) {
+    utime_t start = ceph_clock_now();
+    int r = _load_alloc_snapshot(
+      [&](uint64_t offset, uint64_t length) {
+	alloc->init_add_free(offset, length);
+      },
+      &num, &bytes);
+    if (r == 0) {
+      // the snapshot was taken with bluefs_extents already allocated
+      dout(1) << __func__ << " loaded " << byte_u_t(bytes)
+	      << " in " << num << " extents from allocator snapshot in "
+	      << (ceph_clock_now() - start) << dendl;
+      return 0;
+    }
+    if (r != -ENOENT) {
+      dout(1) << __func__ << " ignoring allocator snapshot: "
+	      << cpp_strerror(r) << dendl;
+      // drop anything a partially applied snapshot left behind
+      alloc->shutdown();
+      delete alloc;
+      alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
+				bdev->get_size(),
+				min_alloc_size);
+      ceph_assert(alloc);
+    }
+    num = bytes = 0;
+  }
+
   // initialize from freelist
   fm->enumerate_reset();
   uint64_t offset, length;
@@ -4740,6 +5326,194 @@ void BlueStore::_close_alloc()
   alloc = NULL;
 }
 
+/*
+ * Allocator snapshot
+ *
+ * Walking the freelist at mount time is proportional to the number of
+ * freelist keys, which gets slow on large devices.  On a clean umount
+ * we instead dump the allocator's free extents, in chunks of
+ * interval_set, under PREFIX_ALLOC_SNAPSHOT, and record a descriptor in
+ * PREFIX_SUPER.  The descriptor is removed (synchronously) as soon as
+ * the store is mounted again, so a snapshot only ever exists while
+ * nothing can have changed the freelist since it was written.
+ *
+ * Versions that predate the snapshot would neither load nor remove
+ * it, so the descriptor is written together with a
+ * min_compat_ondisk_format of alloc_snapshot_compat_ondisk_format and
+ * the regular value is restored when it is removed.  To downgrade, the
+ * store must first be mounted once with bluestore_alloc_snapshot
+ * disabled.
+ */
+int BlueStore::_load_alloc_snapshot(
+  std::function<void(uint64_t offset, uint64_t length)> notify,
+  uint64_t *num, uint64_t *bytes)
+{
+  bufferlist bl;
+  int r = db->get(PREFIX_SUPER, "alloc_snapshot", &bl);
+  if (r < 0) {
+    dout(10) << __func__ << " no allocator snapshot" << dendl;
+    return -ENOENT;
+  }
+  bluestore_alloc_snapshot_t snap;
+  try {
+    auto p = bl.cbegin();
+    decode(snap, p);
+  } catch (buffer::error& e) {
+    derr << __func__ << " unable to decode snapshot descriptor" << dendl;
+    return -EIO;
+  }
+  {
+    // without the compat gate an older version may have mounted the
+    // store and changed the freelist behind the snapshot's back
+    int32_t compat = 0;
+    bufferlist cbl;
+    if (db->get(PREFIX_SUPER, "min_compat_ondisk_format", &cbl) == 0) {
+      try {
+	auto p = cbl.cbegin();
+	decode(compat, p);
+      } catch (buffer::error& e) {
+      }
+    }
+    if (compat != alloc_snapshot_compat_ondisk_format) {
+      dout(1) << __func__ << " min_compat_ondisk_format " << compat
+	      << " is not " << alloc_snapshot_compat_ondisk_format << dendl;
+      return -ESTALE;
+    }
+  }
+  if (snap.bdev_size != bdev->get_size() ||
+      snap.min_alloc_size != min_alloc_size ||
+      !(snap.bluefs_extents == bluefs_extents)) {
+    dout(1) << __func__ << " snapshot (size 0x" << std::hex << snap.bdev_size
+	    << " min_alloc_size 0x" << snap.min_alloc_size
+	    << " bluefs_extents " << snap.bluefs_extents
+	    << ") does not match the store (size 0x" << bdev->get_size()
+	    << " min_alloc_size 0x" << min_alloc_size
+	    << " bluefs_extents " << bluefs_extents << std::dec << ")" << dendl;
+    return -ESTALE;
+  }
+
+  uint64_t chunks = 0;
+  *num = 0;
+  *bytes = 0;
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_ALLOC_SNAPSHOT);
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    string key = it->key();
+    uint64_t idx = 0;
+    if (key.size() == sizeof(uint64_t)) {
+      _key_decode_u64(key.c_str(), &idx);
+    }
+    if (key.size() != sizeof(uint64_t) || idx != chunks) {
+      derr << __func__ << " unexpected chunk key "
+	   << pretty_binary_string(key) << ", expected chunk " << chunks
+	   << dendl;
+      return -EIO;
+    }
+    interval_set<uint64_t> chunk;
+    try {
+      bufferlist v = it->value();
+      auto p = v.cbegin();
+      decode(chunk, p);
+    } catch (buffer::error& e) {
+      derr << __func__ << " unable to decode chunk " << chunks << dendl;
+      return -EIO;
+    }
+    for (auto q = chunk.begin(); q != chunk.end(); ++q) {
+      notify(q.get_start(), q.get_len());
+    }
+    *num += chunk.num_intervals();
+    *bytes += chunk.size();
+    ++chunks;
+  }
+  if (chunks != snap.num_chunks ||
+      *num != snap.num_extents ||
+      *bytes != snap.free_bytes) {
+    derr << __func__ << " found " << chunks << " chunks, " << *num
+	 << " extents, " << *bytes << " bytes; descriptor says "
+	 << snap.num_chunks << " chunks, " << snap.num_extents
+	 << " extents, " << snap.free_bytes << " bytes" << dendl;
+    return -EIO;
+  }
+  return 0;
+}
+
+int BlueStore::_write_alloc_snapshot()
+{
+  ceph_assert(alloc);
+  const int extents_per_chunk = 4096;
+  utime_t start = ceph_clock_now();
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys_by_prefix(PREFIX_ALLOC_SNAPSHOT);
+
+  bluestore_alloc_snapshot_t snap;
+  snap.bdev_size = bdev->get_size();
+  snap.min_alloc_size = min_alloc_size;
+  snap.bluefs_extents = bluefs_extents;
+
+  interval_set<uint64_t> chunk;
+  auto flush_chunk = [&]() {
+    bufferlist bl;
+    encode(chunk, bl);
+    string key;
+    _key_encode_u64(snap.num_chunks, &key);
+    t->set(PREFIX_ALLOC_SNAPSHOT, key, bl);
+    ++snap.num_chunks;
+    snap.num_extents += chunk.num_intervals();
+    snap.free_bytes += chunk.size();
+    chunk.clear();
+  };
+  alloc->foreach([&](uint64_t offset, uint64_t length) {
+      chunk.insert(offset, length);
+      if (chunk.num_intervals() >= extents_per_chunk) {
+	flush_chunk();
+      }
+    });
+  if (!chunk.empty()) {
+    flush_chunk();
+  }
+
+  bufferlist bl;
+  encode(snap, bl);
+  t->set(PREFIX_SUPER, "alloc_snapshot", bl);
+  {
+    bufferlist cbl;
+    encode(alloc_snapshot_compat_ondisk_format, cbl);
+    t->set(PREFIX_SUPER, "min_compat_ondisk_format", cbl);
+  }
+  int r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  dout(1) << __func__ << " wrote " << byte_u_t(snap.free_bytes)
+	  << " in " << snap.num_extents << " extents ("
+	  << snap.num_chunks << " chunks) in "
+	  << (ceph_clock_now() - start) << dendl;
+  return 0;
+}
+
+int BlueStore::_invalidate_alloc_snapshot()
+{
+  bufferlist bl;
+  if (db->get(PREFIX_SUPER, "alloc_snapshot", &bl) < 0) {
+    return 0;
+  }
+  dout(10) << __func__ << dendl;
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkey(PREFIX_SUPER, "alloc_snapshot");
+  t->rmkeys_by_prefix(PREFIX_ALLOC_SNAPSHOT);
+  {
+    bufferlist cbl;
+    encode(min_compat_ondisk_format, cbl);
+    t->set(PREFIX_SUPER, "min_compat_ondisk_format", cbl);
+  }
+  int r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed: " << cpp_strerror(r) << dendl;
+  }
+  return r;
+}
+
 int BlueStore::_open_fsid(bool create)
 {
   ceph_assert(fsid_fd < 0);
@@ -5782,6 +6556,13 @@ int BlueStore::_mount(bool kv_only, bool open_db)
       derr << __func__ << " expected bluestore, but type is " << type << dendl;
       return -EIO;
     }
+
+    string migrating;
+    if (read_meta("cf_migration", &migrating) == 0 && migrating == "1") {
+      derr << __func__ << " column family migration did not complete, rerun "
+	   << "ceph-bluestore-tool migrate-cf" << dendl;
+      return -EIO;
+    }
   }
 
   if (cct->_conf->bluestore_fsck_on_mount) {
@@ -5832,11 +6613,16 @@ int BlueStore::_mount(bool kv_only, bool open_db)
   if (r < 0)
     goto out_fm;
 
-  r = _open_collections();
+  // from here on the freelist may change underneath any snapshot
+  r = _invalidate_alloc_snapshot();
   if (r < 0)
     goto out_alloc;
 
-  r = _reload_logger();
+  r = _open_collections();
+  if (r < 0)
+    goto out_alloc;
+
+  r = _reload_logger();
   if (r < 0)
     goto out_coll;
 
@@ -5854,6 +6640,12 @@ int BlueStore::_mount(bool kv_only, bool open_db)
 
   mempool_thread.init();
 
+  r = _tier_start();
+  if (r < 0) {
+    mempool_thread.shutdown();
+    goto out_stop;
+  }
+
   mounted = true;
   return 0;
 
@@ -5881,6 +6673,9 @@ int BlueStore::umount()
   ceph_assert(_kv_only || mounted);
   dout(1) << __func__ << dendl;
 
+  if (!_kv_only) {
+    _tier_stop();
+  }
   _osr_drain_all();
 
   mounted = false;
@@ -5891,6 +6686,11 @@ int BlueStore::umount()
     _flush_cache();
     dout(20) << __func__ << " closing" << dendl;
 
+    if (cct->_conf.get_val<bool>("bluestore_alloc_snapshot")) {
+      // queued discards still hold extents that are released on completion
+      bdev->discard_drain();
+      _write_alloc_snapshot();
+    }
     _close_alloc();
     _close_fm();
   }
@@ -5911,6 +6711,174 @@ int BlueStore::umount()
   return 0;
 }
 
+int BlueStore::migrate_column_families(ostream& out)
+{
+  dout(1) << __func__ << dendl;
+  if (!cct->_conf.get_val<bool>("bluestore_rocksdb_cf")) {
+    // without it the store opens the default key space only and would not
+    // find the migrated keys
+    derr << __func__ << " bluestore_rocksdb_cf is false; refusing to migrate"
+	 << dendl;
+    out << "bluestore_rocksdb_cf must be enabled to migrate column families"
+	<< std::endl;
+    return -EINVAL;
+  }
+  int r = _open_path();
+  if (r < 0)
+    return r;
+  r = _open_fsid(false);
+  if (r < 0)
+    goto out_path;
+  r = _read_fsid(&fsid);
+  if (r < 0)
+    goto out_fsid;
+  r = _lock_fsid();
+  if (r < 0)
+    goto out_fsid;
+  r = _open_bdev(false);
+  if (r < 0)
+    goto out_fsid;
+  r = _open_db(false);
+  if (r < 0)
+    goto out_bdev;
+
+  {
+    map<string,string> cf_map;
+    cct->_conf.with_val<string>("bluestore_rocksdb_cfs",
+				get_str_map,
+				&cf_map,
+				" \t");
+    // until every prefix has been moved the store must not be mounted: a
+    // prefix with a CF is only looked up there
+    r = write_meta("cf_migration", "1");
+    if (r < 0)
+      goto out_db;
+    for (auto& i : cf_map) {
+      r = db->migrate_to_column_family(
+	KeyValueDB::ColumnFamily(i.first, i.second), out);
+      if (r < 0) {
+	derr << __func__ << " failed to migrate prefix " << i.first << ": "
+	     << cpp_strerror(r) << dendl;
+	goto out_db;
+      }
+    }
+    r = write_meta("cf_migration", "0");
+  }
+
+ out_db:
+  _close_db();
+ out_bdev:
+  _close_bdev();
+ out_fsid:
+  _close_fsid();
+ out_path:
+  _close_path();
+  return r;
+}
+
+int BlueStore::_check_alloc_snapshot(bool rebuild, ostream& out)
+{
+  dout(1) << __func__ << (rebuild ? " rebuild" : " check") << dendl;
+  int r = _open_path();
+  if (r < 0)
+    return r;
+  r = _open_fsid(false);
+  if (r < 0)
+    goto out_path;
+  r = _read_fsid(&fsid);
+  if (r < 0)
+    goto out_fsid;
+  r = _lock_fsid();
+  if (r < 0)
+    goto out_fsid;
+  r = _open_bdev(false);
+  if (r < 0)
+    goto out_fsid;
+  r = _open_db(false);
+  if (r < 0)
+    goto out_bdev;
+  r = _open_super_meta();
+  if (r < 0)
+    goto out_db;
+  r = _open_fm(false);
+  if (r < 0)
+    goto out_db;
+
+  {
+    // deferred writes still to be replayed may release space
+    KeyValueDB::Iterator it = db->get_iterator(PREFIX_DEFERRED);
+    it->lower_bound(string());
+    if (it->valid()) {
+      derr << __func__ << " store has deferred writes pending replay;"
+	   << " mount it once first" << dendl;
+      r = -EBUSY;
+      goto out_fm;
+    }
+  }
+
+  if (rebuild) {
+    r = _invalidate_alloc_snapshot();
+    if (r < 0)
+      goto out_fm;
+    r = _open_alloc();  // from the freelist, now that there is no snapshot
+    if (r < 0)
+      goto out_fm;
+    r = _write_alloc_snapshot();
+    if (r == 0) {
+      out << "allocator snapshot written: " << byte_u_t(alloc->get_free())
+	  << " free" << std::endl;
+    }
+    _close_alloc();
+  } else {
+    interval_set<uint64_t> expected, found;
+    uint64_t offset, length;
+    fm->enumerate_reset();
+    while (fm->enumerate_next(&offset, &length)) {
+      expected.insert(offset, length);
+    }
+    fm->enumerate_reset();
+    expected.subtract(bluefs_extents);
+
+    uint64_t num = 0, bytes = 0;
+    r = _load_alloc_snapshot(
+      [&](uint64_t offset, uint64_t length) {
+	found.union_insert(offset, length);
+      },
+      &num, &bytes);
+    if (r == -ENOENT) {
+      out << "no allocator snapshot" << std::endl;
+    } else if (r == -ESTALE) {
+      out << "allocator snapshot is stale" << std::endl;
+    } else if (r < 0) {
+      out << "allocator snapshot is corrupt" << std::endl;
+    } else if (!(expected == found)) {
+      interval_set<uint64_t> common;
+      common.intersection_of(expected, found);
+      out << "allocator snapshot differs from freelist: "
+	  << byte_u_t(expected.size() - common.size())
+	  << " free only in freelist, "
+	  << byte_u_t(found.size() - common.size())
+	  << " free only in snapshot" << std::endl;
+      r = -EIO;
+    } else {
+      out << "allocator snapshot matches freelist: " << byte_u_t(bytes)
+	  << " free in " << num << " extents" << std::endl;
+    }
+  }
+
+ out_fm:
+  _close_fm();
+ out_db:
+  _close_db();
+ out_bdev:
+  _close_bdev();
+ out_fsid:
+  _close_fsid();
+ out_path:
+  _close_path();
+  return r;
+}
+
 static void apply(uint64_t off,
                   uint64_t len,
                   uint64_t granularity,
@@ -6090,6 +7058,12 @@ int BlueStore::_fsck(bool deep, bool repair)
   if (r < 0)
     goto out_fm;
 
+  if (repair) {
+    r = _invalidate_alloc_snapshot();
+    if (r < 0)
+      goto out_alloc;
+  }
+
   r = _open_collections(&errors);
   if (r < 0)
     goto out_alloc;
@@ -6170,8 +7144,69 @@ int BlueStore::_fsck(bool deep, bool repair)
     CollectionRef c;
     spg_t pgid;
     mempool::bluestore_fsck::list<string> expecting_shards;
+
+    // deep reads dominate fsck time; hand them to worker threads through
+    // a bounded queue so that memory use does not grow with object count
+    std::mutex deep_lock;
+    std::condition_variable deep_cond;
+    std::deque<std::pair<CollectionRef,OnodeRef>> deep_queue;
+    bool deep_stop = false;
+    std::atomic<int> deep_errors = {0};
+    vector<std::thread> deep_threads;
+    size_t deep_queue_max = 0;
+    auto deep_read = [&](Collection *c, OnodeRef& o) {
+      bufferlist bl;
+      int r = _do_read(c, o, 0, o->onode.size, bl, 0);
+      if (r < 0) {
+	++deep_errors;
+	derr << "fsck error: " << o->oid << " error during read: "
+	     << cpp_strerror(r) << dendl;
+      }
+    };
+    auto deep_join = [&]() {
+      {
+	std::lock_guard<std::mutex> l(deep_lock);
+	deep_stop = true;
+	deep_cond.notify_all();
+      }
+      for (auto& t : deep_threads) {
+	t.join();
+      }
+      deep_threads.clear();
+    };
+    if (deep) {
+      unsigned n = cct->_conf.get_val<uint64_t>("bluestore_fsck_threads");
+      dout(1) << __func__ << " using " << n << " threads for deep reads"
+	      << dendl;
+      deep_queue_max = n * 8;
+      for (unsigned i = 0; n > 1 && i < n; ++i) {
+	deep_threads.emplace_back([&]() {
+	  std::unique_lock<std::mutex> l(deep_lock);
+	  while (true) {
+	    if (deep_queue.empty()) {
+	      if (deep_stop) {
+		break;
+	      }
+	      deep_cond.wait(l);
+	      continue;
+	    }
+	    auto job = std::move(deep_queue.front());
+	    deep_queue.pop_front();
+	    deep_cond.notify_all();
+	    l.unlock();
+	    {
+	      RWLock::RLocker cl(job.first->lock);
+	      deep_read(job.first.get(), job.second);
+	    }
+	    l.lock();
+	  }
+	});
+      }
+    }
+
     for (it->lower_bound(string()); it->valid(); it->next()) {
       if (g_conf()->bluestore_debug_fsck_abort) {
+	deep_join();
 	goto out_scan;
       }
       dout(30) << __func__ << " key "
@@ -6274,6 +7309,10 @@ int BlueStore::_fsck(bool deep, bool repair)
 	used_nids.insert(o->onode.nid);
       }
       ++num_objects;
+      if (num_objects % 100000 == 0) {
+	dout(1) << __func__ << " walked " << num_objects << " objects in "
+		<< (ceph_clock_now() - start) << " seconds" << dendl;
+      }
       num_spanning_blobs += o->extent_map.spanning_blob_map.size();
       o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
       _dump_onode(o);
@@ -6437,12 +7476,15 @@ int BlueStore::_fsck(bool deep, bool repair)
         }
       }
       if (deep) {
-	bufferlist bl;
-	int r = _do_read(c.get(), o, 0, o->onode.size, bl, 0);
-	if (r < 0) {
-	  ++errors;
-	  derr << "fsck error: " << oid << " error during read: "
-	       << cpp_strerror(r) << dendl;
+	if (deep_threads.empty()) {
+	  deep_read(c.get(), o);
+	} else {
+	  std::unique_lock<std::mutex> dl(deep_lock);
+	  deep_cond.wait(dl, [&]() {
+	      return deep_queue.size() < deep_queue_max;
+	    });
+	  deep_queue.emplace_back(c, o);
+	  deep_cond.notify_all();
 	}
       }
       // omap
@@ -6458,6 +7500,8 @@ int BlueStore::_fsck(bool deep, bool repair)
 	}
       }
     }
+    deep_join();
+    errors += deep_errors;
   }
 
   dout(1) << __func__ << " checking shared_blobs" << dendl;
@@ -7080,6 +8124,41 @@ int BlueStore::get_devices(set<string> *ls)
   return 0;
 }
 
+int BlueStore::get_numa_node(
+  int *final_node,
+  set<int> *out_nodes,
+  set<string> *out_failed)
+{
+  set<int> nodes;
+  set<string> failed;
+  int n;
+  if (bdev->get_numa_node(&n) == 0) {
+    nodes.insert(n);
+  } else {
+    bdev->get_devices(&failed);
+  }
+  if (bluefs) {
+    bluefs->get_numa_nodes(&nodes, &failed);
+  }
+  int r = 0;
+  if (!failed.empty()) {
+    r = -ENOENT;
+  } else if (nodes.size() != 1) {
+    r = nodes.empty() ? -ENOENT : -EXDEV;
+  } else if (final_node) {
+    *final_node = *nodes.begin();
+  }
+  dout(10) << __func__ << " nodes " << nodes << " failed " << failed
+	   << " = " << r << dendl;
+  if (out_nodes) {
+    *out_nodes = nodes;
+  }
+  if (out_failed) {
+    *out_failed = failed;
+  }
+  return r;
+}
+
 int BlueStore::statfs(struct store_statfs_t *buf)
 {
   buf->reset();
@@ -7214,6 +8293,26 @@ void BlueStore::_update_cache_logger()
   logger->set(l_bluestore_blobs, num_blobs);
   logger->set(l_bluestore_buffers, num_buffers);
   logger->set(l_bluestore_buffer_bytes, num_buffer_bytes);
+
+  // hit ratios over the last interval
+  uint64_t onode_hits = logger->get(l_bluestore_onode_hits);
+  uint64_t onode_misses = logger->get(l_bluestore_onode_misses);
+  uint64_t buffer_hit_bytes = logger->get(l_bluestore_buffer_hit_bytes);
+  uint64_t buffer_miss_bytes = logger->get(l_bluestore_buffer_miss_bytes);
+  uint64_t dh = onode_hits - last_onode_hits;
+  uint64_t dm = onode_misses - last_onode_misses;
+  if (dh + dm) {
+    logger->set(l_bluestore_onode_hit_permille, dh * 1000 / (dh + dm));
+  }
+  dh = buffer_hit_bytes - last_buffer_hit_bytes;
+  dm = buffer_miss_bytes - last_buffer_miss_bytes;
+  if (dh + dm) {
+    logger->set(l_bluestore_buffer_hit_permille, dh * 1000 / (dh + dm));
+  }
+  last_onode_hits = onode_hits;
+  last_onode_misses = onode_misses;
+  last_buffer_hit_bytes = buffer_hit_bytes;
+  last_buffer_miss_bytes = buffer_miss_bytes;
 }
 
 // ---------------
@@ -7345,6 +8444,10 @@ int BlueStore::read(
     if (offset == length && offset == 0)
       length = o->onode.size;
 
+    if (tier_enabled && _tier_read(c, o, offset, length, bl)) {
+      r = bl.length();
+      goto out;
+    }
     r = _do_read(c, o, offset, length, bl, op_flags);
     if (r == -EIO) {
       logger->inc(l_bluestore_read_eio);
@@ -7433,6 +8536,12 @@ int BlueStore::_do_read(
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
   }
+  // decompression is expensive and covers the whole blob anyway, so keep
+  // the result around unless the client asked us not to
+  bool cache_decompressed = buffered ||
+    (cct->_conf->bluestore_cache_decompressed &&
+     (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+		  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0);
 
   if (offset + length > o->onode.size) {
     length = o->onode.size - offset;
@@ -7457,8 +8566,10 @@ int BlueStore::_do_read(
   unsigned left = length;
   uint64_t pos = offset;
   unsigned num_regions = 0;
+  unsigned num_lextents = 0;
   auto lp = o->extent_map.seek_lextent(offset);
   while (left > 0 && lp != o->extent_map.extent_map.end()) {
+    ++num_lextents;
     if (pos < lp->logical_offset) {
       unsigned hole = lp->logical_offset - pos;
       if (hole >= left) {
@@ -7483,6 +8594,14 @@ int BlueStore::_do_read(
 	     << " need 0x" << b_off << "~" << b_len
 	     << " cache has 0x" << cache_interval
 	     << std::dec << dendl;
+    if (bptr->get_blob().is_compressed() && cache_interval.size()) {
+      logger->inc(l_bluestore_decompress_cache_hit_bytes,
+		  cache_interval.size());
+      logger->tinc(l_bluestore_decompress_saved_time,
+		   ceph::timespan(std::chrono::nanoseconds(
+		     decompress_ns_per_kb.load() * cache_interval.size() /
+		     1024)));
+    }
 
     auto pc = cache_res.begin();
     while (b_len > 0) {
@@ -7513,6 +8632,14 @@ int BlueStore::_do_read(
     ++lp;
   }
 
+  uint64_t defrag_threshold = cct->_conf->bluestore_defrag_extent_threshold;
+  if (defrag_threshold && num_lextents >= defrag_threshold &&
+      !o->defrag_wanted.exchange(true)) {
+    dout(20) << __func__ << " " << o->oid << " read touched " << num_lextents
+	     << " lextents, marking for defrag" << dendl;
+    logger->inc(l_bluestore_defrag_candidates);
+  }
+
   // read raw blob data.  use aio if we have >1 blobs to read.
   start = mono_clock::now(); // for the sake of simplicity
                              // measure the whole block below.
@@ -7615,7 +8742,10 @@ int BlueStore::_do_read(
   }
   logger->tinc(l_bluestore_read_wait_aio_lat, mono_clock::now() - start);
 
-  // enumerate and decompress desired blobs
+  // enumerate and decompress desired blobs.  everything except holes and
+  // decompressed data is handed out as slices of the aligned device (or
+  // cache) buffers, all the way up to the messenger.
+  uint64_t copied = 0;
   auto p = compressed_blob_bls.begin();
   blobs2read_t::iterator b2r_it = blobs2read.begin();
   while (b2r_it != blobs2read.end()) {
@@ -7640,13 +8770,14 @@ int BlueStore::_do_read(
       r = _decompress(compressed_bl, &raw_bl);
       if (r < 0)
 	return r;
-      if (buffered) {
+      if (cache_decompressed) {
 	bptr->shared_blob->bc.did_read(bptr->shared_blob->get_cache(), 0,
 				       raw_bl);
       }
       for (auto& i : b2r_it->second) {
 	ready_regions[i.logical_offset].substr_of(
 	  raw_bl, i.blob_xoffset, i.length);
+	copied += i.length;
       }
     } else {
       for (auto& reg : b2r_it->second) {
@@ -7696,6 +8827,7 @@ int BlueStore::_do_read(
 	       << ": zeros for 0x" << (pos + offset) << "~" << l
 	       << std::dec << dendl;
       bl.append_zero(l);
+      copied += l;
       pos += l;
     }
   }
@@ -7703,6 +8835,8 @@ int BlueStore::_do_read(
   ceph_assert(pos == length);
   ceph_assert(pr == pr_end);
   r = bl.length();
+  logger->inc(l_bluestore_read_sliced_bytes, length - copied);
+  logger->inc(l_bluestore_read_copied_bytes, copied);
   if (retry_count) {
     logger->inc(l_bluestore_reads_with_retries);
     dout(5) << __func__ << " read at 0x" << std::hex << offset << "~" << length
@@ -7782,7 +8916,14 @@ int BlueStore::_decompress(bufferlist& source, bufferlist* result)
       r = -EIO;
     }
   }
-  logger->tinc(l_bluestore_decompress_lat, mono_clock::now() - start);
+  auto lat = mono_clock::now() - start;
+  logger->tinc(l_bluestore_decompress_lat, lat);
+  if (r >= 0 && result->length()) {
+    uint64_t per_kb = std::chrono::nanoseconds(lat).count() * 1024 /
+      result->length();
+    uint64_t avg = decompress_ns_per_kb.load();
+    decompress_ns_per_kb = avg ? (avg * 7 + per_kb) / 8 : per_kb;
+  }
   return r;
 }
 
@@ -8299,14 +9440,22 @@ int BlueStore::omap_get_values(
     o->flush();
     _key_encode_u64(o->onode.nid, &final_key);
     final_key.push_back('.');
-    for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p) {
+    vector<string> db_keys;
+    db_keys.reserve(keys.size());
+    for (auto& k : keys) {
       final_key.resize(9); // keep prefix
-      final_key += *p;
-      bufferlist val;
-      if (db->get(prefix, final_key, &val) >= 0) {
-	dout(30) << __func__ << "  got " << pretty_binary_string(final_key)
+      final_key += k;
+      db_keys.push_back(final_key);
+    }
+    vector<bufferlist> vals;
+    vector<bool> found;
+    db->get_batch(prefix, db_keys, &vals, &found);
+    auto p = keys.begin();
+    for (size_t i = 0; i < db_keys.size(); ++i, ++p) {
+      if (found[i]) {
+	dout(30) << __func__ << "  got " << pretty_binary_string(db_keys[i])
 		 << " -> " << *p << dendl;
-	out->insert(make_pair(*p, val));
+	out->emplace_hint(out->end(), *p, std::move(vals[i]));
       }
     }
   }
@@ -8343,16 +9492,24 @@ int BlueStore::omap_check_keys(
     o->flush();
     _key_encode_u64(o->onode.nid, &final_key);
     final_key.push_back('.');
-    for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p) {
+    vector<string> db_keys;
+    db_keys.reserve(keys.size());
+    for (auto& k : keys) {
       final_key.resize(9); // keep prefix
-      final_key += *p;
-      bufferlist val;
-      if (db->get(prefix, final_key, &val) >= 0) {
-	dout(30) << __func__ << "  have " << pretty_binary_string(final_key)
+      final_key += k;
+      db_keys.push_back(final_key);
+    }
+    vector<bufferlist> vals;
+    vector<bool> found;
+    db->get_batch(prefix, db_keys, &vals, &found);
+    auto p = keys.begin();
+    for (size_t i = 0; i < db_keys.size(); ++i, ++p) {
+      if (found[i]) {
+	dout(30) << __func__ << "  have " << pretty_binary_string(db_keys[i])
 		 << " -> " << *p << dendl;
-	out->insert(*p);
+	out->insert(out->end(), *p);
       } else {
-	dout(30) << __func__ << "  miss " << pretty_binary_string(final_key)
+	dout(30) << __func__ << "  miss " << pretty_binary_string(db_keys[i])
 		 << " -> " << *p << dendl;
       }
     }
@@ -8363,6 +9520,19 @@ int BlueStore::omap_check_keys(
   return r;
 }
 
+void BlueStore::prefetch_objects(
+  CollectionHandle &c_,
+  const vector<ghobject_t>& oids)
+{
+  Collection *c = static_cast<Collection *>(c_.get());
+  dout(15) << __func__ << " " << c->get_cid() << " " << oids.size()
+	   << " objects" << dendl;
+  if (!c->exists)
+    return;
+  RWLock::RLocker l(c->lock);
+  c->prefetch_onodes(oids);
+}
+
 ObjectMap::ObjectMapIterator BlueStore::get_omap_iterator(
   CollectionHandle &c_,              ///< [in] collection
   const ghobject_t &oid  ///< [in] object
@@ -8589,6 +9759,17 @@ int BlueStore::_upgrade_super()
       t->rmkey(PREFIX_SUPER, "min_min_alloc_size");
     }
     ondisk_format = 2;
+    int r = db->submit_transaction_sync(t);
+    ceph_assert(r == 0);
+  }
+  if (ondisk_format == 2) {
+    // changes:
+    // - super: min_compat_ondisk_format is raised to
+    //   alloc_snapshot_compat_ondisk_format while an allocator snapshot
+    //   exists, so older versions refuse to mount (and change the
+    //   freelist under) a store carrying one
+    KeyValueDB::Transaction t = db->get_transaction();
+    ondisk_format = 3;
     _prepare_ondisk_format_super(t);
     int r = db->submit_transaction_sync(t);
     ceph_assert(r == 0);
@@ -8958,6 +10139,12 @@ void BlueStore::_txc_finish(TransContext *txc)
     _queue_reap_collection(txc->removed_collections.front());
     txc->removed_collections.pop_front();
   }
+  for (auto& r : txc->compact_ranges) {
+    dout(10) << __func__ << " compacting " << std::get<0>(r) << " "
+	     << pretty_binary_string(std::get<1>(r)) << " to "
+	     << pretty_binary_string(std::get<2>(r)) << dendl;
+    db->compact_range_async(std::get<0>(r), std::get<1>(r), std::get<2>(r));
+  }
 
   OpSequencerRef osr = txc->osr;
   bool empty = false;
@@ -9004,6 +10191,9 @@ void BlueStore::_txc_finish(TransContext *txc)
     _txc_release_alloc(txc);
     releasing_txc.pop_front();
     txc->log_state_latency(logger, l_bluestore_state_done_lat);
+    if (txc_trace) {
+      txc_trace->record(txc);
+    }
     delete txc;
   }
 
@@ -9501,7 +10691,21 @@ void BlueStore::_kv_finalize_thread()
       if (kv_finalize_stop)
 	break;
       dout(20) << __func__ << " sleep" << dendl;
-      kv_finalize_cond.wait(l);
+      if (deferred_batch_adaptive && deferred_queue_size) {
+	// don't leave a partial batch queued just because commits stopped
+	kv_finalize_cond.wait_for(l, _deferred_wait_budget());
+	if (kv_committing_to_finalize.empty() &&
+	    deferred_stable_to_finalize.empty() &&
+	    !deferred_aggressive) {
+	  l.unlock();
+	  if (_deferred_batch_ready()) {
+	    deferred_try_submit();
+	  }
+	  l.lock();
+	}
+      } else {
+	kv_finalize_cond.wait(l);
+      }
       dout(20) << __func__ << " wake" << dendl;
     } else {
       kv_committed.swap(kv_committing_to_finalize);
@@ -9531,8 +10735,7 @@ void BlueStore::_kv_finalize_thread()
       deferred_stable.clear();
 
       if (!deferred_aggressive) {
-	if (deferred_queue_size >= deferred_batch_ops.load() ||
-	    throttle_deferred_bytes.past_midpoint()) {
+	if (_deferred_batch_ready()) {
 	  deferred_try_submit();
 	}
       }
@@ -9593,6 +10796,53 @@ void BlueStore::_deferred_queue(TransContext *txc)
   }
 }
 
+ceph::timespan BlueStore::_deferred_wait_budget()
+{
+  // hold a batch for about as long as the device takes to complete one,
+  // longer if it is already busy with others, but never past max_wait
+  auto budget = std::chrono::nanoseconds(
+    deferred_lat_avg.load() * (1 + deferred_inflight.load()));
+  auto max_wait = ceph::make_timespan(deferred_batch_max_wait.load());
+  if (budget == ceph::timespan::zero() || budget > max_wait) {
+    budget = max_wait;
+  }
+  return budget;
+}
+
+bool BlueStore::_deferred_batch_ready()
+{
+  if (throttle_deferred_bytes.past_midpoint()) {
+    return true;
+  }
+  int target = get_deferred_batch_target();
+  if (!deferred_batch_adaptive) {
+    return deferred_queue_size >= target;
+  }
+  if (!deferred_queue_size) {
+    return false;
+  }
+  if (deferred_queue_size >= target) {
+    dout(20) << __func__ << " " << deferred_queue_size << " txcs >= target "
+	     << target << dendl;
+    return true;
+  }
+  // ...but nothing waits longer than the budget
+  mono_time oldest = mono_clock::now();
+  {
+    std::lock_guard<std::mutex> l(deferred_lock);
+    for (auto& osr : deferred_queue) {
+      if (osr.deferred_pending && osr.deferred_pending->start < oldest) {
+	oldest = osr.deferred_pending->start;
+      }
+    }
+  }
+  auto age = mono_clock::now() - oldest;
+  auto budget = _deferred_wait_budget();
+  dout(20) << __func__ << " " << deferred_queue_size << " txcs, target "
+	   << target << ", oldest " << age << " budget " << budget << dendl;
+  return age >= budget;
+}
+
 void BlueStore::deferred_try_submit()
 {
   dout(20) << __func__ << " " << deferred_queue.size() << " osrs, "
@@ -9632,12 +10882,14 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 
   osr->deferred_running = osr->deferred_pending;
   osr->deferred_pending = nullptr;
+  ++deferred_inflight;
 
   deferred_lock.unlock();
 
   for (auto& txc : b->txcs) {
     txc.log_state_latency(logger, l_bluestore_state_deferred_queued_lat);
   }
+  uint64_t batch_bytes = 0;
   uint64_t start = 0, pos = 0;
   bufferlist bl;
   auto i = b->iomap.begin();
@@ -9647,6 +10899,7 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
 	dout(20) << __func__ << " write 0x" << std::hex
 		 << start << "~" << bl.length()
 		 << " crc " << bl.crc32c(-1) << std::dec << dendl;
+	batch_bytes += bl.length();
 	if (!g_conf()->bluestore_debug_omit_block_device_write) {
 	  logger->inc(l_bluestore_deferred_write_ops);
 	  logger->inc(l_bluestore_deferred_write_bytes, bl.length());
@@ -9672,6 +10925,13 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
     ++i;
   }
 
+  b->submitted = mono_clock::now();
+  logger->hinc(l_bluestore_deferred_batch_hist,
+	       b->seq_bytes.size(), batch_bytes);
+  logger->hinc(l_bluestore_deferred_wait_hist,
+	       std::chrono::duration_cast<std::chrono::microseconds>(
+		 b->submitted - b->start).count(),
+	       b->seq_bytes.size());
   bdev->aio_submit(&b->ioc);
 }
 
@@ -9693,6 +10953,11 @@ void BlueStore::_deferred_aio_finish(OpSequencer *osr)
     std::lock_guard<std::mutex> l(deferred_lock);
     ceph_assert(osr->deferred_running == b);
     osr->deferred_running = nullptr;
+    --deferred_inflight;
+    uint64_t lat = std::chrono::nanoseconds(
+      mono_clock::now() - b->submitted).count();
+    uint64_t avg = deferred_lat_avg.load();
+    deferred_lat_avg = avg ? (avg * 7 + lat) / 8 : lat;
     if (!osr->deferred_pending) {
       dout(20) << __func__ << " dequeueing" << dendl;
       auto q = deferred_queue.iterator_to(*osr);
@@ -9775,6 +11040,370 @@ int BlueStore::_deferred_replay()
   return r;
 }
 
+// ---------------------------
+// data tier
+
+/*
+ * Small objects that are read often get a copy of their data stored
+ * under PREFIX_TIER, i.e., in rocksdb on the block.db device, and the
+ * onode is flagged.  The copy is only ever a copy: block stays
+ * authoritative, any data mutation drops the key in the same kv
+ * transaction (_tier_invalidate), and demotion is just a key removal.
+ * Promotions and demotions run in the tier thread as their own txcs on
+ * the collection's sequencer.  Collection::tier_txc_lock is held from
+ * txc creation until its onodes are encoded, for client and tier txcs
+ * alike, so a tier txc is neither ordered ahead of a client txc whose
+ * ops have not been applied yet nor encodes an onode mid-update.  A
+ * promotion reads the data without it and only takes it to check that
+ * Onode::tier_gen has not moved before submitting.  Reads trust the
+ * flag only once the promotion has committed (Onode::tier_commit_gen),
+ * since until then the db may still hold a copy the last write dropped.
+ */
+
+int BlueStore::_tier_start()
+{
+  tier_enabled = cct->_conf.get_val<bool>("bluestore_tier") &&
+    bluefs && bluefs_shared_bdev == BlueFS::BDEV_SLOW;
+  if (!tier_enabled) {
+    // drop the copies left over from when the tier was on.  onodes that
+    // are still flagged read from block and can be promoted again, since
+    // their keys will not be tracked.
+    KeyValueDB::Iterator it = db->get_iterator(PREFIX_TIER);
+    it->lower_bound(string());
+    if (it->valid()) {
+      dout(1) << __func__ << " tier is off; removing data copies" << dendl;
+      KeyValueDB::Transaction t = db->get_transaction();
+      t->rmkeys_by_prefix(PREFIX_TIER);
+      int r = db->submit_transaction_sync(t);
+      if (r < 0) {
+	derr << __func__ << " failed to remove tier keys: "
+	     << cpp_strerror(r) << dendl;
+	return r;
+      }
+    }
+    return 0;
+  }
+
+  // rebuild tracking from the copies that survived the last run; they
+  // age out like everything else
+  auto now = mono_clock::now();
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_TIER);
+  for (it->lower_bound(string()); it->valid(); it->next()) {
+    string key = it->key();
+    TierEntry& e = tier_objects[key];
+    int r = get_key_object(key, &e.oid);
+    if (r < 0) {
+      derr << __func__ << " unable to decode tier key "
+	   << pretty_binary_string(key) << dendl;
+      tier_objects.clear();
+      tier_bytes = 0;
+      tier_enabled = false;
+      return -EIO;
+    }
+    e.bytes = it->value().length();
+    e.last_access = now;
+    tier_bytes += e.bytes;
+  }
+  logger->set(l_bluestore_tier_bytes, tier_bytes);
+  dout(1) << __func__ << " " << tier_objects.size() << " objects, "
+	  << byte_u_t(tier_bytes) << " on the db tier" << dendl;
+
+  tier_stop = false;
+  tier_thread.create("bstore_tier");
+  return 0;
+}
+
+void BlueStore::_tier_stop()
+{
+  if (!tier_enabled) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> l(tier_lock);
+    tier_stop = true;
+    tier_cond.notify_all();
+  }
+  tier_thread.join();
+  tier_promote_queue.clear();
+  tier_objects.clear();
+  tier_bytes = 0;
+  tier_enabled = false;
+}
+
+void BlueStore::_tier_thread()
+{
+  std::unique_lock<std::mutex> l(tier_lock);
+  auto next_scan = mono_clock::now();
+  while (!tier_stop) {
+    if (!tier_promote_queue.empty()) {
+      deque<pair<coll_t,ghobject_t>> q;
+      q.swap(tier_promote_queue);
+      l.unlock();
+      for (auto& p : q) {
+	_tier_promote(p.first, p.second);
+      }
+      l.lock();
+      continue;
+    }
+
+    auto now = mono_clock::now();
+    if (now >= next_scan) {
+      // demote whatever has gone cold, then the least recently read
+      // objects until we are within budget again
+      auto max_age = make_timespan(cct->_conf->bluestore_tier_demote_age);
+      uint64_t max_bytes = cct->_conf->bluestore_tier_max_bytes;
+      vector<const TierEntry*> by_age;
+      by_age.reserve(tier_objects.size());
+      for (auto& p : tier_objects) {
+	by_age.push_back(&p.second);
+      }
+      std::sort(by_age.begin(), by_age.end(),
+		[](const TierEntry *a, const TierEntry *b) {
+		  return a->last_access < b->last_access;
+		});
+      vector<ghobject_t> demote;
+      uint64_t bytes = tier_bytes;
+      for (auto e : by_age) {
+	if (now - e->last_access < max_age && bytes <= max_bytes) {
+	  break;
+	}
+	demote.push_back(e->oid);
+	bytes -= std::min(bytes, e->bytes);
+      }
+      l.unlock();
+      dout(20) << __func__ << " demoting " << demote.size() << " objects"
+	       << dendl;
+      for (auto& oid : demote) {
+	_tier_demote(oid);
+      }
+      l.lock();
+      next_scan = mono_clock::now() +
+	make_timespan(cct->_conf->bluestore_tier_interval);
+      continue;
+    }
+    tier_cond.wait_for(l, next_scan - now);
+  }
+}
+
+bool BlueStore::_tier_read(
+  Collection *c,
+  OnodeRef& o,
+  uint64_t offset,
+  size_t length,
+  bufferlist& bl)
+{
+  if (o->onode.has_flag(bluestore_onode_t::FLAG_TIER)) {
+    if (o->tier_commit_gen != o->tier_gen) {
+      // the promotion has not committed; the db may still hold a copy
+      // from before the last write
+      return false;
+    }
+    bufferlist v;
+    int r = db->get(PREFIX_TIER, o->key.c_str(), o->key.size(), &v);
+    if (r < 0 || v.length() != o->onode.size) {
+      // the copy was dropped while the tier was off; count the read so
+      // that it gets promoted again
+      goto count;
+    }
+    if (offset < v.length()) {
+      bl.substr_of(v, offset, std::min<uint64_t>(length, v.length() - offset));
+    }
+    logger->inc(l_bluestore_tier_hit);
+    std::lock_guard<std::mutex> l(tier_lock);
+    auto p = tier_objects.find(string(o->key.c_str(), o->key.size()));
+    if (p != tier_objects.end()) {
+      p->second.last_access = mono_clock::now();
+    }
+    return true;
+  }
+
+ count:
+  if (o->onode.size == 0 ||
+      o->onode.size > cct->_conf->bluestore_tier_max_object_size) {
+    return false;
+  }
+  if (++o->tier_reads == cct->_conf->bluestore_tier_promote_reads) {
+    std::lock_guard<std::mutex> l(tier_lock);
+    // don't let a scan-like workload queue up unbounded promotions
+    if (tier_promote_queue.size() < 1024) {
+      tier_promote_queue.emplace_back(c->cid, o->oid);
+      tier_cond.notify_one();
+    }
+  }
+  return false;
+}
+
+bool BlueStore::_tier_db_has_room(uint64_t bytes)
+{
+  {
+    std::lock_guard<std::mutex> l(tier_lock);
+    if (tier_bytes + bytes > cct->_conf->bluestore_tier_max_bytes) {
+      return false;
+    }
+  }
+  uint64_t total = bluefs->get_total(BlueFS::BDEV_DB);
+  uint64_t free = bluefs->get_free(BlueFS::BDEV_DB);
+  return free >= bytes &&
+    free - bytes >= total * cct->_conf->bluestore_tier_db_min_free_ratio;
+}
+
+void BlueStore::_tier_promote(const coll_t& cid, const ghobject_t& oid)
+{
+  CollectionRef c = _get_collection(cid);
+  if (!c) {
+    return;
+  }
+  auto is_tiered = [this](OnodeRef& o) {
+    if (!o->onode.has_flag(bluestore_onode_t::FLAG_TIER)) {
+      return false;
+    }
+    // a flagged onode whose copy is not tracked lost it while the tier
+    // was off
+    std::lock_guard<std::mutex> l(tier_lock);
+    return tier_objects.count(string(o->key.c_str(), o->key.size())) > 0;
+  };
+
+  // read the data under the shared lock only, so that client reads and
+  // writes on the collection are not stalled behind the slow device
+  OnodeRef o;
+  uint64_t size;
+  uint64_t gen;
+  bufferlist bl;
+  {
+    RWLock::RLocker l(c->lock);
+    o = c->get_onode(oid, false);
+    if (!o || !o->exists || is_tiered(o) ||
+	o->onode.size == 0 ||
+	o->onode.size > cct->_conf->bluestore_tier_max_object_size) {
+      return;
+    }
+    size = o->onode.size;
+    if (!_tier_db_has_room(size)) {
+      dout(20) << __func__ << " " << oid << " no room" << dendl;
+      o->tier_reads = 0;  // try again after another round of reads
+      return;
+    }
+    gen = o->tier_gen;
+    int r = _do_read(c.get(), o, 0, size, bl, 0);
+    if (r < 0 || bl.length() != size) {
+      dout(10) << __func__ << " " << oid << " read failed: "
+	       << cpp_strerror(r) << dendl;
+      return;
+    }
+  }
+
+  TransContext *txc = nullptr;
+  {
+    std::lock_guard<std::mutex> tl(c->tier_txc_lock);
+    RWLock::WLocker l(c->lock);
+    if (!o->exists || o->tier_gen != gen || o->onode.size != size ||
+	c->get_onode(oid, false) != o || is_tiered(o)) {
+      dout(20) << __func__ << " " << oid << " changed while reading" << dendl;
+      return;
+    }
+    txc = _txc_create(c.get(), c->osr.get(), nullptr);
+    txc->t->set(PREFIX_TIER, o->key.c_str(), o->key.size(), bl);
+    o->onode.set_flag(bluestore_onode_t::FLAG_TIER);
+    txc->write_onode(o);
+    txc->oncommits.push_back(new FunctionContext([o, gen](int) {
+	  o->tier_commit_gen = gen;
+	}));
+    {
+      std::lock_guard<std::mutex> l(tier_lock);
+      TierEntry& e = tier_objects[string(o->key.c_str(), o->key.size())];
+      e.oid = oid;
+      e.bytes = size;
+      e.last_access = mono_clock::now();
+      tier_bytes += size;
+      logger->set(l_bluestore_tier_bytes, tier_bytes);
+    }
+    dout(15) << __func__ << " " << c->cid << " " << oid << " 0x"
+	     << std::hex << size << std::dec << dendl;
+    _tier_prepare(txc);
+  }
+  logger->inc(l_bluestore_tier_promote);
+  _tier_submit(txc);
+}
+
+void BlueStore::_tier_demote(const ghobject_t& oid)
+{
+  // objects move between collections on split/merge, so go by oid
+  CollectionRef c;
+  {
+    RWLock::RLocker l(coll_lock);
+    for (auto& p : coll_map) {
+      if (p.second->contains(oid)) {
+	c = p.second;
+	break;
+      }
+    }
+  }
+  TransContext *txc = nullptr;
+  if (c) {
+    std::lock_guard<std::mutex> tl(c->tier_txc_lock);
+    RWLock::WLocker l(c->lock);
+    OnodeRef o = c->get_onode(oid, false);
+    if (o && o->exists &&
+	o->onode.has_flag(bluestore_onode_t::FLAG_TIER)) {
+      txc = _txc_create(c.get(), c->osr.get(), nullptr);
+      _tier_invalidate(txc, o);
+      dout(15) << __func__ << " " << c->cid << " " << oid << dendl;
+      _tier_prepare(txc);
+    }
+  }
+  if (!txc) {
+    // already gone
+    std::lock_guard<std::mutex> l(tier_lock);
+    for (auto p = tier_objects.begin(); p != tier_objects.end(); ++p) {
+      if (p->second.oid == oid) {
+	tier_bytes -= p->second.bytes;
+	tier_objects.erase(p);
+	break;
+      }
+    }
+    logger->set(l_bluestore_tier_bytes, tier_bytes);
+    return;
+  }
+  logger->inc(l_bluestore_tier_demote);
+  _tier_submit(txc);
+}
+
+void BlueStore::_tier_invalidate(TransContext *txc, OnodeRef& o)
+{
+  ++o->tier_gen;
+  if (!o->onode.has_flag(bluestore_onode_t::FLAG_TIER)) {
+    return;
+  }
+  dout(20) << __func__ << " " << o->oid << dendl;
+  txc->t->rmkey(PREFIX_TIER, o->key.c_str(), o->key.size());
+  o->onode.clear_flag(bluestore_onode_t::FLAG_TIER);
+  o->tier_reads = 0;
+  txc->write_onode(o);
+  std::lock_guard<std::mutex> l(tier_lock);
+  auto p = tier_objects.find(string(o->key.c_str(), o->key.size()));
+  if (p != tier_objects.end()) {
+    tier_bytes -= p->second.bytes;
+    tier_objects.erase(p);
+    logger->set(l_bluestore_tier_bytes, tier_bytes);
+  }
+}
+
+void BlueStore::_tier_prepare(TransContext *txc)
+{
+  // called with tier_txc_lock and the collection lock held, so that no
+  // client txc changes the onodes while they are encoded
+  _txc_write_nodes(txc, txc->t);
+  _txc_finalize_kv(txc, txc->t);
+}
+
+void BlueStore::_tier_submit(TransContext *txc)
+{
+  _txc_calc_cost(txc);
+  throttle_bytes.get(txc->cost);
+  logger->inc(l_bluestore_txc);
+  _txc_state_proc(txc);
+}
+
 // ---------------------------
 // transactions
 
@@ -9806,6 +11435,10 @@ int BlueStore::queue_transactions(
   dout(10) << __func__ << " ch " << c << " " << c->cid << dendl;
 
   // prepare
+  std::unique_lock<std::mutex> tl(c->tier_txc_lock, std::defer_lock);
+  if (tier_enabled) {
+    tl.lock();
+  }
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
 				  &on_commit);
 
@@ -9828,6 +11461,10 @@ int BlueStore::queue_transactions(
   }
 
   _txc_finalize_kv(txc, txc->t);
+  // a tier txc may only be prepared once this one's onodes are encoded
+  if (tl.owns_lock()) {
+    tl.unlock();
+  }
   if (handle)
     handle->suspend_tp_timeout();
 
@@ -9949,6 +11586,15 @@ void BlueStore::_txc_add_transaction(TransContext *txc, Transaction *t)
       }
       break;
 
+    case Transaction::OP_COLL_REMOVE_RANGE:
+      {
+	r = _remove_collection_range(txc, c, i.get_oid(op->oid),
+				     i.get_oid(op->dest_oid));
+	if (!r)
+	  continue;
+      }
+      break;
+
     case Transaction::OP_COLL_HINT:
       {
         uint32_t type = op->hint_type;
@@ -11315,6 +12961,131 @@ int BlueStore::_do_gc(
   return 0;
 }
 
+bool BlueStore::_defrag_throttle_get(uint64_t bytes)
+{
+  double rate = cct->_conf->bluestore_defrag_max_bytes_per_sec;
+  std::lock_guard<std::mutex> l(defrag_lock);
+  auto now = mono_clock::now();
+  // allow bursts of up to one second worth of rewrites
+  defrag_budget = std::min(
+    rate,
+    defrag_budget + rate * std::chrono::duration<double>(
+      now - defrag_budget_stamp).count());
+  defrag_budget_stamp = now;
+  // an object bigger than a second's worth is let in with a full budget
+  // and pays off the rest afterwards, so it is not starved forever
+  if (defrag_budget < std::min<double>(bytes, rate)) {
+    return false;
+  }
+  defrag_budget -= bytes;
+  return true;
+}
+
+int BlueStore::_do_defrag(
+  TransContext *txc,
+  CollectionRef& c,
+  OnodeRef& o)
+{
+  o->defrag_wanted = false;
+
+  // the rewrite allocates before the old extents are released, so stay
+  // away from the point where the txc could run out of space
+  uint64_t free = alloc->get_free();
+  uint64_t min_free = bdev->get_size() *
+    cct->_conf.get_val<double>("bluestore_defrag_min_free_ratio");
+  if (free < o->onode.size || free - o->onode.size < min_free) {
+    dout(20) << __func__ << " " << o->oid << " only " << byte_u_t(free)
+	     << " free, skipping" << dendl;
+    return 0;
+  }
+
+  o->extent_map.fault_range(db, 0, o->onode.size);
+
+  // collect runs of contiguous logical data (holes stay holes) and
+  // what they currently cost us
+  vector<pair<uint64_t,uint64_t>> runs;
+  uint64_t bytes = 0, allocated = 0;
+  unsigned lextents = o->extent_map.extent_map.size();
+  set<Blob*> blobs;
+  for (auto& e : o->extent_map.extent_map) {
+    if (e.blob->get_blob().is_shared()) {
+      // rewriting would unshare (and duplicate) data shared with clones
+      dout(20) << __func__ << " " << o->oid << " has shared blobs, skipping"
+	       << dendl;
+      return 0;
+    }
+    if (blobs.insert(e.blob.get()).second) {
+      for (auto& p : e.blob->get_blob().get_extents()) {
+	if (p.is_valid()) {
+	  allocated += p.length;
+	}
+      }
+    }
+    if (!runs.empty() && runs.back().first + runs.back().second ==
+	e.logical_offset) {
+      runs.back().second += e.length;
+    } else {
+      runs.emplace_back(e.logical_offset, e.length);
+    }
+    bytes += e.length;
+  }
+  if (lextents <= runs.size()) {
+    return 0;  // nothing to gain
+  }
+  if (!_defrag_throttle_get(bytes)) {
+    dout(20) << __func__ << " " << o->oid << " throttled, will retry" << dendl;
+    o->defrag_wanted = true;
+    return 0;
+  }
+
+  dout(10) << __func__ << " " << o->oid << " 0x" << std::hex << bytes
+	   << std::dec << " bytes in " << lextents << " lextents, "
+	   << blobs.size() << " blobs, " << runs.size() << " runs" << dendl;
+  for (auto& run : runs) {
+    bufferlist bl;
+    int r = _do_read(c.get(), o, run.first, run.second, bl, 0);
+    if (r < 0) {
+      // what we have rewritten so far is still valid; just stop
+      derr << __func__ << " " << o->oid << " read failed: " << cpp_strerror(r)
+	   << dendl;
+      break;
+    }
+    ceph_assert(r == (int)run.second);
+    r = _do_write(txc, c, o, run.first, run.second, bl, 0);
+    if (r < 0) {
+      return r;
+    }
+  }
+  txc->write_onode(o);
+  o->defrag_wanted = false;  // our own reads saw the old layout
+
+  uint64_t new_allocated = 0;
+  blobs.clear();
+  for (auto& e : o->extent_map.extent_map) {
+    if (blobs.insert(e.blob.get()).second) {
+      for (auto& p : e.blob->get_blob().get_extents()) {
+	if (p.is_valid()) {
+	  new_allocated += p.length;
+	}
+      }
+    }
+  }
+  dout(10) << __func__ << " " << o->oid << " now "
+	   << o->extent_map.extent_map.size() << " lextents, "
+	   << blobs.size() << " blobs" << dendl;
+  logger->inc(l_bluestore_defrag_objects);
+  logger->inc(l_bluestore_defrag_bytes, bytes);
+  if (lextents > o->extent_map.extent_map.size()) {
+    logger->inc(l_bluestore_defrag_extents_removed,
+		lextents - o->extent_map.extent_map.size());
+  }
+  if (allocated > new_allocated) {
+    logger->inc(l_bluestore_defrag_reclaimed_bytes,
+		allocated - new_allocated);
+  }
+  return 0;
+}
+
 int BlueStore::_do_write(
   TransContext *txc,
   CollectionRef& c,
@@ -11339,6 +13110,7 @@ int BlueStore::_do_write(
   if (length == 0) {
     return 0;
   }
+  _tier_invalidate(txc, o);
 
   uint64_t end = offset + length;
 
@@ -11413,6 +13185,9 @@ int BlueStore::_write(TransContext *txc,
     _assign_nid(txc, o);
     r = _do_write(txc, c, o, offset, length, bl, fadvise_flags);
     txc->write_onode(o);
+    if (r >= 0 && o->defrag_wanted) {
+      r = _do_defrag(txc, c, o);
+    }
   }
   dout(10) << __func__ << " " << c->cid << " " << o->oid
 	   << " 0x" << std::hex << offset << "~" << length << std::dec
@@ -11452,6 +13227,7 @@ int BlueStore::_do_zero(TransContext *txc,
   int r = 0;
 
   _dump_onode(o);
+  _tier_invalidate(txc, o);
 
   WriteContext wctx;
   o->extent_map.fault_range(db, offset, length);
@@ -11483,6 +13259,7 @@ void BlueStore::_do_truncate(
 
   if (offset == o->onode.size)
     return;
+  _tier_invalidate(txc, o);
 
   if (offset < o->onode.size) {
     WriteContext wctx;
@@ -11532,16 +13309,26 @@ int BlueStore::_truncate(TransContext *txc,
 int BlueStore::_do_remove(
   TransContext *txc,
   CollectionRef& c,
-  OnodeRef o)
+  OnodeRef o,
+  bool bulk)
 {
   set<SharedBlob*> maybe_unshared_blobs;
   bool is_gen = !o->oid.is_no_gen();
+  // keys written earlier in this txc are not visible to an iterator
+  // yet, so only a plain range removal is safe for those objects.  Decide
+  // before the truncate below dirties the onode in this txc.
+  bool bulk_omap = bulk &&
+    !txc->onodes.count(o) && !txc->modified_objects.count(o);
   _do_truncate(txc, c, o, 0, is_gen ? &maybe_unshared_blobs : nullptr);
   if (o->onode.has_omap()) {
     o->flush();
-    _do_omap_clear(txc,
-		   o->onode.is_pgmeta_omap() ? PREFIX_PGMETA_OMAP : PREFIX_OMAP,
-		   o->onode.nid);
+    const string& prefix =
+      o->onode.is_pgmeta_omap() ? PREFIX_PGMETA_OMAP : PREFIX_OMAP;
+    if (bulk_omap) {
+      _do_omap_clear_bulk(txc, c.get(), prefix, o->onode.nid);
+    } else {
+      _do_omap_clear(txc, prefix, o->onode.nid);
+    }
   }
   o->exists = false;
   string key;
@@ -11632,6 +13419,43 @@ int BlueStore::_do_remove(
   return 0;
 }
 
+int BlueStore::_remove_collection_range(TransContext *txc,
+					CollectionRef& c,
+					const ghobject_t& first,
+					const ghobject_t& end)
+{
+  dout(15) << __func__ << " " << c->cid << " " << first << " to " << end
+	   << dendl;
+  RWLock::WLocker l(c->lock);
+  vector<ghobject_t> ls;
+  ghobject_t next;
+  unsigned removed = 0;
+  int r = _collection_list(c.get(), first, end, INT_MAX, &ls, &next);
+  if (r < 0) {
+    goto out;
+  }
+  for (auto& oid : ls) {
+    if (oid.is_pgmeta()) {
+      continue;
+    }
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists) {
+      continue;
+    }
+    r = _do_remove(txc, c, o, true);
+    if (r < 0) {
+      goto out;
+    }
+    ++removed;
+  }
+  logger->inc(l_bluestore_bulk_remove_objects, removed);
+
+ out:
+  dout(10) << __func__ << " " << c->cid << " " << first << " to " << end
+	   << " removed " << removed << " = " << r << dendl;
+  return r;
+}
+
 int BlueStore::_remove(TransContext *txc,
 		       CollectionRef& c,
 		       OnodeRef &o)
@@ -11748,6 +13572,52 @@ void BlueStore::_do_omap_clear(TransContext *txc, const string& omap_prefix,
            << pretty_binary_string(tail) << dendl;
 }
 
+/*
+ * Omap removal for bulk object removal.  Small omaps are removed key by
+ * key; a range tombstone for each of them would only slow down later
+ * reads.  Big ones (e.g., bucket index shards) get a single range delete
+ * instead of one tombstone per key, and their nids are remembered on the
+ * collection so the span can be compacted once the collection is gone.
+ */
+void BlueStore::_do_omap_clear_bulk(TransContext *txc, Collection *c,
+				    const string& omap_prefix, uint64_t id)
+{
+  string head, tail;
+  get_omap_header(id, &head);
+  get_omap_tail(id, &tail);
+  uint64_t min_keys = cct->_conf->bluestore_bulk_remove_rmrange_min_keys;
+
+  vector<string> keys;
+  KeyValueDB::Iterator it = db->get_iterator(omap_prefix);
+  for (it->lower_bound(head);
+       it->valid() && it->key() < tail && keys.size() < min_keys;
+       it->next()) {
+    keys.push_back(it->key());
+  }
+  if (keys.size() < min_keys) {
+    dout(20) << __func__ << " 0x" << std::hex << id << std::dec
+	     << " removing " << keys.size() << " keys" << dendl;
+    for (auto& k : keys) {
+      txc->t->rmkey(omap_prefix, k);
+    }
+    return;
+  }
+
+  dout(20) << __func__ << " 0x" << std::hex << id << std::dec
+	   << " range delete " << pretty_binary_string(head)
+	   << " to " << pretty_binary_string(tail) << dendl;
+  txc->t->rm_range_keys_bulk(omap_prefix, head, tail);
+  logger->inc(l_bluestore_bulk_remove_omap_rmrange);
+  if (omap_prefix == PREFIX_OMAP) {
+    if (!c->rmrange_nid_max) {
+      c->rmrange_nid_min = c->rmrange_nid_max = id;
+    } else {
+      c->rmrange_nid_min = std::min(c->rmrange_nid_min, id);
+      c->rmrange_nid_max = std::max(c->rmrange_nid_max, id);
+    }
+  }
+}
+
 int BlueStore::_omap_clear(TransContext *txc,
 			   CollectionRef& c,
 			   OnodeRef& o)
@@ -12025,6 +13895,7 @@ int BlueStore::_do_clone_range(
   newo->extent_map.fault_range(db, dstoff, length);
   _dump_onode(oldo);
   _dump_onode(newo);
+  _tier_invalidate(txc, newo);
 
   oldo->extent_map.dup(this, txc, c, oldo, newo, srcoff, length, dstoff);
   _dump_onode(oldo);
@@ -12101,6 +13972,8 @@ int BlueStore::_rename(TransContext *txc,
     ceph_assert(txc->onodes.count(newo) == 0);
   }
 
+  // the copy is keyed by the old name
+  _tier_invalidate(txc, oldo);
   txc->t->rmkey(PREFIX_OBJ, oldo->key.c_str(), oldo->key.size());
 
   // rewrite shards
@@ -12217,6 +14090,19 @@ int BlueStore::_remove_collection(TransContext *txc, const coll_t &cid,
         }
       }
       if (!exists) {
+	if ((*c)->rmrange_nid_max &&
+	    cct->_conf->bluestore_bulk_remove_compact) {
+	  // drop the range tombstones left behind by bulk removal, along
+	  // with the collection's onode keys
+	  string start, end, temp_start, temp_end;
+	  get_omap_header((*c)->rmrange_nid_min, &start);
+	  get_omap_tail((*c)->rmrange_nid_max, &end);
+	  txc->compact_ranges.emplace_back(PREFIX_OMAP, start, end);
+	  get_coll_key_range(cid, (*c)->cnode.bits, &temp_start, &temp_end,
+			     &start, &end);
+	  txc->compact_ranges.emplace_back(PREFIX_OBJ, temp_start, temp_end);
+	  txc->compact_ranges.emplace_back(PREFIX_OBJ, start, end);
+	}
 	_do_remove_collection(txc, c);
         r = 0;
       } else {
@@ -21,6 +21,7 @@
 
 #include <atomic>
 #include <mutex>
+#include <shared_mutex>
 #include <condition_variable>
 
 #include <boost/intrusive/list.hpp>
@@ -37,6 +38,7 @@
 #include "common/Throttle.h"
 #include "common/perf_counters.h"
 #include "common/PriorityCache.h"
+#include "common/admin_socket.h"
 #include "compressor/Compressor.h"
 #include "os/ObjectStore.h"
 
@@ -81,14 +83,20 @@ enum {
   l_bluestore_read_lat,
   l_bluestore_read_onode_meta_lat,
   l_bluestore_read_wait_aio_lat,
+  l_bluestore_read_sliced_bytes,
+  l_bluestore_read_copied_bytes,
   l_bluestore_compress_lat,
   l_bluestore_decompress_lat,
+  l_bluestore_decompress_cache_hit_bytes,
+  l_bluestore_decompress_saved_time,
   l_bluestore_csum_lat,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
   l_bluestore_write_pad_bytes,
   l_bluestore_deferred_write_ops,
   l_bluestore_deferred_write_bytes,
+  l_bluestore_deferred_batch_hist,
+  l_bluestore_deferred_wait_hist,
   l_bluestore_write_penalty_read_ops,
   l_bluestore_allocated,
   l_bluestore_stored,
@@ -106,6 +114,9 @@ enum {
   l_bluestore_buffer_bytes,
   l_bluestore_buffer_hit_bytes,
   l_bluestore_buffer_miss_bytes,
+  l_bluestore_onode_hit_permille,
+  l_bluestore_buffer_hit_permille,
+  l_bluestore_cache_lock_wait_lat,
   l_bluestore_write_big,
   l_bluestore_write_big_bytes,
   l_bluestore_write_big_blobs,
@@ -120,9 +131,20 @@ enum {
   l_bluestore_blob_split,
   l_bluestore_extent_compress,
   l_bluestore_gc_merged,
+  l_bluestore_defrag_candidates,
+  l_bluestore_defrag_objects,
+  l_bluestore_defrag_bytes,
+  l_bluestore_defrag_extents_removed,
+  l_bluestore_defrag_reclaimed_bytes,
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_fragmentation,
+  l_bluestore_bulk_remove_objects,
+  l_bluestore_bulk_remove_omap_rmrange,
+  l_bluestore_tier_hit,
+  l_bluestore_tier_promote,
+  l_bluestore_tier_demote,
+  l_bluestore_tier_bytes,
   l_bluestore_last
 };
 
@@ -343,7 +365,7 @@ public:
     }
     void _finish_write(Cache* cache, uint64_t seq);
     void did_read(Cache* cache, uint32_t offset, bufferlist& bl) {
-      std::lock_guard<std::recursive_mutex> l(cache->lock);
+      auto l = cache->lock_and_track();
       Buffer *b = new Buffer(this, Buffer::STATE_CLEAN, 0, offset, bl);
       b->cache_private = _discard(cache, offset, bl.length());
       _add_buffer(cache, b, 1, nullptr);
@@ -1034,6 +1056,21 @@ public:
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
 
+    /// referenced since the last clock sweep (ClockCache only)
+    std::atomic<bool> cache_ref = {false};
+
+    /// a read found this object fragmented; rewrite it on the next write
+    std::atomic<bool> defrag_wanted = {false};
+
+    /// reads since the onode was loaded; drives promotion to the db tier
+    std::atomic<uint32_t> tier_reads = {0};
+    /// bumped on every data mutation, so a promotion can tell whether
+    /// the data it read is still current
+    std::atomic<uint64_t> tier_gen = {0};
+    /// tier_gen when the last promotion's copy committed; the copy is
+    /// only current while the two match
+    std::atomic<uint64_t> tier_commit_gen = {0};
+
     ExtentMap extent_map;
 
     // track txc's that have not been committed to kv store (and whose
@@ -1091,6 +1128,23 @@ public:
     virtual uint64_t _get_num_onodes() = 0;
     virtual uint64_t _get_buffer_bytes() = 0;
 
+    /// true if _touch_onode() may be called without holding lock
+    virtual bool lockless_onode_hits() const {
+      return false;
+    }
+
+    /// take lock, accounting the time spent waiting for it
+    std::unique_lock<std::recursive_mutex> lock_and_track() {
+      std::unique_lock<std::recursive_mutex> l(lock, std::try_to_lock);
+      if (!l.owns_lock()) {
+	auto start = mono_clock::now();
+	l.lock();
+	logger->tinc(l_bluestore_cache_lock_wait_lat,
+		     mono_clock::now() - start);
+      }
+      return l;
+    }
+
     void add_extent() {
       ++num_extents;
     }
@@ -1105,7 +1159,7 @@ public:
       --num_blobs;
     }
 
-    void trim(uint64_t onode_max, uint64_t buffer_max);
+    virtual void trim(uint64_t onode_max, uint64_t buffer_max);
 
     void trim_all();
 
@@ -1310,6 +1364,126 @@ public:
       *bytes += buffer_bytes;
     }
 
+#ifdef DEBUG_CACHE
+    void _audit(const char *s) override;
+#endif
+  };
+
+  /// CLOCK (second chance) cache for onodes and buffers
+  ///
+  /// Hits only set a reference bit (Onode::cache_ref for onodes,
+  /// Buffer::cache_private for buffers) instead of reordering a list, so
+  /// onode hits need neither the shard lock nor a write to shared list
+  /// heads.  trim() sweeps the tail of each ring in batches, giving
+  /// referenced entries a second chance and dropping the shard lock
+  /// between batches.  One trim() makes at most one pass over each ring.
+  struct ClockCache : public Cache {
+  private:
+    typedef boost::intrusive::list<
+      Onode,
+      boost::intrusive::member_hook<
+        Onode,
+	boost::intrusive::list_member_hook<>,
+	&Onode::lru_item> > onode_ring_t;
+    typedef boost::intrusive::list<
+      Buffer,
+      boost::intrusive::member_hook<
+	Buffer,
+	boost::intrusive::list_member_hook<>,
+	&Buffer::lru_item> > buffer_ring_t;
+
+    onode_ring_t onode_ring;
+
+    buffer_ring_t buffer_ring;
+    uint64_t buffer_size = 0;
+
+    /// progress of one trim(), carried across _trim_some() batches
+    struct trim_state_t {
+      bool started = false;
+      uint64_t buffers_left = 0;  ///< buffer ring entries left to visit
+      uint64_t onodes_left = 0;   ///< onode ring entries left to visit
+      int skipped = 0;            ///< pinned onodes skipped so far
+    };
+
+    /// visit up to max_work entries; return true if there is more to do
+    bool _trim_some(uint64_t onode_max, uint64_t buffer_max,
+		    unsigned max_work, trim_state_t *ts);
+
+  public:
+    ClockCache(CephContext* cct) : Cache(cct) {}
+    uint64_t _get_num_onodes() override {
+      return onode_ring.size();
+    }
+    bool lockless_onode_hits() const override {
+      return true;
+    }
+    void _add_onode(OnodeRef& o, int level) override {
+      o->cache_ref.store(false, std::memory_order_relaxed);
+      if (level > 0)
+	onode_ring.push_front(*o);
+      else
+	onode_ring.push_back(*o);
+    }
+    void _rm_onode(OnodeRef& o) override {
+      auto q = onode_ring.iterator_to(*o);
+      onode_ring.erase(q);
+    }
+    void _touch_onode(OnodeRef& o) override {
+      // avoid dirtying the cache line if the bit is already set
+      if (!o->cache_ref.load(std::memory_order_relaxed)) {
+	o->cache_ref.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    uint64_t _get_buffer_bytes() override {
+      return buffer_size;
+    }
+    void _add_buffer(Buffer *b, int level, Buffer *near) override {
+      // cache_private is the reference bit; a non-zero value inherited
+      // from a discarded buffer (or from near) counts as a hit
+      if (near) {
+	b->cache_private = near->cache_private;
+	buffer_ring.insert(buffer_ring.iterator_to(*near), *b);
+      } else if (level > 0) {
+	buffer_ring.push_front(*b);
+      } else {
+	buffer_ring.push_back(*b);
+      }
+      buffer_size += b->length;
+    }
+    void _rm_buffer(Buffer *b) override {
+      ceph_assert(buffer_size >= b->length);
+      buffer_size -= b->length;
+      auto q = buffer_ring.iterator_to(*b);
+      buffer_ring.erase(q);
+    }
+    void _move_buffer(Cache *src, Buffer *b) override {
+      src->_rm_buffer(b);
+      _add_buffer(b, 0, nullptr);
+    }
+    void _adjust_buffer_size(Buffer *b, int64_t delta) override {
+      ceph_assert((int64_t)buffer_size + delta >= 0);
+      buffer_size += delta;
+    }
+    void _touch_buffer(Buffer *b) override {
+      b->cache_private = 1;
+    }
+
+    void trim(uint64_t onode_max, uint64_t buffer_max) override;
+    void _trim(uint64_t onode_max, uint64_t buffer_max) override;
+
+    void add_stats(uint64_t *onodes, uint64_t *extents,
+		   uint64_t *blobs,
+		   uint64_t *buffers,
+		   uint64_t *bytes) override {
+      std::lock_guard<std::recursive_mutex> l(lock);
+      *onodes += onode_ring.size();
+      *extents += num_extents;
+      *blobs += num_blobs;
+      *buffers += buffer_ring.size();
+      *bytes += buffer_size;
+    }
+
 #ifdef DEBUG_CACHE
     void _audit(const char *s) override;
 #endif
@@ -1322,6 +1496,10 @@ public:
     /// forward lookups
     mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
 
+    /// protects onode_map.  Writers also hold cache->lock; readers may
+    /// skip cache->lock if cache->lockless_onode_hits().
+    std::shared_mutex map_lock;
+
     friend class Collection; // for split_cache()
 
   public:
@@ -1333,8 +1511,11 @@ public:
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
     void remove(const ghobject_t& oid) {
+      std::unique_lock<std::shared_mutex> l(map_lock);
       onode_map.erase(oid);
     }
+    /// remove o unless someone else holds a reference to it
+    bool remove_if_unpinned(Onode *o);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_other::string& new_okey);
@@ -1357,6 +1538,9 @@ public:
     Cache *cache;       ///< our cache shard
     bluestore_cnode_t cnode;
     RWLock lock;
+    /// held from txc creation through op application while the data
+    /// tier is enabled, so background tier txcs order correctly
+    std::mutex tier_txc_lock;
 
     bool exists;
 
@@ -1370,7 +1554,16 @@ public:
     pool_opts_t pool_opts;
     ContextQueue *commit_queue;
 
+    /// nid span of omaps removed with range tombstones by bulk removal;
+    /// compacted once the collection itself goes away (0 if none)
+    uint64_t rmrange_nid_min = 0, rmrange_nid_max = 0;
+
     OnodeRef get_onode(const ghobject_t& oid, bool create);
+    /// load the onodes not already cached with one batched kv lookup
+    void prefetch_onodes(const vector<ghobject_t>& oids);
+    Onode *_decode_onode(const ghobject_t& oid,
+			 const mempool::bluestore_cache_other::string& key,
+			 const bufferlist& v);
 
     // the terminology is confusing here, sorry!
     //
@@ -1503,6 +1696,9 @@ public:
   struct TransContext final : public AioContext {
     MEMPOOL_CLASS_HELPERS();
 
+    static constexpr int NUM_STATE_LAT =
+      l_bluestore_state_done_lat - l_bluestore_state_prepare_lat + 1;
+
     typedef enum {
       STATE_PREPARE,
       STATE_AIO_WAIT,
@@ -1536,8 +1732,7 @@ public:
       return "???";
     }
 
-#if defined(WITH_LTTNG) && defined(WITH_EVENTTRACE)
-    const char *get_state_latency_name(int state) {
+    static const char *get_state_latency_name(int state) {
       switch (state) {
       case l_bluestore_state_prepare_lat: return "prepare";
       case l_bluestore_state_aio_wait_lat: return "aio_wait";
@@ -1546,18 +1741,22 @@ public:
       case l_bluestore_state_kv_committing_lat: return "kv_committing";
       case l_bluestore_state_kv_done_lat: return "kv_done";
       case l_bluestore_state_deferred_queued_lat: return "deferred_queued";
+      case l_bluestore_state_deferred_aio_wait_lat: return "deferred_aio_wait";
       case l_bluestore_state_deferred_cleanup_lat: return "deferred_cleanup";
       case l_bluestore_state_finishing_lat: return "finishing";
       case l_bluestore_state_done_lat: return "done";
       }
       return "???";
     }
-#endif
 
     void log_state_latency(PerfCounters *logger, int state) {
       utime_t lat, now = ceph_clock_now();
       lat = now - last_stamp;
       logger->tinc(state, lat);
+      if (state >= l_bluestore_state_prepare_lat &&
+	  state <= l_bluestore_state_done_lat) {
+	state_lat[state - l_bluestore_state_prepare_lat] += lat.to_nsec() / 1000;
+      }
 #if defined(WITH_LTTNG) && defined(WITH_EVENTTRACE)
       if (state >= l_bluestore_state_prepare_lat && state <= l_bluestore_state_done_lat) {
         double usecs = (now.to_nsec()-last_stamp.to_nsec())/1000;
@@ -1581,6 +1780,8 @@ public:
     KeyValueDB::Transaction t; ///< then we will commit this
     list<Context*> oncommits;  ///< more commit completions
     list<CollectionRef> removed_collections; ///< colls we removed
+    /// (prefix, start, end) kv ranges to compact once we are committed
+    vector<std::tuple<string,string,string>> compact_ranges;
 
     boost::intrusive::list_member_hook<> deferred_queue_item;
     bluestore_deferred_transaction_t *deferred_txn = nullptr; ///< if any
@@ -1594,6 +1795,7 @@ public:
     uint64_t seq = 0;
     utime_t start;
     utime_t last_stamp;
+    uint32_t state_lat[NUM_STATE_LAT] = {0};  ///< usec spent in each state
 
     uint64_t last_nid = 0;     ///< if non-zero, highest new nid we allocated
     uint64_t last_blobid = 0;  ///< if non-zero, highest new blobid we allocated
@@ -1645,6 +1847,46 @@ public:
       boost::intrusive::list_member_hook<>,
       &TransContext::deferred_queue_item> > deferred_queue_t;
 
+  /// ring of per-state latencies of recently finished transactions
+  ///
+  /// Writers claim a slot with a single fetch_add and publish it with a
+  /// per-slot sequence number, so recording never takes a lock.  Readers
+  /// copy a slot and discard it if it was rewritten under them.
+  class TxcTrace {
+  public:
+    struct record_t {
+      uint64_t seq = 0;
+      coll_t cid;
+      utime_t start;
+      uint64_t bytes = 0;
+      uint32_t state_lat[TransContext::NUM_STATE_LAT] = {0};
+    };
+
+    explicit TxcTrace(size_t size)
+      : size(size), slots(new slot_t[size]) {}
+
+    void record(const TransContext *txc);
+    void snapshot(vector<record_t> *out) const;
+
+    void dump(Formatter *f) const;
+    void dump_histograms(Formatter *f) const;
+
+  private:
+    struct slot_t {
+      std::atomic<uint64_t> version = {0};  ///< odd while being written
+      uint64_t seq = 0;
+      spg_t pgid;
+      bool is_pg = false;
+      utime_t start;
+      uint64_t bytes = 0;
+      uint32_t state_lat[TransContext::NUM_STATE_LAT] = {0};
+    };
+
+    const size_t size;
+    std::unique_ptr<slot_t[]> slots;
+    std::atomic<uint64_t> head = {0};
+  };
+
   struct DeferredBatch final : public AioContext {
     OpSequencer *osr;
     struct deferred_io {
@@ -1656,6 +1898,8 @@ public:
     IOContext ioc;                   ///< our aios
     /// bytes of pending io for each deferred seq (may be 0)
     map<uint64_t,int> seq_bytes;
+    mono_time start = mono_clock::now();  ///< first txc queued
+    mono_time submitted;                  ///< aios submitted
 
     void _discard(CephContext *cct, uint64_t offset, uint64_t length);
     void _audit(CephContext *cct);
@@ -1816,6 +2060,15 @@ public:
     }
   };
 
+  struct TierThread : public Thread {
+    BlueStore *store;
+    explicit TierThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_tier_thread();
+      return NULL;
+    }
+  };
+
   struct DBHistogram {
     struct value_dist {
       uint64_t count;
@@ -1883,6 +2136,8 @@ private:
   deferred_osr_queue_t deferred_queue; ///< osr's with deferred io pending
   int deferred_queue_size = 0;         ///< num txc's queued across all osrs
   atomic_int deferred_aggressive = {0}; ///< aggressive wakeup of kv thread
+  atomic_int deferred_inflight = {0};   ///< num running deferred batches
+  std::atomic<uint64_t> deferred_lat_avg = {0}; ///< ewma batch latency (ns)
   Finisher deferred_finisher, finisher;
 
   KVSyncThread kv_sync_thread;
@@ -1904,8 +2159,28 @@ private:
   deque<TransContext*> kv_committing_to_finalize;   ///< pending finalization
   deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
 
+  // small hot objects copied into the kv store (i.e., onto block.db)
+  struct TierEntry {
+    ghobject_t oid;
+    uint64_t bytes = 0;
+    mono_time last_access;
+  };
+  bool tier_enabled = false;      ///< bluestore_tier and a dedicated db
+  TierThread tier_thread;
+  std::mutex tier_lock;
+  std::condition_variable tier_cond;
+  bool tier_stop = false;
+  deque<pair<coll_t,ghobject_t>> tier_promote_queue;
+  map<string,TierEntry> tier_objects;  ///< onode key -> entry
+  uint64_t tier_bytes = 0;
+
   PerfCounters *logger = nullptr;
 
+  std::unique_ptr<TxcTrace> txc_trace;  ///< if bluestore_txc_trace_size > 0
+
+  class SocketHook;
+  SocketHook *asok_hook = nullptr;
+
   list<CollectionRef> removed_collections;
 
   RWLock debug_read_error_lock = {"BlueStore::debug_read_error_lock"};
@@ -1914,6 +2189,9 @@ private:
 
   std::atomic<int> csum_type = {Checksummer::CSUM_CRC32C};
 
+  ///< recent decompression cost, for estimating what cache hits save
+  std::atomic<uint64_t> decompress_ns_per_kb = {0};
+
   uint64_t block_size = 0;     ///< block size of block device (power of 2)
   uint64_t block_mask = 0;     ///< mask to get just the block offset
   size_t block_size_order = 0; ///< bits to shift to get block size
@@ -1931,6 +2209,16 @@ private:
   ///< number threshold for forced deferred writes
   std::atomic<int> deferred_batch_ops = {0};
 
+  std::mutex defrag_lock;
+  double defrag_budget = 0;   ///< bytes we may rewrite right now
+  mono_time defrag_budget_stamp = mono_clock::now(); ///< last refill
+
+  ///< scale deferred batching with observed device latency and depth
+  std::atomic<bool> deferred_batch_adaptive = {false};
+
+  ///< max time a deferred txc may wait for its batch (adaptive mode)
+  std::atomic<double> deferred_batch_max_wait = {0};
+
   ///< size threshold for forced deferred writes
   std::atomic<uint64_t> prefer_deferred_size = {0};
 
@@ -2102,6 +2390,8 @@ private:
   // private methods
 
   void _init_logger();
+  void _init_asok();
+  void _shutdown_asok();
   void _shutdown_logger();
   int _reload_logger();
 
@@ -2133,6 +2423,11 @@ private:
   void _close_fm();
   int _open_alloc();
   void _close_alloc();
+  int _load_alloc_snapshot(
+    std::function<void(uint64_t offset, uint64_t length)> notify,
+    uint64_t *num, uint64_t *bytes);
+  int _write_alloc_snapshot();
+  int _invalidate_alloc_snapshot();
   int _open_collections(int *errors=0);
   void _close_collections();
 
@@ -2161,6 +2456,10 @@ private:
   void _queue_reap_collection(CollectionRef& c);
   void _reap_collections();
   void _update_cache_logger();
+  uint64_t last_onode_hits = 0;         ///< for hit ratio gauges
+  uint64_t last_onode_misses = 0;
+  uint64_t last_buffer_hit_bytes = 0;
+  uint64_t last_buffer_miss_bytes = 0;
 
   void _assign_nid(TransContext *txc, OnodeRef o);
   uint64_t _assign_blobid(TransContext *txc);
@@ -2200,6 +2499,18 @@ private:
   void _kv_sync_thread();
   void _kv_finalize_thread();
 
+  int _tier_start();
+  void _tier_stop();
+  void _tier_thread();
+  bool _tier_read(Collection *c, OnodeRef& o, uint64_t offset, size_t length,
+		  bufferlist& bl);
+  void _tier_promote(const coll_t& cid, const ghobject_t& oid);
+  void _tier_demote(const ghobject_t& oid);
+  void _tier_invalidate(TransContext *txc, OnodeRef& o);
+  void _tier_prepare(TransContext *txc);
+  void _tier_submit(TransContext *txc);
+  bool _tier_db_has_room(uint64_t bytes);
+
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc, OnodeRef o);
   void _deferred_queue(TransContext *txc);
 public:
@@ -2207,6 +2518,8 @@ public:
 private:
   void _deferred_submit_unlock(OpSequencer *osr);
   void _deferred_aio_finish(OpSequencer *osr);
+  ceph::timespan _deferred_wait_budget();
+  bool _deferred_batch_ready();
   int _deferred_replay();
 
 public:
@@ -2258,9 +2571,11 @@ private:
 
   // -- ondisk version ---
 public:
-  const int32_t latest_ondisk_format = 2;        ///< our version
+  const int32_t latest_ondisk_format = 3;        ///< our version
   const int32_t min_readable_ondisk_format = 1;  ///< what we can read
   const int32_t min_compat_ondisk_format = 2;    ///< who can read us
+  /// who can read us while an allocator snapshot exists
+  const int32_t alloc_snapshot_compat_ondisk_format = 3;
 
 private:
   int32_t ondisk_format = 0;  ///< value detected on mount
@@ -2284,6 +2599,10 @@ public:
   bool allows_journal() override { return false; };
 
   int get_devices(set<string> *ls) override;
+  int get_numa_node(
+    int *numa_node,
+    set<int> *nodes,
+    set<string> *failed) override;
 
   bool is_rotational() override;
   bool is_journal_rotational() override;
@@ -2332,6 +2651,20 @@ public:
   }
   int _fsck(bool deep, bool repair);
 
+  /// offline: move the prefixes in bluestore_rocksdb_cfs into their own
+  /// column families
+  int migrate_column_families(ostream& out);
+
+  /// offline: compare the allocator snapshot against the freelist
+  int check_alloc_snapshot(ostream& out) {
+    return _check_alloc_snapshot(false, out);
+  }
+  /// offline: regenerate the allocator snapshot from the freelist
+  int rebuild_alloc_snapshot(ostream& out) {
+    return _check_alloc_snapshot(true, out);
+  }
+  int _check_alloc_snapshot(bool rebuild, ostream& out);
+
   void set_cache_shards(unsigned num) override;
 
   int validate_hobject_key(const hobject_t &obj) const override {
@@ -2355,6 +2688,9 @@ public:
     logger->dump_formatted(f, false);
     f->close_section();
   }
+  /// recently finished txcs; see bluestore_txc_trace_size
+  void dump_txc_trace(Formatter *f);
+  void dump_txc_histograms(Formatter *f);
 
 public:
   int statfs(struct store_statfs_t *buf) override;
@@ -2457,6 +2793,10 @@ public:
     set<string> *out         ///< [out] Subset of keys defined on oid
     ) override;
 
+  void prefetch_objects(
+    CollectionHandle &c,
+    const vector<ghobject_t>& oids) override;
+
   ObjectMap::ObjectMapIterator get_omap_iterator(
     CollectionHandle &c,   ///< [in] collection
     const ghobject_t &oid  ///< [in] object
@@ -2521,6 +2861,20 @@ public:
 			   coll_t cid2, ghobject_t oid2,
 			   uint64_t offset);
 
+  /// deferred txcs waiting to be batched
+  int get_deferred_queue_size() const {
+    return deferred_queue_size;
+  }
+  /// number of queued deferred txcs that makes a batch ready right now
+  int get_deferred_batch_target() const {
+    int batch_ops = deferred_batch_ops.load();
+    if (!deferred_batch_adaptive) {
+      return batch_ops;
+    }
+    // a busy device gets bigger batches: more merging, fewer seeks
+    return batch_ops * (1 + deferred_inflight.load());
+  }
+
   void compact() override {
     ceph_assert(db);
     db->compact();
@@ -2704,6 +3058,10 @@ private:
 		uint64_t offset, uint64_t length,
 		bufferlist& bl,
 		uint32_t fadvise_flags);
+  bool _defrag_throttle_get(uint64_t bytes);
+  int _do_defrag(TransContext *txc,
+		 CollectionRef& c,
+		 OnodeRef& o);
   void _do_write_data(TransContext *txc,
                       CollectionRef& c,
                       OnodeRef o,
@@ -2737,7 +3095,12 @@ private:
 	      OnodeRef& o);
   int _do_remove(TransContext *txc,
 		 CollectionRef& c,
-		 OnodeRef o);
+		 OnodeRef o,
+		 bool bulk = false);
+  int _remove_collection_range(TransContext *txc,
+			       CollectionRef& c,
+			       const ghobject_t& first,
+			       const ghobject_t& end);
   int _setattr(TransContext *txc,
 	       CollectionRef& c,
 	       OnodeRef& o,
@@ -2755,6 +3118,8 @@ private:
 	       CollectionRef& c,
 	       OnodeRef& o);
   void _do_omap_clear(TransContext *txc, const string& prefix, uint64_t id);
+  void _do_omap_clear_bulk(TransContext *txc, Collection *c,
+			   const string& prefix, uint64_t id);
   int _omap_clear(TransContext *txc,
 		  CollectionRef& c,
 		  OnodeRef& o);
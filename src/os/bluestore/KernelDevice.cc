@@ -38,7 +38,6 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
     fd_buffered(-1),
     aio(false), dio(false),
     debug_lock("KernelDevice::debug_lock"),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     discard_callback(d_cb),
     discard_callback_priv(d_cbpriv),
     aio_stop(false),
@@ -48,6 +47,22 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
     discard_thread(this),
     injecting_crash(0)
 {
+  bool use_ioring = cct->_conf.get_val<bool>("bdev_ioring");
+
+  if (use_ioring && ioring_queue_t::supported()) {
+    io_queue = std::make_unique<ioring_queue_t>(
+      cct->_conf->bdev_aio_max_queue_depth,
+      cct->_conf.get_val<bool>("bdev_ioring_sqthread_poll"));
+  } else {
+    static bool once;
+    if (use_ioring && !once) {
+      derr << "WARNING: io_uring API is not supported! Fallback to libaio!"
+	   << dendl;
+      once = true;
+    }
+    io_queue = std::make_unique<aio_queue_t>(
+      cct->_conf->bdev_aio_max_queue_depth);
+  }
 }
 
 int KernelDevice::_lock()
@@ -188,6 +203,37 @@ int KernelDevice::get_devices(std::set<std::string> *ls)
   return 0;
 }
 
+int KernelDevice::get_numa_node(int *node) const
+{
+  if (devname.empty()) {
+    return -ENOENT;
+  }
+  // a device-mapper volume is local to a node only if all of its
+  // backing devices are
+  std::set<std::string> devs;
+  if (devname.find("dm-") == 0) {
+    get_dm_parents(devname, &devs);
+  } else {
+    devs.insert(devname);
+  }
+  int r = -ENOENT;
+  for (auto& dev : devs) {
+    int n = block_device_numa_node(dev.c_str());
+    if (n < 0) {
+      return n;
+    }
+    if (r >= 0 && n != r) {
+      return -EXDEV;
+    }
+    r = n;
+  }
+  if (r < 0) {
+    return r;
+  }
+  *node = r;
+  return 0;
+}
+
 void KernelDevice::close()
 {
   dout(1) << __func__ << dendl;
@@ -228,6 +274,10 @@ int KernelDevice::collect_metadata(const string& prefix, map<string,string> *pm)
   } else {
     (*pm)[prefix + "type"] = "ssd";
   }
+  int numa_node;
+  if (get_numa_node(&numa_node) == 0) {
+    (*pm)[prefix + "numa_node"] = stringify(numa_node);
+  }
   if (vdo_fd >= 0) {
     (*pm)[prefix + "vdo"] = "true";
     uint64_t total, avail;
@@ -349,7 +399,8 @@ int KernelDevice::_aio_start()
 {
   if (aio) {
     dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    std::vector<int> fds = { fd_direct };
+    int r = io_queue->init(fds);
     if (r < 0) {
       if (r == -EAGAIN) {
 	derr << __func__ << " io_setup(2) failed with EAGAIN; "
@@ -371,7 +422,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -426,7 +477,7 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = cct->_conf->bdev_aio_reap_max;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
@@ -658,7 +709,7 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
-  r = aio_queue.submit_batch(ioc->running_aios.begin(), e, 
+  r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
   
   if (retries)
@@ -191,6 +191,7 @@ int main(int argc, char **argv)
   string key, value;
   int log_level = 30;
   bool fsck_deep = false;
+  int fsck_threads = 0;
   po::options_description po_options("Options");
   po_options.add_options()
     ("help,h", "produce help message")
@@ -200,12 +201,13 @@ int main(int argc, char **argv)
     ("log-level", po::value<int>(&log_level), "log level (30=most, 20=lots, 10=some, 1=little)")
     ("dev", po::value<vector<string>>(&devs), "device(s)")
     ("deep", po::value<bool>(&fsck_deep), "deep fsck (read all data)")
+    ("threads", po::value<int>(&fsck_threads), "number of threads for deep fsck reads")
     ("key,k", po::value<string>(&key), "label metadata key name")
     ("value,v", po::value<string>(&value), "label metadata value")
     ;
   po::options_description po_positional("Positional options");
   po_positional.add_options()
-    ("command", po::value<string>(&action), "fsck, repair, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, show-label, set-label-key, rm-label-key, prime-osd-dir, bluefs-log-dump")
+    ("command", po::value<string>(&action), "fsck, repair, migrate-cf, alloc-snapshot-check, alloc-snapshot-rebuild, bluefs-export, bluefs-bdev-sizes, bluefs-bdev-expand, show-label, set-label-key, rm-label-key, prime-osd-dir, bluefs-log-dump")
     ;
   po::options_description po_all("All options");
   po_all.add(po_options).add(po_positional);
@@ -235,7 +237,8 @@ int main(int argc, char **argv)
     exit(EXIT_FAILURE);
   }
 
-  if (action == "fsck" || action == "repair") {
+  if (action == "fsck" || action == "repair" || action == "migrate-cf" ||
+      action == "alloc-snapshot-check" || action == "alloc-snapshot-rebuild") {
     if (path.empty()) {
       cerr << "must specify bluestore path" << std::endl;
       exit(EXIT_FAILURE);
@@ -319,6 +322,10 @@ int main(int argc, char **argv)
   if (action == "fsck" ||
       action == "repair") {
     validate_path(cct.get(), path, false);
+    if (fsck_threads > 0) {
+      cct->_conf.set_val_or_die("bluestore_fsck_threads",
+				stringify(fsck_threads));
+    }
     BlueStore bluestore(cct.get(), path);
     int r;
     if (action == "fsck") {
@@ -336,6 +343,32 @@ int main(int argc, char **argv)
       cout << action << " success" << std::endl;
     }
   }
+  else if (action == "migrate-cf") {
+    validate_path(cct.get(), path, false);
+    BlueStore bluestore(cct.get(), path);
+    int r = bluestore.migrate_column_families(cout);
+    if (r < 0) {
+      cerr << "error from migrate-cf: " << cpp_strerror(r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    cout << action << " success" << std::endl;
+  }
+  else if (action == "alloc-snapshot-check" ||
+	   action == "alloc-snapshot-rebuild") {
+    validate_path(cct.get(), path, false);
+    BlueStore bluestore(cct.get(), path);
+    int r;
+    if (action == "alloc-snapshot-check") {
+      r = bluestore.check_alloc_snapshot(cout);
+    } else {
+      r = bluestore.rebuild_alloc_snapshot(cout);
+    }
+    if (r < 0) {
+      cerr << "error from " << action << ": " << cpp_strerror(r) << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    cout << action << " success" << std::endl;
+  }
   else if (action == "prime-osd-dir") {
     bluestore_bdev_label_t label;
     int r = BlueStore::_read_bdev_label(cct.get(), devs.front(), &label);
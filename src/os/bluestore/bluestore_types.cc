@@ -1130,3 +1130,35 @@ void bluestore_compression_header_t::generate_test_instances(
   o.push_back(new bluestore_compression_header_t(1));
   o.back()->length = 1234;
 }
+
+// bluestore_alloc_snapshot_t
+
+void bluestore_alloc_snapshot_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("bdev_size", bdev_size);
+  f->dump_unsigned("min_alloc_size", min_alloc_size);
+  f->dump_unsigned("num_chunks", num_chunks);
+  f->dump_unsigned("num_extents", num_extents);
+  f->dump_unsigned("free_bytes", free_bytes);
+  f->open_array_section("bluefs_extents");
+  for (auto p = bluefs_extents.begin(); p != bluefs_extents.end(); ++p) {
+    f->open_object_section("extent");
+    f->dump_unsigned("offset", p.get_start());
+    f->dump_unsigned("length", p.get_len());
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void bluestore_alloc_snapshot_t::generate_test_instances(
+  list<bluestore_alloc_snapshot_t*>& o)
+{
+  o.push_back(new bluestore_alloc_snapshot_t);
+  o.push_back(new bluestore_alloc_snapshot_t);
+  o.back()->bdev_size = 1ull << 30;
+  o.back()->min_alloc_size = 4096;
+  o.back()->num_chunks = 2;
+  o.back()->num_extents = 3000;
+  o.back()->free_bytes = 1ull << 29;
+  o.back()->bluefs_extents.insert(0x10000, 0x100000);
+}
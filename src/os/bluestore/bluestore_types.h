@@ -904,6 +904,7 @@ struct bluestore_onode_t {
   enum {
     FLAG_OMAP = 1,       ///< object may have omap data
     FLAG_PGMETA_OMAP = 2,  ///< omap data is in meta omap prefix
+    FLAG_TIER = 4,       ///< a copy of the data is kept in the kv store
   };
 
   string get_flags_string() const {
@@ -911,6 +912,11 @@ struct bluestore_onode_t {
     if (flags & FLAG_OMAP) {
       s = "omap";
     }
+    if (flags & FLAG_TIER) {
+      if (s.length())
+	s += "+";
+      s += "tier";
+    }
     return s;
   }
 
@@ -1023,5 +1029,29 @@ struct bluestore_compression_header_t {
 };
 WRITE_CLASS_DENC(bluestore_compression_header_t)
 
+/// descriptor of the allocator free-space snapshot persisted on clean umount
+struct bluestore_alloc_snapshot_t {
+  uint64_t bdev_size = 0;        ///< size of the main device when written
+  uint64_t min_alloc_size = 0;   ///< allocation unit the extents are aligned to
+  uint64_t num_chunks = 0;       ///< number of extent chunk keys
+  uint64_t num_extents = 0;      ///< total free extents across all chunks
+  uint64_t free_bytes = 0;       ///< total free bytes across all chunks
+  interval_set<uint64_t> bluefs_extents;  ///< bluefs_extents when written
+
+  DENC(bluestore_alloc_snapshot_t, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.bdev_size, p);
+    denc(v.min_alloc_size, p);
+    denc(v.num_chunks, p);
+    denc(v.num_extents, p);
+    denc(v.free_bytes, p);
+    denc(v.bluefs_extents, p);
+    DENC_FINISH(p);
+  }
+  void dump(Formatter *f) const;
+  static void generate_test_instances(list<bluestore_alloc_snapshot_t*>& o);
+};
+WRITE_CLASS_DENC(bluestore_alloc_snapshot_t)
+
 
 #endif
@@ -10,6 +10,7 @@
 #define __FAST_BITMAP_ALLOCATOR_IMPL_H
 #include "include/intarith.h"
 
+#include <functional>
 #include <vector>
 #include <algorithm>
 #include <mutex>
@@ -464,6 +465,45 @@ public:
     }
     return res * l0_granularity;
   }
+
+  // report every run of free l0 entries, coalescing across slot borders
+  void foreach_free(
+    std::function<void(uint64_t offset, uint64_t length)> notify)
+  {
+    uint64_t run_start = 0;
+    uint64_t run_len = 0;
+    for (uint64_t i = 0; i < l0.size(); ++i) {
+      auto v = l0[i];
+      if (v == all_slot_set) {
+        if (!run_len) {
+          run_start = i * bits_per_slot;
+        }
+        run_len += bits_per_slot;
+        continue;
+      }
+      if (v == all_slot_clear) {
+        if (run_len) {
+          notify(run_start * l0_granularity, run_len * l0_granularity);
+          run_len = 0;
+        }
+        continue;
+      }
+      for (size_t b = 0; b < bits_per_slot; ++b) {
+        if (v & (slot_t(1) << b)) {
+          if (!run_len) {
+            run_start = i * bits_per_slot + b;
+          }
+          ++run_len;
+        } else if (run_len) {
+          notify(run_start * l0_granularity, run_len * l0_granularity);
+          run_len = 0;
+        }
+      }
+    }
+    if (run_len) {
+      notify(run_start * l0_granularity, run_len * l0_granularity);
+    }
+  }
 };
 
 class AllocatorLevel01Compact : public AllocatorLevel01
@@ -497,6 +537,12 @@ public:
     std::lock_guard<std::mutex> l(lock);
     return available;
   }
+  void foreach_internal(
+    std::function<void(uint64_t offset, uint64_t length)> notify)
+  {
+    std::lock_guard<std::mutex> l(lock);
+    l1.foreach_free(notify);
+  }
   inline uint64_t get_min_alloc_size() const
   {
     return l1.get_min_alloc_size();
@@ -0,0 +1,292 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ioring.h"
+
+#if defined(HAVE_LIBURING)
+
+#include <map>
+#include <mutex>
+#include <sys/epoll.h>
+
+#include "liburing.h"
+
+struct ioring_data {
+  struct io_uring io_uring;
+  std::mutex cq_mutex;
+  std::mutex sq_mutex;
+  int epoll_fd = -1;
+  std::map<int, int> fixed_fds_map;
+};
+
+static int ioring_get_cqe(struct ioring_data *d, unsigned int max,
+			  struct aio_t **paio)
+{
+  struct io_uring *ring = &d->io_uring;
+  struct io_uring_cqe *cqe;
+
+  unsigned nr = 0;
+  unsigned head;
+  io_uring_for_each_cqe(ring, head, cqe) {
+    struct aio_t *io = (struct aio_t *)(uintptr_t) io_uring_cqe_get_data(cqe);
+    io->rval = cqe->res;
+
+    paio[nr++] = io;
+
+    if (nr == max)
+      break;
+  }
+  io_uring_cq_advance(ring, nr);
+
+  return nr;
+}
+
+static int find_fixed_fd(struct ioring_data *d, int real_fd)
+{
+  auto it = d->fixed_fds_map.find(real_fd);
+  if (it == d->fixed_fds_map.end())
+    return -1;
+
+  return it->second;
+}
+
+static void init_sqe(struct ioring_data *d, struct io_uring_sqe *sqe,
+		     struct aio_t *io)
+{
+  int fixed_fd = find_fixed_fd(d, io->fd);
+
+  ceph_assert(fixed_fd != -1);
+
+  if (io->is_write())
+    io_uring_prep_writev(sqe, fixed_fd, &io->iov[0],
+			 io->iov.size(), io->offset);
+  else
+    io_uring_prep_readv(sqe, fixed_fd, &io->iov[0],
+			io->iov.size(), io->offset);
+
+  io_uring_sqe_set_data(sqe, io);
+  io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+}
+
+/*
+ * Fill as many SQEs as the ring has room for and submit them with a single
+ * io_uring_enter(2).  Returns the number of aios submitted, which may be
+ * less than the batch if the submission queue filled up.
+ */
+static int ioring_queue(struct ioring_data *d, void *priv,
+			list<aio_t>::iterator beg, list<aio_t>::iterator end)
+{
+  struct io_uring *ring = &d->io_uring;
+  int queued = 0;
+
+  ceph_assert(beg != end);
+
+  do {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+    if (!sqe)
+      break;
+
+    struct aio_t *io = &*beg;
+    io->priv = priv;
+
+    init_sqe(d, sqe, io);
+    ++queued;
+  } while (++beg != end);
+
+  if (!queued)
+    return 0;
+
+  int r = io_uring_submit(ring);
+  if (r < 0)
+    return r;
+  return queued;
+}
+
+static void build_fixed_fds_map(struct ioring_data *d,
+				std::vector<int> &fds)
+{
+  int fixed_fd = 0;
+  for (int real_fd : fds) {
+    d->fixed_fds_map[real_fd] = fixed_fd++;
+  }
+}
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_) :
+  d(std::make_unique<ioring_data>()),
+  iodepth(iodepth_),
+  sq_thread(sq_thread_)
+{
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  unsigned flags = 0;
+
+  if (sq_thread)
+    flags |= IORING_SETUP_SQPOLL;
+
+  int ret = io_uring_queue_init(iodepth, &d->io_uring, flags);
+  if (ret < 0)
+    return ret;
+
+  ret = io_uring_register_files(&d->io_uring,
+				&fds[0], fds.size());
+  if (ret < 0) {
+    goto close_ring_fd;
+  }
+
+  build_fixed_fds_map(d.get(), fds);
+
+  d->epoll_fd = epoll_create1(0);
+  if (d->epoll_fd < 0) {
+    ret = -errno;
+    goto close_ring_fd;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  ret = epoll_ctl(d->epoll_fd, EPOLL_CTL_ADD, d->io_uring.ring_fd, &ev);
+  if (ret < 0) {
+    ret = -errno;
+    goto close_epoll_fd;
+  }
+
+  return 0;
+
+close_epoll_fd:
+  close(d->epoll_fd);
+  d->epoll_fd = -1;
+close_ring_fd:
+  d->fixed_fds_map.clear();
+  io_uring_queue_exit(&d->io_uring);
+
+  return ret;
+}
+
+void ioring_queue_t::shutdown()
+{
+  d->fixed_fds_map.clear();
+  close(d->epoll_fd);
+  d->epoll_fd = -1;
+  io_uring_queue_exit(&d->io_uring);
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  // same back-off as aio_queue_t: 2^16 * 125us = ~8 seconds
+  int attempts = 16;
+  int delay = 125;
+  int done = 0;
+
+  std::lock_guard<std::mutex> l(d->sq_mutex);
+  while (beg != end) {
+    int r = ioring_queue(d.get(), priv, beg, end);
+    if (r < 0) {
+      return r;
+    }
+    if (r == 0) {
+      // submission queue is full, let the kernel drain it
+      if (attempts-- > 0) {
+	usleep(delay);
+	delay *= 2;
+	(*retries)++;
+	continue;
+      }
+      return -EAGAIN;
+    }
+    std::advance(beg, r);
+    done += r;
+    attempts = 16;
+    delay = 125;
+  }
+  ceph_assert(aios_size >= done);
+  return done;
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  int events;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> l(d->cq_mutex);
+      events = ioring_get_cqe(d.get(), max, paio);
+    }
+    if (events) {
+      break;
+    }
+    struct epoll_event ev;
+    int ret = TEMP_FAILURE_RETRY(epoll_wait(d->epoll_fd, &ev, 1, timeout_ms));
+    if (ret < 0) {
+      events = -errno;
+      break;
+    }
+    if (ret == 0) {
+      // timed out
+      break;
+    }
+    // time to reap
+  }
+
+  return events;
+}
+
+bool ioring_queue_t::supported()
+{
+  struct io_uring ring;
+  int ret = io_uring_queue_init(16, &ring, 0);
+  if (ret) {
+    return false;
+  }
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+#else // #if defined(HAVE_LIBURING)
+
+struct ioring_data {};
+
+ioring_queue_t::ioring_queue_t(unsigned iodepth_, bool sq_thread_)
+{
+  ceph_abort();
+}
+
+ioring_queue_t::~ioring_queue_t()
+{
+  ceph_abort();
+}
+
+int ioring_queue_t::init(std::vector<int> &fds)
+{
+  ceph_abort();
+}
+
+void ioring_queue_t::shutdown()
+{
+  ceph_abort();
+}
+
+int ioring_queue_t::submit_batch(aio_iter beg, aio_iter end,
+				 uint16_t aios_size, void *priv,
+				 int *retries)
+{
+  ceph_abort();
+}
+
+int ioring_queue_t::get_next_completed(int timeout_ms, aio_t **paio, int max)
+{
+  ceph_abort();
+}
+
+bool ioring_queue_t::supported()
+{
+  return false;
+}
+
+#endif // #if defined(HAVE_LIBURING)
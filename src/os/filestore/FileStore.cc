@@ -3144,6 +3144,15 @@ void FileStore::_do_transaction(
       }
       break;
 
+    case Transaction::OP_COLL_REMOVE_RANGE:
+      {
+        const coll_t &cid = i.get_cid(op->cid);
+        const ghobject_t &first = i.get_oid(op->oid);
+        const ghobject_t &end = i.get_oid(op->dest_oid);
+        r = _remove_range(cid, first, end, spos);
+      }
+      break;
+
     case Transaction::OP_MERGE_COLLECTION:
       {
         coll_t cid = i.get_cid(op->cid);
@@ -3586,6 +3595,32 @@ int FileStore::_remove(const coll_t& cid, const ghobject_t& oid,
   return r;
 }
 
+int FileStore::_remove_range(const coll_t& cid, const ghobject_t& first,
+			     const ghobject_t& end,
+			     const SequencerPosition &spos)
+{
+  dout(15) << __FUNC__ << ": " << cid << " " << first << " to " << end
+	   << dendl;
+  vector<ghobject_t> ls;
+  int r = collection_list(cid, first, end, INT_MAX, &ls, nullptr);
+  for (auto& oid : ls) {
+    if (r < 0)
+      break;
+    if (oid.is_pgmeta())
+      continue;
+    const coll_t &c = !_need_temp_object_collection(cid, oid) ?
+      cid : cid.get_temp();
+    if (_check_replay_guard(c, oid, spos) > 0) {
+      r = _remove(c, oid, spos);
+      if (r == -ENOENT)
+	r = 0;
+    }
+  }
+  dout(10) << __FUNC__ << ": " << cid << " " << first << " to " << end
+	   << " = " << r << dendl;
+  return r;
+}
+
 int FileStore::_truncate(const coll_t& cid, const ghobject_t& oid, uint64_t size)
 {
   dout(15) << __FUNC__ << ": " << cid << "/" << oid << " size " << size << dendl;
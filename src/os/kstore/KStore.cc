@@ -2253,6 +2253,14 @@ void KStore::_txc_add_transaction(TransContext *txc, Transaction *t)
       }
       break;
 
+    case Transaction::OP_COLL_REMOVE_RANGE:
+      {
+	r = _remove_range(txc, c, i.get_oid(op->oid), i.get_oid(op->dest_oid));
+	if (!r)
+	  continue;
+      }
+      break;
+
     case Transaction::OP_COLL_HINT:
       {
         uint32_t type = op->hint_type;
@@ -2881,6 +2889,32 @@ int KStore::_remove(TransContext *txc,
   return r;
 }
 
+int KStore::_remove_range(TransContext *txc,
+			  CollectionRef& c,
+			  const ghobject_t& first,
+			  const ghobject_t& end)
+{
+  dout(15) << __func__ << " " << c->cid << " " << first << " to " << end
+	   << dendl;
+  RWLock::WLocker l(c->lock);
+  vector<ghobject_t> ls;
+  ghobject_t next;
+  int r = _collection_list(c.get(), first, end, INT_MAX, &ls, &next);
+  for (auto& oid : ls) {
+    if (r < 0)
+      break;
+    if (oid.is_pgmeta())
+      continue;
+    OnodeRef o = c->get_onode(oid, false);
+    if (!o || !o->exists)
+      continue;
+    r = _do_remove(txc, o);
+  }
+  dout(10) << __func__ << " " << c->cid << " " << first << " to " << end
+	   << " = " << r << dendl;
+  return r;
+}
+
 int KStore::_setattr(TransContext *txc,
 		     CollectionRef& c,
 		     OnodeRef& o,
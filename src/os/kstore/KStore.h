@@ -601,6 +601,10 @@ private:
   int _remove(TransContext *txc,
 	      CollectionRef& c,
 	      OnodeRef& o);
+  int _remove_range(TransContext *txc,
+		    CollectionRef& c,
+		    const ghobject_t& first,
+		    const ghobject_t& end);
   int _do_remove(TransContext *txc,
 		 OnodeRef o);
   int _setattr(TransContext *txc,
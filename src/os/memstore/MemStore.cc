@@ -949,6 +949,15 @@ void MemStore::_do_transaction(Transaction& t)
       }
       break;
 
+    case Transaction::OP_COLL_REMOVE_RANGE:
+      {
+        coll_t cid = i.get_cid(op->cid);
+        ghobject_t first = i.get_oid(op->oid);
+        ghobject_t end = i.get_oid(op->dest_oid);
+	r = _remove_range(cid, first, end);
+      }
+      break;
+
     case Transaction::OP_SETALLOCHINT:
       {
         r = 0;
@@ -1085,6 +1094,29 @@ int MemStore::_remove(const coll_t& cid, const ghobject_t& oid)
   return 0;
 }
 
+int MemStore::_remove_range(const coll_t& cid, const ghobject_t& first,
+			    const ghobject_t& end)
+{
+  dout(10) << __func__ << " " << cid << " " << first << " to " << end
+	   << dendl;
+  CollectionRef c = get_collection(cid);
+  if (!c)
+    return -ENOENT;
+  RWLock::WLocker l(c->lock);
+
+  auto p = c->object_map.lower_bound(first);
+  while (p != c->object_map.end() && p->first < end) {
+    if (p->first.is_pgmeta()) {
+      ++p;
+      continue;
+    }
+    used_bytes -= p->second->get_size();
+    c->object_hash.erase(p->first);
+    p = c->object_map.erase(p);
+  }
+  return 0;
+}
+
 int MemStore::_setattrs(const coll_t& cid, const ghobject_t& oid,
 			map<string,bufferptr>& aset)
 {
@@ -211,6 +211,8 @@ private:
   int _zero(const coll_t& cid, const ghobject_t& oid, uint64_t offset, size_t len);
   int _truncate(const coll_t& cid, const ghobject_t& oid, uint64_t size);
   int _remove(const coll_t& cid, const ghobject_t& oid);
+  int _remove_range(const coll_t& cid, const ghobject_t& first,
+		    const ghobject_t& end);
   int _setattrs(const coll_t& cid, const ghobject_t& oid, map<string,bufferptr>& aset);
   int _rmattr(const coll_t& cid, const ghobject_t& oid, const char *name);
   int _rmattrs(const coll_t& cid, const ghobject_t& oid);
@@ -90,6 +90,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::read_request_t &rhs)
   return lhs << "read_request_t(to_read=[" << rhs.to_read << "]"
 	     << ", need=" << rhs.need
 	     << ", want_attrs=" << rhs.want_attrs
+	     << ", shard_extents=" << rhs.shard_extents
 	     << ")";
 }
 
@@ -102,7 +103,8 @@ ostream &operator<<(ostream &lhs, const ECBackend::read_result_t &rhs)
   } else {
     lhs << ", noattrs";
   }
-  return lhs << ", returned=" << rhs.returned << ")";
+  return lhs << ", returned=" << rhs.returned
+	     << ", partial_returned=" << rhs.partial_returned << ")";
 }
 
 ostream &operator<<(ostream &lhs, const ECBackend::ReadOp &rhs)
@@ -155,6 +157,7 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
       << " plan.will_write=" << rhs.plan.will_write
+      << " plan.delta_write=" << rhs.plan.delta_write
       << ")";
   return lhs;
 }
@@ -1144,6 +1147,18 @@ void ECBackend::handle_sub_read_reply(
       dout(20) << __func__ << " to_read skipping" << dendl;
       continue;
     }
+    if (!rop.to_read.find(i->first)->second.shard_extents.empty()) {
+      // partial read: each shard returns its own ranges, and a retry
+      // replaces what an earlier round returned
+      extent_map &got = rop.complete[i->first].partial_returned[from];
+      got.clear();
+      for (auto &&j : i->second) {
+	if (j.second.length()) {
+	  got.insert(j.first, j.second.length(), j.second);
+	}
+      }
+      continue;
+    }
     list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator req_iter =
       rop.to_read.find(i->first)->second.to_read.begin();
     list<
@@ -1201,12 +1216,19 @@ void ECBackend::handle_sub_read_reply(
       iter != rop.complete.end();
       ++iter) {
       set<int> have;
-      for (map<pg_shard_t, bufferlist>::const_iterator j =
-          iter->second.returned.front().get<2>().begin();
-        j != iter->second.returned.front().get<2>().end();
-        ++j) {
-        have.insert(j->first.shard);
-        dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
+      if (iter->second.returned.empty()) {
+	for (auto &&j : iter->second.partial_returned) {
+	  have.insert(j.first.shard);
+	  dout(20) << __func__ << " have shard=" << j.first.shard << dendl;
+	}
+      } else {
+	for (map<pg_shard_t, bufferlist>::const_iterator j =
+	       iter->second.returned.front().get<2>().begin();
+	     j != iter->second.returned.front().get<2>().end();
+	     ++j) {
+	  have.insert(j->first.shard);
+	  dout(20) << __func__ << " have shard=" << j->first.shard << dendl;
+	}
       }
       map<int, vector<pair<int, int>>> dummy_minimum;
       int err;
@@ -1692,6 +1714,19 @@ void ECBackend::do_read_op(ReadOp &op)
       op.obj_to_source[i->first].insert(j->first);
       op.source_to_obj[j->first].insert(i->first);
     }
+    if (!i->second.shard_extents.empty()) {
+      ceph_assert(!i->second.to_read.empty());
+      uint32_t flags = i->second.to_read.front().get<2>();
+      for (auto &&k : i->second.shard_extents) {
+	ceph_assert(i->second.need.count(k.first));
+	auto &l = messages[k.first].to_read[i->first];
+	for (auto e = k.second.begin(); e != k.second.end(); ++e) {
+	  l.push_back(boost::make_tuple(e.get_start(), e.get_len(), flags));
+	}
+      }
+      ceph_assert(!need_attrs);
+      continue;
+    }
     for (list<boost::tuple<uint64_t, uint64_t, uint32_t> >::const_iterator j =
 	   i->second.to_read.begin();
 	 j != i->second.to_read.end();
@@ -1801,6 +1836,16 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
 {
   ceph_assert(op);
 
+  // plugins which remap chunks would need the mapping applied to the
+  // delta, keep them on the full read-modify-write path
+  unsigned parity_chunks = 0;
+  if (cct->_conf->osd_ec_parity_delta_writes &&
+      get_parent()->get_pool().allows_ecoverwrites() &&
+      ec_impl->supports_parity_delta() &&
+      ec_impl->get_chunk_mapping().empty()) {
+    parity_chunks = ec_impl->get_coding_chunk_count();
+  }
+
   op->plan = ECTransaction::get_write_plan(
     sinfo,
     std::move(t),
@@ -1815,7 +1860,8 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
       }
       return ref;
     },
-    get_parent()->get_dpp());
+    get_parent()->get_dpp(),
+    parity_chunks);
 
   dout(10) << __func__ << ": " << *op << dendl;
 
@@ -1823,6 +1869,190 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
   check_ops();
 }
 
+void ECBackend::try_parity_delta(Op *op)
+{
+  if (op->plan.overwrite_bytes) {
+    get_parent()->get_logger()->inc(
+      l_osd_ec_overwrite_bytes, op->plan.overwrite_bytes);
+  }
+  for (auto &&i: op->plan.delta_candidates) {
+    const hobject_t &hoid = i.first;
+    // the old chunks are read from the shards, which must not have
+    // writes to this object in flight
+    auto in_flight = [&hoid](const op_list &ops) {
+      for (auto &&o: ops) {
+	if (o.plan.will_write.count(hoid) || o.plan.to_read.count(hoid))
+	  return true;
+      }
+      return false;
+    };
+    if (in_flight(waiting_reads) || in_flight(waiting_commit)) {
+      dout(20) << __func__ << ": " << hoid
+	       << " has writes in flight, full rmw" << dendl;
+      continue;
+    }
+
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    set<pg_shard_t> error_shards;
+    get_all_avail_shards(hoid, error_shards, have, shards, false);
+    set<int> want = ECTransaction::get_delta_chunks(sinfo, i.second);
+    for (unsigned j = ec_impl->get_data_chunk_count();
+	 j < ec_impl->get_chunk_count();
+	 ++j) {
+      want.insert(j);
+    }
+    if (!std::includes(have.begin(), have.end(), want.begin(), want.end())) {
+      dout(20) << __func__ << ": " << hoid << " needs shards " << want
+	       << " but only " << have << " are available, full rmw" << dendl;
+      continue;
+    }
+
+    dout(20) << __func__ << ": " << hoid << " parity delta for "
+	     << i.second << dendl;
+    op->plan.to_read.erase(hoid);
+    op->plan.will_write[hoid] = i.second;
+    op->plan.delta_write[hoid] = i.second;
+  }
+  op->plan.delta_candidates.clear();
+
+  if (!op->plan.delta_write.empty()) {
+    get_parent()->get_logger()->inc(
+      l_osd_ec_parity_delta, op->plan.delta_write.size());
+  }
+  if (!op->plan.to_read.empty()) {
+    get_parent()->get_logger()->inc(
+      l_osd_ec_full_rmw, op->plan.to_read.size());
+  }
+}
+
+struct OnDeltaReadComplete :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ceph_tid_t tid;
+  hobject_t hoid;
+  OnDeltaReadComplete(ECBackend *ec, ceph_tid_t tid, const hobject_t &hoid)
+    : ec(ec), tid(tid), hoid(hoid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->handle_delta_read(tid, hoid, in.second);
+  }
+};
+
+void ECBackend::start_delta_read(Op *op)
+{
+  map<hobject_t, set<int>> obj_want_to_read;
+  map<hobject_t, read_request_t> for_read_op;
+  uint64_t read_bytes = 0;
+  vector<pair<int, int>> subchunks;
+  subchunks.push_back(make_pair(0, ec_impl->get_sub_chunk_count()));
+  for (auto &&i: op->plan.delta_write) {
+    set<int> want = ECTransaction::get_delta_chunks(sinfo, i.second);
+    for (unsigned j = ec_impl->get_data_chunk_count();
+	 j < ec_impl->get_chunk_count();
+	 ++j) {
+      want.insert(j);
+    }
+
+    set<int> have;
+    map<shard_id_t, pg_shard_t> shards;
+    set<pg_shard_t> error_shards;
+    get_all_avail_shards(i.first, error_shards, have, shards, false);
+    map<pg_shard_t, vector<pair<int, int>>> need;
+    for (auto &&c: want) {
+      ceph_assert(shards.count(shard_id_t(c)));
+      need[shards[shard_id_t(c)]] = subchunks;
+    }
+
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+    uint64_t stripes = 0;
+    extent_set bounds;
+    for (auto extent = i.second.begin(); extent != i.second.end(); ++extent) {
+      auto b = sinfo.offset_len_to_stripe_bounds(
+	make_pair(extent.get_start(), extent.get_len()));
+      bounds.union_insert(b.first, b.second);
+    }
+    for (auto extent = bounds.begin(); extent != bounds.end(); ++extent) {
+      to_read.push_back(
+	boost::make_tuple(extent.get_start(), extent.get_len(), 0));
+      stripes += extent.get_len() / sinfo.get_stripe_width();
+    }
+    read_bytes += stripes * want.size() * sinfo.get_chunk_size();
+
+    for_read_op.insert(
+      make_pair(
+	i.first,
+	read_request_t(
+	  to_read,
+	  need,
+	  false,
+	  new OnDeltaReadComplete(this, op->tid, i.first))));
+    obj_want_to_read.insert(make_pair(i.first, want));
+  }
+  get_parent()->get_logger()->inc(l_osd_ec_overwrite_read_bytes, read_bytes);
+
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    obj_want_to_read,
+    for_read_op,
+    op->client_op,
+    false, false);
+}
+
+void ECBackend::handle_delta_read(
+  ceph_tid_t tid,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  auto opiter = tid_to_op_map.find(tid);
+  ceph_assert(opiter != tid_to_op_map.end());
+  Op *op = &(opiter->second);
+  if (res.r != 0) {
+    derr << __func__ << ": reading " << hoid << " for a parity delta"
+	 << " failed with " << res.r << " and there is no way to recover"
+	 << " from such an error in this context" << dendl;
+    ceph_abort();
+  }
+
+  auto dwiter = op->plan.delta_write.find(hoid);
+  ceph_assert(dwiter != op->plan.delta_write.end());
+  set<int> want = ECTransaction::get_delta_chunks(sinfo, dwiter->second);
+  for (unsigned j = ec_impl->get_data_chunk_count();
+       j < ec_impl->get_chunk_count();
+       ++j) {
+    want.insert(j);
+  }
+
+  auto &result = op->delta_read_result[hoid];
+  for (auto &&read: res.returned) {
+    pair<uint64_t, uint64_t> chunk_off_len =
+      sinfo.aligned_offset_len_to_chunk(
+	make_pair(read.get<0>(), read.get<1>()));
+    map<int, bufferlist> chunks;
+    for (auto &&j: read.get<2>()) {
+      chunks[j.first.shard].claim(j.second);
+    }
+    // shards which failed to read are rebuilt from the others
+    map<int, bufferlist> decoded;
+    map<int, bufferlist*> out;
+    for (auto &&c: want) {
+      if (!chunks.count(c)) {
+	out[c] = &decoded[c];
+      }
+    }
+    if (!out.empty()) {
+      int r = ECUtil::decode(sinfo, ec_impl, chunks, out);
+      ceph_assert(r == 0);
+    }
+    for (auto &&c: want) {
+      bufferlist &bl = chunks.count(c) ? chunks[c] : decoded[c];
+      ceph_assert(bl.length() == chunk_off_len.second);
+      result[c].insert(chunk_off_len.first, chunk_off_len.second, bl);
+    }
+  }
+  dout(20) << __func__ << ": " << hoid << " read " << want << dendl;
+  check_ops();
+}
+
 bool ECBackend::try_state_to_reads()
 {
   if (waiting_state.empty())
@@ -1847,6 +2077,8 @@ bool ECBackend::try_state_to_reads()
     op->using_cache = pipeline_state.caching_enabled();
   }
 
+  try_parity_delta(op);
+
   waiting_state.pop_front();
   waiting_reads.push_back(*op);
 
@@ -1883,8 +2115,17 @@ bool ECBackend::try_state_to_reads()
 
   dout(10) << __func__ << ": " << *op << dendl;
 
+  if (!op->plan.delta_write.empty()) {
+    start_delta_read(op);
+  }
+
   if (!op->remote_read.empty()) {
     ceph_assert(get_parent()->get_pool().allows_ecoverwrites());
+    uint64_t read_bytes = 0;
+    for (auto &&i: op->remote_read) {
+      read_bytes += i.second.size();
+    }
+    get_parent()->get_logger()->inc(l_osd_ec_overwrite_read_bytes, read_bytes);
     objects_read_async_no_cache(
       op->remote_read,
       [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
@@ -1946,6 +2187,7 @@ bool ECBackend::try_reads_to_commit()
       get_parent()->get_info().pgid.pgid,
       sinfo,
       op->remote_read_result,
+      op->delta_read_result,
       op->log_entries,
       &written,
       &trans,
@@ -1983,6 +2225,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->delta_read_result.clear();
 
   ObjectStore::Transaction empty;
   bool should_write_local = false;
@@ -2131,6 +2374,13 @@ void ECBackend::objects_read_async(
   map<hobject_t,std::list<boost::tuple<uint64_t, uint64_t, uint32_t> > >
     reads;
 
+  bool partial_read = can_read_partial(fast_read);
+  for (auto &&i : to_read) {
+    if (i.first.get<1>() == 0) {
+      partial_read = false;
+    }
+  }
+
   uint32_t flags = 0;
   extent_set es;
   for (list<pair<boost::tuple<uint64_t, uint64_t, uint32_t>,
@@ -2139,8 +2389,10 @@ void ECBackend::objects_read_async(
        i != to_read.end();
        ++i) {
     pair<uint64_t, uint64_t> tmp =
-      sinfo.offset_len_to_stripe_bounds(
-	make_pair(i->first.get<0>(), i->first.get<1>()));
+      make_pair(i->first.get<0>(), i->first.get<1>());
+    if (!partial_read) {
+      tmp = sinfo.offset_len_to_stripe_bounds(tmp);
+    }
 
     es.union_insert(tmp.first, tmp.second);
     flags |= i->first.get<2>();
@@ -2228,6 +2480,7 @@ void ECBackend::objects_read_async(
   objects_read_and_reconstruct(
     reads,
     fast_read,
+    partial_read,
     make_gen_lambda_context<
       map<hobject_t,pair<int, extent_map> > &&, cb>(
 	cb(this,
@@ -2251,10 +2504,14 @@ struct CallClientContexts :
   void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
     ECBackend::read_result_t &res = in.second;
     extent_map result;
+    uint64_t client_bytes = 0, shard_bytes = 0;
+    bool degraded = false;
+    set<int> want;
     if (res.r != 0)
       goto out;
     ceph_assert(res.returned.size() == to_read.size());
     ceph_assert(res.errors.empty());
+    ec->get_want_to_read_shards(&want);
     for (auto &&read: to_read) {
       pair<uint64_t, uint64_t> adjusted =
 	ec->sinfo.offset_len_to_stripe_bounds(
@@ -2267,8 +2524,14 @@ struct CallClientContexts :
 	     res.returned.front().get<2>().begin();
 	   j != res.returned.front().get<2>().end();
 	   ++j) {
+	shard_bytes += j->second.length();
 	to_decode[j->first.shard].claim(j->second);
       }
+      for (auto &&w : want) {
+	if (!to_decode.count(w)) {
+	  degraded = true;
+	}
+      }
       int r = ECUtil::decode(
 	ec->sinfo,
 	ec->ec_impl,
@@ -2284,21 +2547,274 @@ struct CallClientContexts :
 	read.get<0>() - adjusted.first,
 	std::min(read.get<1>(),
 	    bl.length() - (read.get<0>() - adjusted.first)));
+      client_bytes += trimmed.length();
       result.insert(
 	read.get<0>(), trimmed.length(), std::move(trimmed));
       res.returned.pop_front();
     }
+    ec->get_parent()->log_ec_read(client_bytes, shard_bytes, degraded);
 out:
     status->complete_object(hoid, res.r, std::move(result));
     ec->kick_reads();
   }
 };
 
+struct CallClientPartialContexts :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  hobject_t hoid;
+  ECBackend *ec;
+  ECBackend::ClientAsyncReadStatus *status;
+  list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  CallClientPartialContexts(
+    hobject_t hoid,
+    ECBackend *ec,
+    ECBackend::ClientAsyncReadStatus *status,
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read)
+    : hoid(hoid), ec(ec), status(status), to_read(to_read) {}
+
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ECBackend::read_result_t &res = in.second;
+    extent_map result;
+    uint64_t client_bytes = 0, shard_bytes = 0;
+    map<int, extent_map> chunks;
+    map<int, extent_set> wanted;
+    extent_set extents;
+    if (res.r != 0)
+      goto out;
+    ceph_assert(res.errors.empty());
+    for (auto &&i : res.partial_returned) {
+      for (auto &&j : i.second) {
+	shard_bytes += j.get_len();
+      }
+      chunks[i.first.shard] = std::move(i.second);
+    }
+    for (auto &&read : to_read) {
+      extents.union_insert(read.get<0>(), read.get<1>());
+    }
+    ec->get_partial_read_chunks(extents, &wanted);
+    res.r = ECBackend::decode_partial(ec->ec_impl, wanted, &chunks);
+    if (res.r < 0)
+      goto out;
+    client_bytes = ECBackend::assemble_partial(
+      ec->sinfo, ec->ec_impl->get_chunk_mapping(), extents, chunks, &result);
+    ec->get_parent()->log_ec_read(
+      client_bytes, shard_bytes,
+      chunks.size() > res.partial_returned.size());
+out:
+    status->complete_object(hoid, res.r, std::move(result));
+    ec->kick_reads();
+  }
+};
+
+bool ECBackend::can_read_partial(bool fast_read) const
+{
+  return cct->_conf->osd_ec_partial_reads &&
+    !fast_read &&
+    get_parent()->get_pool().allows_ecoverwrites() &&
+    ec_impl->get_sub_chunk_count() == 1 &&
+    ec_impl->supports_parity_delta();
+}
+
+void ECBackend::get_partial_read_chunks(
+  const extent_set &extents,
+  map<int, extent_set> *chunks) const
+{
+  partial_read_chunks(sinfo, ec_impl->get_chunk_mapping(),
+		      get_partial_read_align(), extents, chunks);
+}
+
+bool ECBackend::get_partial_read_shards(
+  const hobject_t &hoid,
+  const extent_set &extents,
+  const set<pg_shard_t> &error_shards,
+  set<int> *want_to_read,
+  map<pg_shard_t, vector<pair<int, int>>> *need,
+  map<pg_shard_t, extent_set> *shard_extents)
+{
+  map<int, extent_set> wanted;
+  get_partial_read_chunks(extents, &wanted);
+  for (auto &&i : wanted) {
+    want_to_read->insert(i.first);
+  }
+
+  set<int> have;
+  map<shard_id_t, pg_shard_t> shards;
+  get_all_avail_shards(hoid, error_shards, have, shards, false);
+
+  map<int, vector<pair<int, int>>> sources;
+  map<int, extent_set> source_extents;
+  int r = plan_partial_read(ec_impl, wanted, have, &sources, &source_extents);
+  if (r < 0) {
+    dout(10) << __func__ << " " << hoid << " cannot read " << *want_to_read
+	     << " from " << have << dendl;
+    return false;
+  }
+  for (auto &&i : sources) {
+    ceph_assert(shards.count(shard_id_t(i.first)));
+    pg_shard_t shard = shards[shard_id_t(i.first)];
+    (*shard_extents)[shard].swap(source_extents[i.first]);
+    need->insert(make_pair(shard, i.second));
+  }
+  dout(20) << __func__ << " " << hoid << " " << extents
+	   << " from " << *shard_extents << dendl;
+  return true;
+}
+
+void ECBackend::partial_read_chunks(
+  const ECUtil::stripe_info_t &sinfo,
+  const vector<int> &chunk_mapping,
+  uint64_t align,
+  const extent_set &extents,
+  map<int, extent_set> *chunks)
+{
+  map<int, extent_set> by_position;
+  for (auto i = extents.begin(); i != extents.end(); ++i) {
+    sinfo.offset_len_to_chunk_extents(
+      make_pair(i.get_start(), i.get_len()),
+      align,
+      &by_position);
+  }
+  for (auto &&p : by_position) {
+    int shard = (int)chunk_mapping.size() > p.first ?
+      chunk_mapping[p.first] : p.first;
+    (*chunks)[shard].swap(p.second);
+  }
+}
+
+int ECBackend::plan_partial_read(
+  const ErasureCodeInterfaceRef &ec_impl,
+  const map<int, extent_set> &wanted,
+  const set<int> &have,
+  map<int, vector<pair<int, int>>> *sources,
+  map<int, extent_set> *shard_extents)
+{
+  set<int> want_to_read;
+  for (auto &&i : wanted) {
+    want_to_read.insert(i.first);
+  }
+  int r = ec_impl->minimum_to_decode(want_to_read, have, sources);
+  if (r < 0) {
+    return r;
+  }
+
+  // the ranges of the chunks which are not read directly are read from
+  // every source and decoded
+  extent_set missing;
+  for (auto &&i : wanted) {
+    if (!sources->count(i.first)) {
+      missing.union_of(i.second);
+    }
+  }
+  for (auto &&i : *sources) {
+    extent_set &es = (*shard_extents)[i.first];
+    es = missing;
+    auto w = wanted.find(i.first);
+    if (w != wanted.end()) {
+      es.union_of(w->second);
+    }
+  }
+  return 0;
+}
+
+int ECBackend::decode_partial(
+  const ErasureCodeInterfaceRef &ec_impl,
+  const map<int, extent_set> &wanted,
+  map<int, extent_map> *chunks)
+{
+  set<int> missing;
+  extent_set ranges;
+  for (auto &&i : wanted) {
+    if (!chunks->count(i.first)) {
+      missing.insert(i.first);
+      ranges.union_of(i.second);
+    }
+  }
+  const unsigned k = ec_impl->get_data_chunk_count();
+  for (auto r = ranges.begin(); r != ranges.end(); ++r) {
+    map<int, bufferlist> in;
+    for (auto &&i : *chunks) {
+      auto range = i.second.get_containing_range(r.get_start(), r.get_len());
+      if (range.first == range.second ||
+	  range.first.get_off() > r.get_start() ||
+	  range.first.get_off() + range.first.get_len() <
+	    r.get_start() + r.get_len()) {
+	// short read, not usable to decode this range
+	continue;
+      }
+      in[i.first].substr_of(
+	range.first.get_val(),
+	r.get_start() - range.first.get_off(),
+	r.get_len());
+    }
+    if (in.size() < k) {
+      return -EIO;
+    }
+    map<int, bufferlist> out;
+    int err = ec_impl->decode(missing, in, &out, r.get_len());
+    if (err < 0) {
+      return err;
+    }
+    for (auto &&m : missing) {
+      ceph_assert(out[m].length() == r.get_len());
+      (*chunks)[m].insert(r.get_start(), r.get_len(), out[m]);
+    }
+  }
+  return 0;
+}
+
+uint64_t ECBackend::assemble_partial(
+  const ECUtil::stripe_info_t &sinfo,
+  const vector<int> &chunk_mapping,
+  const extent_set &extents,
+  map<int, extent_map> &chunks,
+  extent_map *result)
+{
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  uint64_t bytes = 0;
+  for (auto e = extents.begin(); e != extents.end(); ++e) {
+    bufferlist bl;
+    uint64_t off = e.get_start();
+    const uint64_t end = e.get_end();
+    while (off < end) {
+      uint64_t in_stripe = off % stripe_width;
+      uint64_t in_chunk = in_stripe % chunk_size;
+      uint64_t len = std::min(chunk_size - in_chunk, end - off);
+      uint64_t chunk_off = (off / stripe_width) * chunk_size + in_chunk;
+      int i = in_stripe / chunk_size;
+      int shard = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+      auto range = chunks[shard].get_containing_range(chunk_off, len);
+      if (range.first == range.second ||
+	  range.first.get_off() > chunk_off) {
+	break;
+      }
+      uint64_t have = range.first.get_off() + range.first.get_len() -
+	chunk_off;
+      bufferlist piece;
+      piece.substr_of(range.first.get_val(),
+		      chunk_off - range.first.get_off(),
+		      std::min(len, have));
+      bl.claim_append(piece);
+      if (have < len) {
+	// short read past the end of the object
+	break;
+      }
+      off += len;
+    }
+    bytes += bl.length();
+    if (bl.length()) {
+      result->insert(e.get_start(), bl.length(), std::move(bl));
+    }
+  }
+  return bytes;
+}
+
 void ECBackend::objects_read_and_reconstruct(
   const map<hobject_t,
     std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
   > &reads,
   bool fast_read,
+  bool partial_read,
   GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func)
 {
   in_progress_client_reads.emplace_back(
@@ -2314,6 +2830,40 @@ void ECBackend::objects_read_and_reconstruct(
     
   map<hobject_t, read_request_t> for_read_op;
   for (auto &&to_read: reads) {
+    if (partial_read) {
+      extent_set extents;
+      for (auto &&i : to_read.second) {
+	extents.union_insert(i.get<0>(), i.get<1>());
+      }
+      set<int> want;
+      map<pg_shard_t, vector<pair<int, int>>> shards;
+      map<pg_shard_t, extent_set> shard_extents;
+      bool r = get_partial_read_shards(
+	to_read.first,
+	extents,
+	set<pg_shard_t>(),
+	&want,
+	&shards,
+	&shard_extents);
+      ceph_assert(r);
+
+      CallClientPartialContexts *c = new CallClientPartialContexts(
+	to_read.first,
+	this,
+	&(in_progress_client_reads.back()),
+	to_read.second);
+      for_read_op.insert(
+	make_pair(
+	  to_read.first,
+	  read_request_t(
+	    to_read.second,
+	    shards,
+	    false,
+	    c,
+	    shard_extents)));
+      obj_want_to_read.insert(make_pair(to_read.first, want));
+      continue;
+    }
     map<pg_shard_t, vector<pair<int, int>>> shards;
     int r = get_min_avail_to_read_shards(
       to_read.first,
@@ -2353,6 +2903,45 @@ int ECBackend::send_all_remaining_reads(
   const hobject_t &hoid,
   ReadOp &rop)
 {
+  if (!rop.to_read.find(hoid)->second.shard_extents.empty()) {
+    // partial read: plan again without the shards which failed, the
+    // ranges to read from the others may change
+    set<pg_shard_t> error_shards;
+    for (auto &&p : rop.complete[hoid].errors) {
+      error_shards.insert(p.first);
+    }
+    set<int> want;
+    map<pg_shard_t, vector<pair<int, int>>> shards;
+    map<pg_shard_t, extent_set> shard_extents;
+    extent_set extents;
+    for (auto &&i : rop.to_read.find(hoid)->second.to_read) {
+      extents.union_insert(i.get<0>(), i.get<1>());
+    }
+    if (!get_partial_read_shards(hoid, extents, error_shards,
+				 &want, &shards, &shard_extents)) {
+      dout(0) << __func__ << " not enough shards left to try for " << hoid
+	      << " read result was " << rop.complete[hoid] << dendl;
+      return -EIO;
+    }
+    dout(10) << __func__ << " partial read from " << shard_extents << dendl;
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets =
+      rop.to_read.find(hoid)->second.to_read;
+    GenContext<pair<RecoveryMessages *, read_result_t& > &> *c =
+      rop.to_read.find(hoid)->second.cb;
+    rop.complete[hoid].partial_returned.clear();
+    rop.to_read.erase(hoid);
+    rop.to_read.insert(make_pair(
+	hoid,
+	read_request_t(
+	  offsets,
+	  shards,
+	  false,
+	  c,
+	  shard_extents)));
+    do_read_op(rop);
+    return 0;
+  }
+
   set<int> already_read;
   const set<pg_shard_t>& ots = rop.obj_to_source[hoid];
   for (set<pg_shard_t>::iterator i = ots.begin(); i != ots.end(); ++i)
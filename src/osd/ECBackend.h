@@ -140,9 +140,67 @@ public:
     const map<hobject_t, std::list<boost::tuple<uint64_t, uint64_t, uint32_t> >
     > &reads,
     bool fast_read,
+    bool partial_read,
     GenContextURef<map<hobject_t,pair<int, extent_map> > &&> &&func);
 
+  /**
+   * Partial reads
+   *
+   * With partial_read, the extents passed to objects_read_and_reconstruct
+   * need not be stripe aligned.  Each shard is asked only for the chunk
+   * ranges backing the requested bytes (see get_partial_read_shards) and
+   * CallClientPartialContexts assembles the result.  If a data shard is
+   * unavailable, the sources read its ranges as well and only those are
+   * decoded, which requires a plugin where each byte of a coding chunk
+   * only depends on the same byte of the data chunks (see
+   * ErasureCodeInterface::supports_parity_delta).
+   */
+  bool can_read_partial(bool fast_read) const;
+  uint64_t get_partial_read_align() const {
+    return sinfo.get_chunk_size() % CEPH_PAGE_SIZE ?
+      sinfo.get_chunk_size() : CEPH_PAGE_SIZE;
+  }
+  void get_partial_read_chunks(
+    const extent_set &extents,
+    map<int, extent_set> *chunks) const;
+  bool get_partial_read_shards(
+    const hobject_t &hoid,
+    const extent_set &extents,
+    const set<pg_shard_t> &error_shards,
+    set<int> *want_to_read,
+    map<pg_shard_t, vector<pair<int, int>>> *need,
+    map<pg_shard_t, extent_set> *shard_extents);
+
+  // the parts of a partial read which do not need a backend
+  static void partial_read_chunks(
+    const ECUtil::stripe_info_t &sinfo,
+    const vector<int> &chunk_mapping,
+    uint64_t align,
+    const extent_set &extents,
+    map<int, extent_set> *chunks);
+  /// pick the shards to read from have, and the chunk ranges each reads
+  static int plan_partial_read(
+    const ErasureCodeInterfaceRef &ec_impl,
+    const map<int, extent_set> &wanted,
+    const set<int> &have,
+    map<int, vector<pair<int, int>>> *sources,
+    map<int, extent_set> *shard_extents);
+  /// decode the ranges of the wanted chunks which were not read
+  static int decode_partial(
+    const ErasureCodeInterfaceRef &ec_impl,
+    const map<int, extent_set> &wanted,
+    map<int, extent_map> *chunks);
+  /// assemble extents from the chunk ranges, up to the first short read;
+  /// return the number of bytes assembled
+  static uint64_t assemble_partial(
+    const ECUtil::stripe_info_t &sinfo,
+    const vector<int> &chunk_mapping,
+    const extent_set &extents,
+    map<int, extent_map> &chunks,
+    extent_map *result);
+
   friend struct CallClientContexts;
+  friend struct CallClientPartialContexts;
   struct ClientAsyncReadStatus {
     unsigned objects_to_read;
     GenContextURef<map<hobject_t,pair<int, extent_map> > &&> func;
@@ -189,6 +247,7 @@ public:
     objects_read_and_reconstruct(
       _to_read,
       false,
+      false,
       make_gen_lambda_context<
       map<hobject_t,pair<int, extent_map> > &&, Func>(
 	  std::forward<Func>(on_complete)));
@@ -347,6 +406,8 @@ public:
     list<
       boost::tuple<
 	uint64_t, uint64_t, map<pg_shard_t, bufferlist> > > returned;
+    /// chunk ranges returned by each shard, for partial reads
+    map<pg_shard_t, extent_map> partial_returned;
     read_result_t() : r(0) {}
   };
   struct read_request_t {
@@ -354,13 +415,18 @@ public:
     const map<pg_shard_t, vector<pair<int, int>>> need;
     const bool want_attrs;
     GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb;
+    /// if not empty, the chunk ranges to read from each shard in need
+    /// instead of the whole stripes covering to_read
+    const map<pg_shard_t, extent_set> shard_extents;
     read_request_t(
       const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
       const map<pg_shard_t, vector<pair<int, int>>> &need,
       bool want_attrs,
-      GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb)
+      GenContext<pair<RecoveryMessages *, read_result_t& > &> *cb,
+      const map<pg_shard_t, extent_set> &shard_extents =
+        map<pg_shard_t, extent_set>())
       : to_read(to_read), need(need), want_attrs(want_attrs),
-	cb(cb) {}
+	cb(cb), shard_extents(shard_extents) {}
   };
   friend ostream &operator<<(ostream &lhs, const read_request_t &rhs);
 
@@ -402,6 +468,10 @@ public:
 	to_read(std::move(_to_read)) {
       for (auto &&hpair: to_read) {
 	auto &returned = complete[hpair.first].returned;
+	if (!hpair.second.shard_extents.empty()) {
+	  // filled in per shard, see partial_returned
+	  continue;
+	}
 	for (auto &&extent: hpair.second.to_read) {
 	  returned.push_back(
 	    boost::make_tuple(
@@ -474,7 +544,9 @@ public:
     set<hobject_t> temp_cleared;
 
     ECTransaction::WritePlan plan;
-    bool requires_rmw() const { return !plan.to_read.empty(); }
+    bool requires_rmw() const {
+      return !plan.to_read.empty() || !plan.delta_write.empty();
+    }
     bool invalidates_cache() const { return plan.invalidates_cache; }
 
     // must be true if requires_rmw(), must be false if invalidates_cache()
@@ -484,8 +556,11 @@ public:
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+    // old chunks (data and parity) read for plan.delta_write, by chunk
+    map<hobject_t,map<int,extent_map>> delta_read_result;
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return (!remote_read.empty() && remote_read_result.empty()) ||
+	delta_read_result.size() < plan.delta_write.size();
     }
 
     /// In progress write state.
@@ -564,6 +639,13 @@ public:
   eversion_t completed_to;
   eversion_t committed_to;
   void start_rmw(Op *op, PGTransactionUPtr &&t);
+  void try_parity_delta(Op *op);
+  void start_delta_read(Op *op);
+  friend struct OnDeltaReadComplete;
+  void handle_delta_read(
+    ceph_tid_t tid,
+    const hobject_t &hoid,
+    read_result_t &res);
   bool try_state_to_reads();
   bool try_reads_to_commit();
   bool try_finish_rmw();
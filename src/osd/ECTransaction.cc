@@ -81,6 +81,175 @@ void encode_and_write(
   }
 }
 
+static bufferlist get_old_chunk(
+  const map<int, extent_map> &old_chunks,
+  int chunk,
+  uint64_t off,
+  uint64_t len)
+{
+  auto iter = old_chunks.find(chunk);
+  ceph_assert(iter != old_chunks.end());
+  auto found = iter->second.intersect(off, len);
+  ceph_assert(!found.empty());
+  ceph_assert(found.begin().get_off() == off);
+  ceph_assert(found.begin().get_len() == len);
+  return found.begin().get_val();
+}
+
+void delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const extent_map &updates,
+  const map<int, extent_map> &old_chunks,
+  uint32_t flags,
+  pg_log_entry_t *entry,
+  extent_map &written,
+  vector<pair<uint64_t, uint64_t> > &rollback_extents,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const int k = ecimpl->get_data_chunk_count();
+  const int n = ecimpl->get_chunk_count();
+
+  extent_set stripes;
+  for (auto &&extent : updates) {
+    auto bounds = sinfo.offset_len_to_stripe_bounds(
+      make_pair(extent.get_off(), extent.get_len()));
+    stripes.union_insert(bounds.first, bounds.second);
+  }
+
+  for (auto stripe = stripes.begin(); stripe != stripes.end(); ++stripe) {
+    if (entry) {
+      uint64_t restore_from = sinfo.aligned_logical_offset_to_chunk_offset(
+	stripe.get_start());
+      uint64_t restore_len = sinfo.aligned_logical_offset_to_chunk_offset(
+	stripe.get_len());
+      ldpp_dout(dpp, 20) << __func__ << ": overwriting "
+			 << restore_from << "~" << restore_len
+			 << dendl;
+      if (rollback_extents.empty()) {
+	for (auto &&st : *transactions) {
+	  st.second.touch(
+	    coll_t(spg_t(pgid, st.first)),
+	    ghobject_t(oid, entry->version.version, st.first));
+	}
+      }
+      rollback_extents.emplace_back(make_pair(restore_from, restore_len));
+      for (auto &&st : *transactions) {
+	st.second.clone_range(
+	  coll_t(spg_t(pgid, st.first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	  ghobject_t(oid, entry->version.version, st.first),
+	  restore_from,
+	  restore_len,
+	  restore_from);
+      }
+    }
+
+    for (uint64_t off = stripe.get_start();
+	 off < stripe.get_end();
+	 off += stripe_width) {
+      uint64_t chunk_off = sinfo.aligned_logical_offset_to_chunk_offset(off);
+      map<int, bufferlist> delta;
+      for (int i = 0; i < k; ++i) {
+	auto overlap = updates.intersect(off + i * chunk_size, chunk_size);
+	if (overlap.empty())
+	  continue;
+	bufferlist old = get_old_chunk(old_chunks, i, chunk_off, chunk_size);
+	const char *old_data = old.c_str();
+	bufferptr d(buffer::create(chunk_size));
+	d.zero();
+	auto st = transactions->find(shard_id_t(i));
+	for (auto &&extent : overlap) {
+	  uint64_t in_chunk = extent.get_off() - (off + i * chunk_size);
+	  bufferlist bl = extent.get_val();
+	  const char *new_data = bl.c_str();
+	  for (uint64_t j = 0; j < extent.get_len(); ++j) {
+	    d[in_chunk + j] = old_data[in_chunk + j] ^ new_data[j];
+	  }
+	  if (st != transactions->end()) {
+	    st->second.write(
+	      coll_t(spg_t(pgid, st->first)),
+	      ghobject_t(oid, ghobject_t::NO_GEN, st->first),
+	      chunk_off + in_chunk,
+	      bl.length(),
+	      bl,
+	      flags);
+	  }
+	}
+	delta[i].push_back(std::move(d));
+      }
+      if (delta.empty())
+	continue;
+
+      map<int, bufferlist> parity;
+      for (int i = k; i < n; ++i) {
+	parity[i] = get_old_chunk(old_chunks, i, chunk_off, chunk_size);
+      }
+      int r = ecimpl->apply_parity_delta(delta, &parity);
+      ceph_assert(r == 0);
+      ldpp_dout(dpp, 20) << __func__ << ": " << oid
+			 << " stripe " << off
+			 << " data chunks " << delta.size()
+			 << dendl;
+      for (auto &&i : parity) {
+	auto st = transactions->find(shard_id_t(i.first));
+	if (st == transactions->end())
+	  continue;
+	st->second.write(
+	  coll_t(spg_t(pgid, st->first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, st->first),
+	  chunk_off,
+	  i.second.length(),
+	  i.second,
+	  flags);
+      }
+    }
+  }
+
+  for (auto &&extent : updates) {
+    written.insert(extent.get_off(), extent.get_len(), extent.get_val());
+  }
+}
+
+set<int> ECTransaction::get_delta_chunks(
+  const ECUtil::stripe_info_t &sinfo,
+  const extent_set &raw_write_set)
+{
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  set<int> chunks;
+  for (auto extent = raw_write_set.begin();
+       extent != raw_write_set.end();
+       ++extent) {
+    uint64_t end = extent.get_end();
+    for (uint64_t off = extent.get_start();
+	 off < end && chunks.size() < stripe_width / chunk_size;
+	 off = (off / chunk_size + 1) * chunk_size) {
+      chunks.insert((off % stripe_width) / chunk_size);
+    }
+  }
+  return chunks;
+}
+
+uint64_t ECTransaction::get_delta_stripes(
+  const ECUtil::stripe_info_t &sinfo,
+  const extent_set &raw_write_set)
+{
+  extent_set stripes;
+  for (auto extent = raw_write_set.begin();
+       extent != raw_write_set.end();
+       ++extent) {
+    auto bounds = sinfo.offset_len_to_stripe_bounds(
+      make_pair(extent.get_start(), extent.get_len()));
+    stripes.union_insert(bounds.first, bounds.second);
+  }
+  return stripes.size() / sinfo.get_stripe_width();
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -100,6 +269,7 @@ void ECTransaction::generate_transactions(
   pg_t pgid,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,extent_map>> &delta_extents,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -459,6 +629,52 @@ void ECTransaction::generate_transactions(
 	}
       }
 
+      auto delta_iter = plan.delta_write.find(oid);
+      if (delta_iter != plan.delta_write.end()) {
+	auto old_iter = delta_extents.find(oid);
+	ceph_assert(old_iter != delta_extents.end());
+	ceph_assert(rollback_extents.empty());
+	uint32_t flags = 0;
+	extent_map updates;
+	for (auto &&extent: op.buffer_updates) {
+	  using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+	  bufferlist bl;
+	  match(
+	    extent.get_val(),
+	    [&](const BufferUpdate::Write &op) {
+	      bl = op.buffer;
+	      flags |= op.fadvise_flags;
+	    },
+	    [&](const BufferUpdate::Zero &) {
+	      bl.append_zero(extent.get_len());
+	    },
+	    [&](const BufferUpdate::CloneRange &) {
+	      ceph_assert(
+		0 ==
+		"CloneRange is not allowed, do_op should have returned ENOTSUPP");
+	    });
+	  ceph_assert(extent.get_off() + extent.get_len() <= orig_size);
+	  updates.insert(extent.get_off(), extent.get_len(), bl);
+	}
+	ldpp_dout(dpp, 20) << __func__ << ": parity delta for "
+			   << delta_iter->second
+			   << dendl;
+	delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  updates,
+	  old_iter->second,
+	  flags,
+	  entry,
+	  written,
+	  rollback_extents,
+	  transactions,
+	  dpp);
+	op.buffer_updates.clear();
+      }
+
       uint32_t fadvise_flags = 0;
       for (auto &&extent: op.buffer_updates) {
 	using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
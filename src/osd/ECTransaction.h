@@ -29,6 +29,14 @@ namespace ECTransaction {
     map<hobject_t,extent_set> to_read;
     map<hobject_t,extent_set> will_write; // superset of to_read
 
+    // partial overwrites which may skip the read-modify-write and
+    // update the parity with a delta instead, client extents
+    map<hobject_t,extent_set> delta_candidates;
+    // objects actually written with a parity delta, client extents
+    map<hobject_t,extent_set> delta_write;
+    // client bytes written by partial overwrites
+    uint64_t overwrite_bytes = 0;
+
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
   };
 
@@ -36,12 +44,23 @@ namespace ECTransaction {
     uint64_t prev_size,
     const PGTransaction::ObjectOperation &op);
 
+  /// data chunks touched by the client extents in any stripe
+  set<int> get_delta_chunks(
+    const ECUtil::stripe_info_t &sinfo,
+    const extent_set &raw_write_set);
+
+  /// number of stripes touched by the client extents
+  uint64_t get_delta_stripes(
+    const ECUtil::stripe_info_t &sinfo,
+    const extent_set &raw_write_set);
+
   template <typename F>
   WritePlan get_write_plan(
     const ECUtil::stripe_info_t &sinfo,
     PGTransactionUPtr &&t,
     F &&get_hinfo,
-    DoutPrefixProvider *dpp) {
+    DoutPrefixProvider *dpp,
+    unsigned parity_chunks = 0) {
     WritePlan plan;
     t->safe_create_traverse(
       [&](pair<const hobject_t, PGTransaction::ObjectOperation> &i) {
@@ -162,6 +181,34 @@ namespace ECTransaction {
 	  projected_size = truncating_to;
 	}
 
+	auto to_read_iter = plan.to_read.find(i.first);
+	if (to_read_iter != plan.to_read.end()) {
+	  plan.overwrite_bytes += raw_write_set.size();
+	}
+
+	/* A partial overwrite which fits within the object can instead
+	 * read back the old content of the chunks it touches together
+	 * with the parity, and update the parity with the difference.
+	 * Only worth it if that reads less than the stripes would. */
+	if (parity_chunks &&
+	    to_read_iter != plan.to_read.end() &&
+	    i.second.is_none() &&
+	    !i.second.truncate &&
+	    !raw_write_set.empty() &&
+	    raw_write_set.range_end() <= orig_size) {
+	  uint64_t delta_read =
+	    get_delta_stripes(sinfo, raw_write_set) *
+	    (get_delta_chunks(sinfo, raw_write_set).size() + parity_chunks) *
+	    sinfo.get_chunk_size();
+	  if (delta_read < (uint64_t)to_read_iter->second.size()) {
+	    ldpp_dout(dpp, 20) << __func__ << ": parity delta candidate, "
+			       << delta_read << " bytes to read instead of "
+			       << to_read_iter->second.size()
+			       << dendl;
+	    plan.delta_candidates[i.first] = raw_write_set;
+	  }
+	}
+
 	ldpp_dout(dpp, 20) << __func__ << ": " << i.first
 			   << " projected size "
 			   << projected_size
@@ -188,6 +235,7 @@ namespace ECTransaction {
     pg_t pgid,
     const ECUtil::stripe_info_t &sinfo,
     const map<hobject_t,extent_map> &partial_extents,
+    const map<hobject_t,map<int,extent_map>> &delta_extents,
     vector<pg_log_entry_t> &entries,
     map<hobject_t,extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -6,6 +6,34 @@
 
 using namespace std;
 
+void ECUtil::stripe_info_t::offset_len_to_chunk_extents(
+  pair<uint64_t, uint64_t> in,
+  uint64_t align,
+  map<int, interval_set<uint64_t> > *out) const
+{
+  ceph_assert(align && chunk_size % align == 0);
+  uint64_t off = in.first;
+  const uint64_t end = in.first + in.second;
+  while (off < end) {
+    uint64_t in_stripe = off % stripe_width;
+    uint64_t in_chunk = in_stripe % chunk_size;
+    uint64_t len = std::min(chunk_size - in_chunk, end - off);
+    uint64_t chunk_off = (off / stripe_width) * chunk_size + in_chunk;
+    uint64_t start = chunk_off - (chunk_off % align);
+    uint64_t stop = ((chunk_off + len + align - 1) / align) * align;
+    auto &es = (*out)[in_stripe / chunk_size];
+    // pieces of one chunk come in ascending order, so widening can only
+    // overlap the last range
+    if (!es.empty() && es.range_end() > start) {
+      start = es.range_end();
+    }
+    if (start < stop) {
+      es.insert(start, stop - start);
+    }
+    off += len;
+  }
+}
+
 int ECUtil::decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
@@ -20,6 +20,7 @@
 #include "include/buffer_fwd.h"
 #include "include/ceph_assert.h"
 #include "include/encoding.h"
+#include "include/interval_set.h"
 #include "common/Formatter.h"
 
 namespace ECUtil {
@@ -77,6 +78,12 @@ public:
       (in.first - off) + in.second);
     return std::make_pair(off, len);
   }
+  /// chunk ranges backing a logical range, keyed by data chunk position
+  /// in the stripe; each range is widened to a multiple of align
+  void offset_len_to_chunk_extents(
+    std::pair<uint64_t, uint64_t> in,
+    uint64_t align,
+    std::map<int, interval_set<uint64_t> > *out) const;
 };
 
 int decode(
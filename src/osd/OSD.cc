@@ -884,6 +884,38 @@ osd_stat_t OSDService::set_osd_stat(vector<int>& hb_peers,
   return osd_stat;
 }
 
+bool OSDService::op_queue_uses_cost_model() const
+{
+  return osd->op_queue == io_queue::mclock_opclass ||
+    osd->op_queue == io_queue::mclock_client;
+}
+
+bool OSDService::op_queue_throttles_background() const
+{
+  return op_queue_uses_cost_model() &&
+    cct->_conf.get_val<std::string>("osd_mclock_profile") != "custom";
+}
+
+void OSDService::dump_ec_read_stats(Formatter *f)
+{
+  Mutex::Locker l(ec_read_stat_lock);
+  f->open_array_section("pools");
+  for (auto &p : ec_read_stats) {
+    f->open_object_section("pool");
+    uint64_t client_bytes = p.second->client_bytes;
+    uint64_t shard_bytes = p.second->shard_bytes;
+    f->dump_int("pool_id", p.first);
+    f->dump_unsigned("reads", p.second->reads);
+    f->dump_unsigned("degraded_reads", p.second->degraded_reads);
+    f->dump_unsigned("client_bytes", client_bytes);
+    f->dump_unsigned("shard_bytes", shard_bytes);
+    f->dump_float("read_amplification",
+		  client_bytes ? (double)shard_bytes / client_bytes : 0);
+    f->close_section();
+  }
+  f->close_section();
+}
+
 bool OSDService::check_osdmap_full(const set<pg_shard_t> &missing_on)
 {
   OSDMapRef osdmap = get_osdmap();
@@ -1662,11 +1694,19 @@ void OSDService::queue_for_scrub(PG *pg, bool with_high_priority)
   if (with_high_priority && scrub_queue_priority < cct->_conf->osd_client_op_priority) {
     scrub_queue_priority = cct->_conf->osd_client_op_priority;
   }
+  uint64_t cost = cct->_conf->osd_scrub_cost;
+  if (op_queue_uses_cost_model()) {
+    // charge what a deep scrub chunk reads; a shallow one only reads
+    // metadata and keeps the configured cost
+    if (uint64_t bytes = pg->get_scrub_chunk_bytes()) {
+      cost = std::min<uint64_t>(bytes, INT_MAX);
+    }
+  }
   const auto epoch = pg->get_osdmap_epoch();
   enqueue_back(
     OpQueueItem(
       unique_ptr<OpQueueItem::OpQueueable>(new PGScrub(pg->get_pgid(), epoch)),
-      cct->_conf->osd_scrub_cost,
+      cost,
       scrub_queue_priority,
       ceph_clock_now(),
       0,
@@ -1821,12 +1861,18 @@ void OSDService::_queue_for_recovery(
   uint64_t reserved_pushes)
 {
   ceph_assert(recovery_lock.is_locked_by_me());
+  uint64_t cost = cct->_conf->osd_recovery_cost;
+  if (op_queue_uses_cost_model()) {
+    // charge the bytes these pushes may move
+    cost = std::min<uint64_t>(
+      reserved_pushes * cct->_conf->osd_recovery_max_chunk, INT_MAX);
+  }
   enqueue_back(
     OpQueueItem(
       unique_ptr<OpQueueItem::OpQueueable>(
 	new PGRecovery(
 	  p.second->get_pgid(), p.first, reserved_pushes)),
-      cct->_conf->osd_recovery_cost,
+      cost,
       cct->_conf->osd_recovery_priority,
       ceph_clock_now(),
       0,
@@ -2127,7 +2173,9 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
       this,
       cct->_conf->osd_op_pq_max_tokens_per_priority,
       cct->_conf->osd_op_pq_min_cost,
-      op_queue);
+      op_queue,
+      store_is_rotational,
+      num_shards);
     shards.push_back(one_shard);
   }
 }
@@ -2419,6 +2467,8 @@ will start to track new ops received afterwards.";
     f->open_object_section("compact_result");
     f->dump_float("elapsed_time", duration);
     f->close_section();
+  } else if (admin_command == "dump_ec_read_stats") {
+    service.dump_ec_read_stats(f);
   } else if (admin_command == "get_mapped_pools") {
     f->open_array_section("mapped_pools");
     set<int64_t> poollist = get_mapped_pools();
@@ -2540,6 +2590,54 @@ int OSD::get_num_op_shards()
     return cct->_conf->osd_op_num_shards_ssd;
 }
 
+void OSD::set_numa_affinity()
+{
+  int store_node = -1;
+  set<int> nodes;
+  set<string> failed;
+  int r = store->get_numa_node(&store_node, &nodes, &failed);
+  if (r >= 0) {
+    dout(1) << __func__ << " storage numa node " << store_node << dendl;
+  } else {
+    dout(1) << __func__ << " storage numa node unknown (" << cpp_strerror(r)
+	    << "), nodes " << nodes << ", failed " << failed << dendl;
+  }
+
+  int64_t conf_node = cct->_conf.get_val<int64_t>("osd_numa_node");
+  if (conf_node >= 0) {
+    numa_node = conf_node;
+    dout(1) << __func__ << " setting numa_node to " << numa_node
+	    << " from osd_numa_node" << dendl;
+  } else if (cct->_conf.get_val<bool>("osd_numa_auto_affinity") &&
+	     store_node >= 0) {
+    numa_node = store_node;
+    dout(1) << __func__ << " setting numa_node to " << numa_node
+	    << " from storage" << dendl;
+  }
+  if (numa_node < 0) {
+    dout(1) << __func__ << " not setting numa affinity" << dendl;
+    return;
+  }
+
+  r = get_numa_node_cpu_set(numa_node, &numa_cpu_set_size, &numa_cpu_set);
+  if (r < 0) {
+    derr << __func__ << " unable to read cpus for numa node " << numa_node
+	 << ": " << cpp_strerror(r) << dendl;
+    numa_node = -1;
+    return;
+  }
+  dout(1) << __func__ << " numa node " << numa_node << " cpus "
+	  << cpu_set_to_str_list(numa_cpu_set_size, &numa_cpu_set) << dendl;
+  // threads started after this (op shards, recovery, ...) inherit the
+  // mask; those already running (store, messenger) are moved now
+  r = set_cpu_affinity_all_threads(numa_cpu_set_size, &numa_cpu_set);
+  if (r < 0) {
+    derr << __func__ << " failed to set numa affinity: " << cpp_strerror(r)
+	 << dendl;
+    numa_node = -1;
+  }
+}
+
 int OSD::get_num_op_threads()
 {
   if (cct->_conf->osd_op_num_threads_per_shard)
@@ -2552,6 +2650,8 @@ int OSD::get_num_op_threads()
 
 float OSD::get_osd_recovery_sleep()
 {
+  if (service.op_queue_throttles_background())
+    return 0;
   if (cct->_conf->osd_recovery_sleep)
     return cct->_conf->osd_recovery_sleep;
   if (!store_is_rotational && !journal_is_rotational)
@@ -2594,6 +2694,8 @@ int OSD::init()
   dout(2) << "journal looks like " << (journal_is_rotational ? "hdd" : "ssd")
           << dendl;
 
+  set_numa_affinity();
+
   enable_disable_fuse(false);
 
   dout(2) << "boot" << dendl;
@@ -3041,6 +3143,13 @@ void OSD::final_init()
                                      " WARNING: Compaction probably slows your requests");
   ceph_assert(r == 0);
 
+  r = admin_socket->register_command("dump_ec_read_stats",
+				     "dump_ec_read_stats",
+				     asok_hook,
+				     "show bytes read from the shards per byte"
+				     " returned, for erasure coded pools");
+  ceph_assert(r == 0);
+
   r = admin_socket->register_command("get_mapped_pools", "get_mapped_pools",
                                      asok_hook,
                                      "dump pools whose PG(s) are mapped to this OSD.");
@@ -3430,6 +3539,28 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_pg_remove_objects, "osd_pg_remove_objects",
+    "Objects removed by local PG deletion");
+
+  osd_plb.add_u64_counter(
+    l_osd_ec_overwrite_bytes, "ec_overwrite_bytes",
+    "Client bytes of partial stripe EC overwrites", NULL, 0, unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_overwrite_read_bytes, "ec_overwrite_read_bytes",
+    "Bytes read back to apply partial stripe EC overwrites", NULL, 0,
+    unit_t(UNIT_BYTES));
+  osd_plb.add_u64_counter(
+    l_osd_ec_parity_delta, "ec_parity_delta_writes",
+    "EC objects overwritten with a parity delta");
+  osd_plb.add_u64_counter(
+    l_osd_ec_full_rmw, "ec_full_rmw_writes",
+    "EC objects overwritten with a full stripe read-modify-write");
+
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_steal, "op_wq_steal",
+    "Op queue items processed by a thread of another shard");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -5719,6 +5850,24 @@ void OSD::_collect_metadata(map<string,string> *pm)
   }
   (*pm)["device_ids"] = devids;
 
+  // numa
+  int store_node = -1;
+  set<int> nodes;
+  set<string> failed;
+  store->get_numa_node(&store_node, &nodes, &failed);
+  if (store_node >= 0) {
+    (*pm)["objectstore_numa_node"] = stringify(store_node);
+  }
+  (*pm)["objectstore_numa_nodes"] = stringify(nodes);
+  if (!failed.empty()) {
+    (*pm)["objectstore_numa_unknown_devices"] = stringify(failed);
+  }
+  if (numa_node >= 0) {
+    (*pm)["numa_node"] = stringify(numa_node);
+    (*pm)["numa_node_cpus"] = cpu_set_to_str_list(numa_cpu_set_size,
+						  &numa_cpu_set);
+  }
+
   dout(10) << __func__ << " " << *pm << dendl;
 }
 
@@ -7695,6 +7844,7 @@ void OSD::handle_osd_map(MOSDMap *m)
 	encode(profile, bl);
 	t.write(coll_t::meta(), obj, 0, bl.length(), bl);
 	service.store_deleted_pool_pg_num(j.first, j.second.get_pg_num());
+	service.remove_ec_read_stat(j.first);
       } else if (unsigned new_pg_num = i.second->get_pg_num(j.first);
 		 new_pg_num != j.second.get_pg_num()) {
 	dout(10) << __func__ << " recording pool " << j.first << " pg_num "
@@ -9444,6 +9594,13 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_client_message_cap",
     "osd_heartbeat_min_size",
     "osd_heartbeat_interval",
+    "osd_mclock_profile",
+    "osd_mclock_cost_per_io_usec",
+    "osd_mclock_cost_per_io_usec_hdd",
+    "osd_mclock_cost_per_io_usec_ssd",
+    "osd_mclock_cost_per_byte_usec",
+    "osd_mclock_cost_per_byte_usec_hdd",
+    "osd_mclock_cost_per_byte_usec_ssd",
     NULL
   };
   return KEYS;
@@ -9529,6 +9686,17 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
       pol.throttler_bytes->reset_max(newval);
     }
   }
+  if (changed.count("osd_mclock_profile") ||
+      changed.count("osd_mclock_cost_per_io_usec") ||
+      changed.count("osd_mclock_cost_per_io_usec_hdd") ||
+      changed.count("osd_mclock_cost_per_io_usec_ssd") ||
+      changed.count("osd_mclock_cost_per_byte_usec") ||
+      changed.count("osd_mclock_cost_per_byte_usec_hdd") ||
+      changed.count("osd_mclock_cost_per_byte_usec_ssd")) {
+    for (auto shard : shards) {
+      shard->update_op_queue_config();
+    }
+  }
 
   check_config();
 }
@@ -10165,6 +10333,16 @@ void OSDShard::unprime_split_children(spg_t parent, unsigned old_pg_num)
   }
 }
 
+void OSDShard::update_op_queue_config()
+{
+  Mutex::Locker l(shard_lock);
+  if (auto q = dynamic_cast<ceph::mClockOpClassQueue*>(pqueue.get())) {
+    q->update_client_info();
+  } else if (auto q = dynamic_cast<ceph::mClockClientQueue*>(pqueue.get())) {
+    q->update_client_info();
+  }
+}
+
 
 // =============================================================
 
@@ -10199,7 +10377,7 @@ void OSD::ShardedOpWQ::_add_slot_waiter(
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % osd->num_shards;
-  auto& sdata = osd->shards[shard_index];
+  OSDShard *sdata = osd->shards[shard_index];
   ceph_assert(sdata);
 
   // If all threads of shards do oncommits, there is a out-of-order problem.
@@ -10207,6 +10385,24 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   // to do oncommit callback.
   bool is_smallest_thread_index = thread_index < osd->num_shards;
 
+  // With nothing to do on our own shard, help the busiest one.  The item
+  // still goes through that shard's pg slots, so it is ordered just as if
+  // one more thread was serving that shard, but it is only taken if its
+  // pg is idle there.  Its oncommits are left to its own threads.
+  bool stolen = false;
+  if (osd->cct->_conf->osd_op_queue_work_stealing &&
+      sdata->queue_depth == 0 &&
+      (!is_smallest_thread_index || sdata->context_queue.empty())) {
+    OSDShard *victim = _pick_steal_victim(shard_index);
+    if (victim) {
+      dout(20) << __func__ << " shard " << shard_index << " helping shard "
+	       << victim->shard_id << " depth " << victim->queue_depth << dendl;
+      sdata = victim;
+      is_smallest_thread_index = false;
+      stolen = true;
+    }
+  }
+
   // peek at spg_t
   sdata->shard_lock.Lock();
   if (is_smallest_thread_index) {
@@ -10216,7 +10412,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 	dout(20) << __func__ << " empty q, waiting" << dendl;
 	osd->cct->get_heartbeat_map()->clear_timeout(hb);
 	sdata->shard_lock.Unlock();
+	++sdata->idle_threads;
 	sdata->sdata_cond.Wait(sdata->sdata_wait_lock);
+	--sdata->idle_threads;
 	sdata->sdata_wait_lock.Unlock();
 	sdata->shard_lock.Lock();
 	if (sdata->pqueue->empty() && sdata->context_queue.empty()) {
@@ -10233,12 +10431,19 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       }
     }
   } else if (sdata->pqueue->empty()) {
+    if (stolen) {
+      // its own threads got there first
+      sdata->shard_lock.Unlock();
+      return;
+    }
     sdata->sdata_wait_lock.Lock();
     if (!sdata->stop_waiting) {
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.Unlock();
+      ++sdata->idle_threads;
       sdata->sdata_cond.Wait(sdata->sdata_wait_lock);
+      --sdata->idle_threads;
       sdata->sdata_wait_lock.Unlock();
       sdata->shard_lock.Lock();
       if (sdata->pqueue->empty()) {
@@ -10272,6 +10477,24 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   OpQueueItem item = sdata->pqueue->dequeue();
+  --sdata->queue_depth;
+  if (stolen) {
+    // only help with pgs none of the shard's own threads is working on,
+    // or we would just wait for them on the pg lock
+    auto p = sdata->pg_slots.find(item.get_ordering_token());
+    if (p != sdata->pg_slots.end() &&
+	(p->second->num_running || !p->second->to_process.empty())) {
+      dout(20) << __func__ << " " << item.get_ordering_token()
+	       << " busy, leaving " << item << " to shard "
+	       << sdata->shard_id << dendl;
+      sdata->_enqueue_front(std::move(item), osd->op_prio_cutoff);
+      sdata->shard_lock.Unlock();
+      return;
+    }
+    ++sdata->num_stolen;
+    ++osd->shards[shard_index]->num_steals;
+    osd->logger->inc(l_osd_op_wq_steal);
+  }
 
   const auto token = item.get_ordering_token();
   auto r = sdata->pg_slots.emplace(token, nullptr);
@@ -10514,12 +10737,46 @@ void OSD::ShardedOpWQ::_enqueue(OpQueueItem&& item) {
   else
     sdata->pqueue->enqueue(
       item.get_owner(), priority, cost, std::move(item));
+  unsigned depth = ++sdata->queue_depth;
   sdata->shard_lock.Unlock();
 
   sdata->sdata_wait_lock.Lock();
   sdata->sdata_cond.SignalOne();
   sdata->sdata_wait_lock.Unlock();
 
+  if (osd->cct->_conf->osd_op_queue_work_stealing &&
+      depth >= osd->cct->_conf->osd_op_queue_steal_min_depth) {
+    _wake_steal_thread(shard_index);
+  }
+}
+
+OSDShard *OSD::ShardedOpWQ::_pick_steal_victim(uint32_t shard_index)
+{
+  uint64_t min_depth = osd->cct->_conf->osd_op_queue_steal_min_depth;
+  OSDShard *victim = nullptr;
+  unsigned max_depth = 0;
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    OSDShard *s = osd->shards[(shard_index + i) % osd->num_shards];
+    unsigned depth = s->queue_depth;
+    if (depth >= min_depth && depth > max_depth) {
+      victim = s;
+      max_depth = depth;
+    }
+  }
+  return victim;
+}
+
+void OSD::ShardedOpWQ::_wake_steal_thread(uint32_t shard_index)
+{
+  for (uint32_t i = 1; i < osd->num_shards; ++i) {
+    OSDShard *s = osd->shards[(shard_index + i) % osd->num_shards];
+    if (s->idle_threads) {
+      s->sdata_wait_lock.Lock();
+      s->sdata_cond.SignalOne();
+      s->sdata_wait_lock.Unlock();
+      return;
+    }
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue_front(OpQueueItem&& item)
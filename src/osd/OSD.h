@@ -26,6 +26,7 @@
 #include "common/AsyncReserver.h"
 #include "common/ceph_context.h"
 #include "common/config_cacher.h"
+#include "common/numa.h"
 #include "common/zipkin_trace.h"
 
 #include "mgr/MgrClient.h"
@@ -186,6 +187,15 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_pg_remove_objects,
+
+  l_osd_ec_overwrite_bytes,
+  l_osd_ec_overwrite_read_bytes,
+  l_osd_ec_parity_delta,
+  l_osd_ec_full_rmw,
+
+  l_osd_op_wq_steal,
+
   l_osd_last,
 };
 
@@ -702,6 +712,12 @@ public:
   Mutex sleep_lock;
   SafeTimer sleep_timer;
 
+  /// true if the op queue charges ops by the mClock cost model
+  bool op_queue_uses_cost_model() const;
+  /// true if an mClock profile paces background work, so the
+  /// recovery/scrub/snap trim sleeps are skipped
+  bool op_queue_throttles_background() const;
+
   // -- tids --
   // for ops i issue
   std::atomic<unsigned int> last_tid{0};
@@ -915,6 +931,40 @@ public:
     return osd_stat.seq;
   }
 
+  // -- ec read amplification --
+  struct ec_read_stat_t {
+    std::atomic<uint64_t> reads = {0};           ///< client reads served
+    std::atomic<uint64_t> degraded_reads = {0};  ///< ... which had to decode missing chunks
+    std::atomic<uint64_t> client_bytes = {0};    ///< bytes returned to the clients
+    std::atomic<uint64_t> shard_bytes = {0};     ///< bytes read from the shards
+
+    void log(uint64_t client, uint64_t shard, bool degraded) {
+      ++reads;
+      if (degraded) {
+	++degraded_reads;
+      }
+      client_bytes += client;
+      shard_bytes += shard;
+    }
+  };
+  typedef std::shared_ptr<ec_read_stat_t> ec_read_stat_ref;
+  Mutex ec_read_stat_lock = {"OSDService::ec_read_stat_lock"};
+  map<int64_t, ec_read_stat_ref> ec_read_stats;  ///< by pool
+  /// the pool's stats; pgs keep the ref and update it without locking
+  ec_read_stat_ref get_ec_read_stat(int64_t pool) {
+    Mutex::Locker l(ec_read_stat_lock);
+    auto &s = ec_read_stats[pool];
+    if (!s) {
+      s = std::make_shared<ec_read_stat_t>();
+    }
+    return s;
+  }
+  void remove_ec_read_stat(int64_t pool) {
+    Mutex::Locker l(ec_read_stat_lock);
+    ec_read_stats.erase(pool);
+  }
+  void dump_ec_read_stats(Formatter *f);
+
   // -- OSD Full Status --
 private:
   friend TestOpsSocketHook;
@@ -1168,6 +1218,12 @@ struct OSDShard {
   /// priority queue
   std::unique_ptr<OpQueue<OpQueueItem, uint64_t>> pqueue;
 
+  // for work stealing, readable without shard_lock
+  std::atomic<unsigned> queue_depth = {0};   ///< items in pqueue
+  std::atomic<unsigned> idle_threads = {0};  ///< threads waiting on sdata_cond
+  std::atomic<uint64_t> num_steals = {0};    ///< items taken from other shards
+  std::atomic<uint64_t> num_stolen = {0};    ///< items taken by other shards
+
   bool stop_waiting = false;
 
   ContextQueue context_queue;
@@ -1183,6 +1239,7 @@ struct OSDShard {
       pqueue->enqueue_front(
 	item.get_owner(),
 	priority, cost, std::move(item));
+    ++queue_depth;
   }
 
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
@@ -1214,12 +1271,17 @@ struct OSDShard {
   void register_and_wake_split_child(PG *pg);
   void unprime_split_children(spg_t parent, unsigned old_pg_num);
 
+  /// push changed mClock profile/cost options into the op queue
+  void update_op_queue_config();
+
   OSDShard(
     int id,
     CephContext *cct,
     OSD *osd,
     uint64_t max_tok_per_prio, uint64_t min_cost,
-    io_queue opqueue)
+    io_queue opqueue,
+    bool rotational,
+    unsigned num_shards)
     : shard_id(id),
       cct(cct),
       osd(osd),
@@ -1240,9 +1302,11 @@ struct OSDShard {
 	PrioritizedQueue<OpQueueItem,uint64_t>>(
 	  max_tok_per_prio, min_cost);
     } else if (opqueue == io_queue::mclock_opclass) {
-      pqueue = std::make_unique<ceph::mClockOpClassQueue>(cct);
+      pqueue = std::make_unique<ceph::mClockOpClassQueue>(
+	cct, rotational, num_shards);
     } else if (opqueue == io_queue::mclock_client) {
-      pqueue = std::make_unique<ceph::mClockClientQueue>(cct);
+      pqueue = std::make_unique<ceph::mClockClientQueue>(
+	cct, rotational, num_shards);
     }
   }
 };
@@ -1292,6 +1356,10 @@ protected:
   bool store_is_rotational = true;
   bool journal_is_rotational = true;
 
+  int numa_node = -1;           ///< node we are pinned to, or -1
+  size_t numa_cpu_set_size = 0;
+  cpu_set_t numa_cpu_set;
+
   ZTracer::Endpoint trace_endpoint;
   void create_logger();
   void create_recoverystate_perf();
@@ -1732,6 +1800,12 @@ protected:
     /// try to do some work
     void _process(uint32_t thread_index, heartbeat_handle_d *hb) override;
 
+    /// shard with the deepest queue past osd_op_queue_steal_min_depth
+    OSDShard *_pick_steal_victim(uint32_t shard_index);
+
+    /// wake a waiting thread of another shard to help shard_index
+    void _wake_steal_thread(uint32_t shard_index);
+
     /// enqueue a new item
     void _enqueue(OpQueueItem&& item) override;
 
@@ -1770,6 +1844,9 @@ protected:
 	sdata->shard_lock.Lock();
 	f->open_object_section(queue_name);
 	sdata->pqueue->dump(f);
+	f->dump_unsigned("queue_depth", sdata->queue_depth);
+	f->dump_unsigned("steals", sdata->num_steals);
+	f->dump_unsigned("stolen", sdata->num_stolen);
 	f->close_section();
 	sdata->shard_lock.Unlock();
       }
@@ -2275,6 +2352,7 @@ private:
 
   int get_num_op_shards();
   int get_num_op_threads();
+  void set_numa_affinity();
 
   float get_osd_recovery_sleep();
 
@@ -4287,6 +4287,15 @@ bool PG::sched_scrub()
   return ret;
 }
 
+uint64_t PG::get_scrub_chunk_bytes() const
+{
+  const object_stat_sum_t& sum = info.stats.stats.sum;
+  if (!scrubber.deep || sum.num_objects <= 0 || sum.num_bytes <= 0) {
+    return 0;
+  }
+  return cct->_conf->osd_scrub_chunk_max * (sum.num_bytes / sum.num_objects);
+}
+
 void PG::reg_next_scrub()
 {
   if (!is_primary())
@@ -4885,6 +4894,7 @@ void PG::replica_scrub(
 void PG::scrub(epoch_t queued, ThreadPool::TPHandle &handle)
 {
   if (cct->_conf->osd_scrub_sleep > 0 &&
+      !osd->op_queue_throttles_background() &&
       (scrubber.state == PG::Scrubber::NEW_CHUNK ||
        scrubber.state == PG::Scrubber::INACTIVE) &&
        scrubber.needs_sleep) {
@@ -6743,16 +6753,22 @@ void PG::_delete_some(ObjectStore::Transaction *t)
     if (r != 0 && r != -ENOENT) {
       ceph_abort();
     }
-    t->remove(coll, oid);
     ++num;
   }
   epoch_t e = get_osdmap()->get_epoch();
   if (num) {
-    dout(20) << __func__ << " deleting " << num << " objects" << dendl;
+    // one op for the whole batch lets the store drop the objects' omap
+    // with range deletes instead of a tombstone per key
+    t->collection_remove_range(coll, olist.front(), next);
+    num_objects_deleted += num;
+    osd->logger->inc(l_osd_pg_remove_objects, num);
+    dout(10) << __func__ << " deleting " << num << " objects, "
+	     << num_objects_deleted << " so far" << dendl;
     Context *fin = new C_DeleteMore(this, e);
     t->register_on_commit(fin);
   } else {
-    dout(20) << __func__ << " finished" << dendl;
+    dout(10) << __func__ << " finished, removed " << num_objects_deleted
+	     << " objects" << dendl;
     if (cct->_conf->osd_inject_failure_on_pg_removal) {
       _exit(1);
     }
@@ -404,6 +404,8 @@ public:
   void finish_split_stats(const object_stat_sum_t& stats, ObjectStore::Transaction *t);
 
   void scrub(epoch_t queued, ThreadPool::TPHandle &handle);
+  /// bytes the next deep scrub chunk is expected to read, 0 if shallow
+  uint64_t get_scrub_chunk_bytes() const;
   void reg_next_scrub();
   void unreg_next_scrub();
 
@@ -575,6 +577,7 @@ protected:
 
   bool deleting;  // true while in removing or OSD is shutting down
   atomic<bool> deleted = {false};
+  uint64_t num_objects_deleted = 0;  ///< objects removed so far by _delete_some
 
   ZTracer::Endpoint trace_endpoint;
 
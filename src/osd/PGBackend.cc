@@ -408,6 +408,18 @@ int PGBackend::objects_list_range(
   return r;
 }
 
+void PGBackend::objects_prefetch(
+  const vector<hobject_t> &hoids)
+{
+  vector<ghobject_t> oids;
+  oids.reserve(hoids.size());
+  for (auto& hoid : hoids) {
+    oids.emplace_back(
+      hoid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+  }
+  store->prefetch_objects(ch, oids);
+}
+
 int PGBackend::objects_get_attr(
   const hobject_t &hoid,
   const string &attr,
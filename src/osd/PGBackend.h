@@ -285,6 +285,11 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      virtual entity_name_t get_cluster_msgr_name() = 0;
 
      virtual PerfCounters *get_logger() = 0;
+     /// account an EC client read in the per pool read amplification
+     virtual void log_ec_read(
+       uint64_t client_bytes,
+       uint64_t shard_bytes,
+       bool degraded) = 0;
 
      virtual ceph_tid_t get_tid() = 0;
 
@@ -537,6 +542,10 @@ typedef std::shared_ptr<const OSDMap> OSDMapRef;
      vector<hobject_t> *ls,
      vector<ghobject_t> *gen_obs=0);
 
+   /// Hint that the metadata of hoids will be read shortly
+   void objects_prefetch(
+     const vector<hobject_t> &hoids);
+
    int objects_get_attr(
      const hobject_t &hoid,
      const string &attr,
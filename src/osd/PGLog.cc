@@ -138,7 +138,7 @@ ostream& PGLog::IndexedLog::print(ostream& out) const
     ceph_assert(!p->reqid_is_indexed() || logged_req(p->reqid));
   }
 
-  for (list<pg_log_dup_t>::const_iterator p = dups.begin();
+  for (auto p = dups.cbegin();
        p != dups.end();
        ++p) {
     out << *p << std::endl;
@@ -505,21 +505,20 @@ bool PGLog::merge_log_dups(const pg_log_t& olog) {
 
 	auto log_tail_version = log.dups.back().version;
 
-	auto insert_cursor = log.dups.end();
-	eversion_t last_shared = eversion_t::max();
-	for (auto i = olog.dups.crbegin(); i != olog.dups.crend(); ++i) {
-	  if (i->version <= log_tail_version) break;
-	  log.dups.insert(insert_cursor, *i);
-	  last_shared = i->version;
-
-	  auto prev = insert_cursor;
-	  --prev;
-	  // be sure to pass reference of copy in log.dups
-	  log.index(*prev);
-
-	  --insert_cursor; // make sure we insert in reverse order
+	auto first_new = olog.dups.cend();
+	while (first_new != olog.dups.cbegin() &&
+	       std::prev(first_new)->version > log_tail_version) {
+	  --first_new;
+	}
+	mark_dirty_from_dups(first_new->version);
+
+	// inserting at either end of the deque keeps the references held
+	// by dup_index valid
+	auto old_size = log.dups.size();
+	log.dups.insert(log.dups.end(), first_new, olog.dups.cend());
+	for (auto i = log.dups.begin() + old_size; i != log.dups.end(); ++i) {
+	  log.index(*i);
 	}
-	mark_dirty_from_dups(last_shared);
       }
 
       if (olog.dups.front().version < log.dups.front().version) {
@@ -528,18 +527,20 @@ bool PGLog::merge_log_dups(const pg_log_t& olog) {
 	  olog.dups.front().version << dendl;
 	changed = true;
 
-	eversion_t last;
-	auto insert_cursor = log.dups.begin();
-	for (auto i = olog.dups.cbegin(); i != olog.dups.cend(); ++i) {
-	  if (i->version >= insert_cursor->version) break;
-	  log.dups.insert(insert_cursor, *i);
-	  last = i->version;
-	  auto prev = insert_cursor;
-	  --prev;
-	  // be sure to pass address of copy in log.dups
-	  log.index(*prev);
+	auto log_head_version = log.dups.front().version;
+
+	auto end_new = olog.dups.cbegin();
+	while (end_new != olog.dups.cend() &&
+	       end_new->version < log_head_version) {
+	  ++end_new;
+	}
+	mark_dirty_to_dups(std::prev(end_new)->version);
+
+	auto num_new = end_new - olog.dups.cbegin();
+	log.dups.insert(log.dups.begin(), olog.dups.cbegin(), end_new);
+	for (auto i = log.dups.begin(); i != log.dups.begin() + num_new; ++i) {
+	  log.index(*i);
 	}
-	mark_dirty_to_dups(last);
       }
     }
   }
@@ -759,7 +760,7 @@ void PGLog::_write_log_and_missing_wo_missing(
     (*km)[entry.get_key_name()].claim(bl);
   }
 
-  for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
+  for (auto p = log.dups.rbegin();
        p != log.dups.rend() &&
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
@@ -888,7 +889,7 @@ void PGLog::_write_log_and_missing(
     (*km)[entry.get_key_name()].claim(bl);
   }
 
-  for (list<pg_log_dup_t>::reverse_iterator p = log.dups.rbegin();
+  for (auto p = log.dups.rbegin();
        p != log.dups.rend() &&
 	 (p->version >= dirty_from_dups || p->version >= write_from_dups) &&
 	 p->version >= dirty_to_dups;
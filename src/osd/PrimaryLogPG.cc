@@ -8125,7 +8125,7 @@ void PrimaryLogPG::make_writeable(OpContext *ctx)
 			 ctx->obs->oi.version,
 			 ctx->obs->oi.user_version,
 			 osd_reqid_t(), ctx->new_obs.oi.mtime, 0));
-    encode(snaps, ctx->log.back().snaps);
+    encode(snaps, ctx->log.back().snaps.get_mutable());
 
     ctx->at_version.version++;
   }
@@ -13360,6 +13360,7 @@ void PrimaryLogPG::scan_range(
   dout(10) << " got " << ls.size() << " items, next " << bi->end << dendl;
   dout(20) << ls << dendl;
 
+  pgbackend->objects_prefetch(ls);
   for (vector<hobject_t>::iterator p = ls.begin(); p != ls.end(); ++p) {
     handle.reset_tp_timeout();
     ObjectContextRef obc;
@@ -480,6 +480,16 @@ public:
   }
 
   PerfCounters *get_logger() override;
+  void log_ec_read(
+    uint64_t client_bytes,
+    uint64_t shard_bytes,
+    bool degraded) override {
+    // called with the pg lock held
+    if (!ec_read_stat) {
+      ec_read_stat = osd->get_ec_read_stat(info.pgid.pool());
+    }
+    ec_read_stat->log(client_bytes, shard_bytes, degraded);
+  }
 
   ceph_tid_t get_tid() override { return osd->get_tid(); }
 
@@ -1468,6 +1478,7 @@ private:
   bool check_src_targ(const hobject_t& soid, const hobject_t& toid) const;
 
   uint64_t temp_seq; ///< last id for naming temp objects
+  OSDService::ec_read_stat_ref ec_read_stat; ///< our pool's, see log_ec_read
   /// generate a new temp object name
   hobject_t generate_temp_object(const hobject_t& target);
   /// generate a new temp object name (for recovery)
@@ -1608,7 +1619,8 @@ private:
 	}
       };
       auto *pg = context< SnapTrimmer >().pg;
-      if (pg->cct->_conf->osd_snap_trim_sleep > 0) {
+      if (pg->cct->_conf->osd_snap_trim_sleep > 0 &&
+	  !pg->osd->op_queue_throttles_background()) {
 	Mutex::Locker l(pg->osd->sleep_lock);
 	wakeup = pg->osd->sleep_timer.add_event_after(
 	  pg->cct->_conf->osd_snap_trim_sleep,
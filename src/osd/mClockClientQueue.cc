@@ -33,10 +33,11 @@ namespace ceph {
    * class mClockClientQueue
    */
 
-  mClockClientQueue::mClockClientQueue(CephContext *cct) :
+  mClockClientQueue::mClockClientQueue(CephContext *cct, bool rotational,
+				       unsigned num_shards) :
     queue(std::bind(&mClockClientQueue::op_class_client_info_f, this, _1),
 	  cct->_conf->osd_op_queue_mclock_anticipation_timeout),
-    client_info_mgr(cct)
+    client_info_mgr(cct, rotational, num_shards)
   {
     // empty
   }
@@ -78,7 +79,8 @@ namespace ceph {
 					 unsigned priority,
 					 unsigned cost,
 					 Request&& item) {
-    queue.enqueue(get_inner_client(cl, item), priority, 1u, std::move(item));
+    queue.enqueue(get_inner_client(cl, item), priority,
+		  client_info_mgr.calc_cost(cost), std::move(item));
   }
 
   // Enqueue the op in the front of the regular queue
@@ -49,7 +49,13 @@ namespace ceph {
 
   public:
 
-    mClockClientQueue(CephContext *cct);
+    mClockClientQueue(CephContext *cct, bool rotational = true,
+		      unsigned num_shards = 1);
+
+    // re-read the mClock profile and cost model options
+    void update_client_info() {
+      client_info_mgr.update();
+    }
 
     const crimson::dmclock::ClientInfo* op_class_client_info_f(const InnerClient& client);
 
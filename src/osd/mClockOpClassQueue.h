@@ -47,7 +47,13 @@ namespace ceph {
 
   public:
 
-    mClockOpClassQueue(CephContext *cct);
+    mClockOpClassQueue(CephContext *cct, bool rotational = true,
+		       unsigned num_shards = 1);
+
+    // re-read the mClock profile and cost model options
+    void update_client_info() {
+      client_info_mgr.update();
+    }
 
     const crimson::dmclock::ClientInfo*
     op_class_client_info_f(const osd_op_type_t& op_type);
@@ -94,7 +100,7 @@ namespace ceph {
 			Request&& item) override final {
       queue.enqueue(client_info_mgr.osd_op_type(item),
 		    priority,
-		    1u,
+		    client_info_mgr.calc_cost(cost),
 		    std::move(item));
     }
 
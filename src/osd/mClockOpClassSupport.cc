@@ -13,6 +13,8 @@
  */
 
 
+#include <algorithm>
+
 #include "common/dout.h"
 #include "osd/mClockOpClassSupport.h"
 #include "osd/OpQueueItem.h"
@@ -23,7 +25,12 @@ namespace ceph {
 
   namespace mclock {
 
-    OpClassClientInfoMgr::OpClassClientInfoMgr(CephContext *cct) :
+    OpClassClientInfoMgr::OpClassClientInfoMgr(CephContext *cct,
+					       bool rotational,
+					       unsigned num_shards) :
+      cct(cct),
+      rotational(rotational),
+      num_shards(std::max(num_shards, 1u)),
       client_op(cct->_conf->osd_op_queue_mclock_client_op_res,
 		cct->_conf->osd_op_queue_mclock_client_op_wgt,
 		cct->_conf->osd_op_queue_mclock_client_op_lim),
@@ -60,18 +67,142 @@ namespace ceph {
 	add_rep_op_msg(op);
       }
 
+      update();
+
+      lgeneric_subdout(cct, osd, 30) <<
+	"mClock OpClass message bit set:: " <<
+	rep_op_msg_bitset.to_string() << dendl;
+    }
+
+    void OpClassClientInfoMgr::update() {
+      update_cost_model();
+
+      auto profile = cct->_conf.get_val<std::string>("osd_mclock_profile");
+      if (profile == "custom") {
+	client_op.update(cct->_conf->osd_op_queue_mclock_client_op_res,
+			 cct->_conf->osd_op_queue_mclock_client_op_wgt,
+			 cct->_conf->osd_op_queue_mclock_client_op_lim);
+	osd_rep_op.update(cct->_conf->osd_op_queue_mclock_osd_rep_op_res,
+			  cct->_conf->osd_op_queue_mclock_osd_rep_op_wgt,
+			  cct->_conf->osd_op_queue_mclock_osd_rep_op_lim);
+	snaptrim.update(cct->_conf->osd_op_queue_mclock_snap_res,
+			cct->_conf->osd_op_queue_mclock_snap_wgt,
+			cct->_conf->osd_op_queue_mclock_snap_lim);
+	recov.update(cct->_conf->osd_op_queue_mclock_recov_res,
+		     cct->_conf->osd_op_queue_mclock_recov_wgt,
+		     cct->_conf->osd_op_queue_mclock_recov_lim);
+	scrub.update(cct->_conf->osd_op_queue_mclock_scrub_res,
+		     cct->_conf->osd_op_queue_mclock_scrub_wgt,
+		     cct->_conf->osd_op_queue_mclock_scrub_lim);
+	pg_delete.update(cct->_conf->osd_op_queue_mclock_pg_delete_res,
+			 cct->_conf->osd_op_queue_mclock_pg_delete_wgt,
+			 cct->_conf->osd_op_queue_mclock_pg_delete_lim);
+	peering_event.update(
+	  cct->_conf->osd_op_queue_mclock_peering_event_res,
+	  cct->_conf->osd_op_queue_mclock_peering_event_wgt,
+	  cct->_conf->osd_op_queue_mclock_peering_event_lim);
+      } else {
+	apply_profile(profile);
+      }
+
       lgeneric_subdout(cct, osd, 20) <<
 	"mClock OpClass settings:: " <<
-	"client_op:" << client_op <<
+	"profile:" << profile <<
+	"; cost_per_io:" << cost_per_io <<
+	"; cost_per_byte:" << cost_per_byte <<
+	"; num_shards:" << num_shards <<
+	"; client_op:" << client_op <<
 	"; osd_rep_op:" << osd_rep_op <<
 	"; snaptrim:" << snaptrim <<
 	"; recov:" << recov <<
 	"; scrub:" << scrub <<
+	"; pg_delete:" << pg_delete <<
+	"; peering_event:" << peering_event <<
 	dendl;
+    }
 
-      lgeneric_subdout(cct, osd, 30) <<
-	"mClock OpClass message bit set:: " <<
-	rep_op_msg_bitset.to_string() << dendl;
+    void OpClassClientInfoMgr::update_cost_model() {
+      double io = cct->_conf.get_val<double>("osd_mclock_cost_per_io_usec");
+      if (io <= 0) {
+	io = cct->_conf.get_val<double>(
+	  rotational ? "osd_mclock_cost_per_io_usec_hdd" :
+	  "osd_mclock_cost_per_io_usec_ssd");
+      }
+      double byte =
+	cct->_conf.get_val<double>("osd_mclock_cost_per_byte_usec");
+      if (byte <= 0) {
+	byte = cct->_conf.get_val<double>(
+	  rotational ? "osd_mclock_cost_per_byte_usec_hdd" :
+	  "osd_mclock_cost_per_byte_usec_ssd");
+      }
+      // the options have minimums, but don't let a bad value slip into
+      // the divisor; keep the previous model (or a harmless one) instead
+      if (io > 0) {
+	cost_per_io = io;
+      } else {
+	lgeneric_subdout(cct, osd, 0) << "WARNING: ignoring mClock cost per io "
+				       << io << dendl;
+	if (cost_per_io <= 0) {
+	  cost_per_io = 1.0;
+	}
+      }
+      if (byte >= 0) {
+	cost_per_byte = byte;
+      } else {
+	lgeneric_subdout(cct, osd, 0) << "WARNING: ignoring mClock cost per byte "
+				       << byte << dendl;
+      }
+    }
+
+    /*
+     * The built-in profiles split the device between three groups:
+     * client ops (including replica ops and peering events),
+     * recovery and backfill, and the best effort background work
+     * (scrub, snap trim and pg deletion).  Reservations and limits are
+     * given as a fraction of the device capacity, which is the number
+     * of small random IOs it can do per second as implied by the cost
+     * model; a limit of 0 means unlimited.  Each op queue shard runs
+     * its own scheduler, so it gets 1/num_shards of that capacity.
+     */
+    void OpClassClientInfoMgr::apply_profile(const std::string& profile) {
+      struct class_params_t {
+	double res;
+	double wgt;
+	double lim;
+      };
+      struct profile_t {
+	class_params_t client;
+	class_params_t recovery;
+	class_params_t best_effort;
+      };
+      static const profile_t high_client_ops = {
+	{ 0.50, 2.0, 0.0 }, { 0.25, 1.0, 0.50 }, { 0.0, 1.0, 0.25 } };
+      static const profile_t balanced = {
+	{ 0.40, 1.0, 0.0 }, { 0.40, 1.0, 0.70 }, { 0.0, 1.0, 0.20 } };
+      static const profile_t high_recovery_ops = {
+	{ 0.30, 1.0, 0.0 }, { 0.60, 2.0, 0.0 }, { 0.0, 1.0, 0.20 } };
+
+      const profile_t *p;
+      if (profile == "high_recovery_ops") {
+	p = &high_recovery_ops;
+      } else if (profile == "balanced") {
+	p = &balanced;
+      } else {
+	p = &high_client_ops;
+      }
+
+      const double capacity = 1000000.0 / cost_per_io / num_shards;
+      auto set = [capacity](crimson::dmclock::ClientInfo& info,
+			    const class_params_t& params) {
+	info.update(params.res * capacity, params.wgt, params.lim * capacity);
+      };
+      set(client_op, p->client);
+      set(osd_rep_op, p->client);
+      set(peering_event, p->client);
+      set(recov, p->recovery);
+      set(snaptrim, p->best_effort);
+      set(scrub, p->best_effort);
+      set(pg_delete, p->best_effort);
     }
 
     void OpClassClientInfoMgr::add_rep_op_msg(int message_code) {
@@ -15,7 +15,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <bitset>
+#include <limits>
+#include <string>
 
 #include "dmclock/src/dmclock_server.h"
 #include "osd/OpRequest.h"
@@ -33,6 +36,11 @@ namespace ceph {
     };
 
     class OpClassClientInfoMgr {
+      CephContext *cct;
+      const bool rotational;
+      // each op queue shard schedules its own share of the device
+      const unsigned num_shards;
+
       crimson::dmclock::ClientInfo client_op;
       crimson::dmclock::ClientInfo osd_rep_op;
       crimson::dmclock::ClientInfo snaptrim;
@@ -45,9 +53,31 @@ namespace ceph {
       std::bitset<rep_op_msg_bitset_size> rep_op_msg_bitset;
       void add_rep_op_msg(int message_code);
 
+      // cost model, in usec of device time, see calc_cost()
+      double cost_per_io = 0;
+      double cost_per_byte = 0;
+
+      void update_cost_model();
+      void apply_profile(const std::string& profile);
+
     public:
 
-      OpClassClientInfoMgr(CephContext *cct);
+      OpClassClientInfoMgr(CephContext *cct, bool rotational = true,
+			   unsigned num_shards = 1);
+
+      // re-read the profile and cost model options; the ClientInfo
+      // objects are updated in place since the dmclock queue holds
+      // pointers to them, so the caller must hold the queue's lock
+      void update();
+
+      // converts the byte-based cost attached to an op queue item
+      // into the number of equivalent small random IOs on this device
+      unsigned calc_cost(unsigned bytes) const {
+	const double ios = std::min<double>(
+	  bytes * cost_per_byte / cost_per_io,
+	  std::numeric_limits<unsigned>::max() - 1u);
+	return 1u + unsigned(ios);
+      }
 
       inline const crimson::dmclock::ClientInfo*
       get_client_info(osd_op_type_t type) {
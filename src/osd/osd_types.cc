@@ -3810,10 +3810,14 @@ void pg_query_t::generate_test_instances(list<pg_query_t*>& o)
 			     *h.back(), 5));
 }
 
+// -- pg_log_bl_t --
+
+MEMPOOL_DEFINE_OBJECT_FACTORY(pg_log_bl_t::slot_t, pg_log_bl, osd_pglog);
+
 // -- ObjectModDesc --
 void ObjectModDesc::visit(Visitor *visitor) const
 {
-  auto bp = bl.cbegin();
+  auto bp = bl.get().cbegin();
   try {
     while (!bp.end()) {
       DECODE_START(max_required_version, bp);
@@ -3967,7 +3971,7 @@ void ObjectModDesc::encode(bufferlist &_bl) const
   ENCODE_START(max_required_version, max_required_version, _bl);
   encode(can_local_rollback, _bl);
   encode(rollback_info_completed, _bl);
-  encode(bl, _bl);
+  encode(bl.get(), _bl);
   ENCODE_FINISH(_bl);
 }
 void ObjectModDesc::decode(bufferlist::const_iterator &_bl)
@@ -3976,7 +3980,9 @@ void ObjectModDesc::decode(bufferlist::const_iterator &_bl)
   max_required_version = struct_v;
   decode(can_local_rollback, _bl);
   decode(rollback_info_completed, _bl);
-  decode(bl, _bl);
+  bufferlist b;
+  decode(b, _bl);
+  bl.swap(b);
   // ensure bl does not pin a larger buffer in memory
   bl.rebuild();
   bl.reassign_to_mempool(mempool::mempool_osd_pglog);
@@ -4036,7 +4042,7 @@ void pg_log_entry_t::encode(bufferlist &bl) const
   encode(mtime, bl);
   if (op == LOST_REVERT)
     encode(prior_version, bl);
-  encode(snaps, bl);
+  encode(snaps.get(), bl);
   encode(user_version, bl);
   encode(mod_desc, bl);
   encode(extra_reqids, bl);
@@ -4082,7 +4088,9 @@ void pg_log_entry_t::decode(bufferlist::const_iterator &bl)
   }
   if (struct_v >= 7 ||  // for v >= 7, this is for all ops.
       op == CLONE) {    // for v < 7, it's only present for CLONE.
-    decode(snaps, bl);
+    bufferlist b;
+    decode(b, bl);
+    snaps.swap(b);
     // ensure snaps does not pin a larger buffer in memory
     snaps.rebuild();
     snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
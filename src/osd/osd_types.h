@@ -3257,6 +3257,81 @@ inline ostream& operator<<(ostream& out, const pg_query_t& q) {
   return out;
 }
 
+/**
+ * pg_log_bl_t - a bufferlist which is only allocated once it is used
+ *
+ * Most log entries leave their rollback info and snaps empty.  Rather
+ * than carry an inline bufferlist for each, an entry points to one
+ * allocated from the osd_pglog mempool when something is put in it;
+ * an unset one reads as an empty bufferlist.
+ */
+class pg_log_bl_t {
+public:
+  struct slot_t {
+    MEMPOOL_CLASS_HELPERS();
+    bufferlist bl;
+  };
+
+private:
+  std::unique_ptr<slot_t> slot;
+
+public:
+  pg_log_bl_t() = default;
+  pg_log_bl_t(const pg_log_bl_t &other) {
+    if (other.length())
+      get_mutable() = other.get();
+  }
+  pg_log_bl_t(pg_log_bl_t &&other) = default;
+  pg_log_bl_t &operator=(const pg_log_bl_t &other) {
+    if (this == &other)
+      return *this;
+    if (other.length())
+      get_mutable() = other.get();
+    else
+      clear();
+    return *this;
+  }
+  pg_log_bl_t &operator=(pg_log_bl_t &&other) = default;
+
+  const bufferlist &get() const {
+    static const bufferlist empty;
+    return slot ? slot->bl : empty;
+  }
+  operator const bufferlist&() const {
+    return get();
+  }
+  bufferlist &get_mutable() {
+    if (!slot)
+      slot.reset(new slot_t);
+    return slot->bl;
+  }
+  unsigned length() const {
+    return slot ? slot->bl.length() : 0;
+  }
+  void clear() {
+    slot.reset();
+  }
+  void swap(pg_log_bl_t &other) {
+    slot.swap(other.slot);
+  }
+  void swap(bufferlist &other) {
+    if (!slot && other.length() == 0)
+      return;
+    get_mutable().swap(other);
+  }
+  void reassign_to_mempool(int pool) {
+    if (slot)
+      slot->bl.reassign_to_mempool(pool);
+  }
+  /// copy the contents so that they do not pin a larger buffer
+  void rebuild() {
+    if (length())
+      slot->bl.rebuild();
+    else
+      clear();
+  }
+};
+
 class PGBackend;
 class ObjectModDesc {
   bool can_local_rollback;
@@ -3287,7 +3362,7 @@ public:
     virtual ~Visitor() {}
   };
   void visit(Visitor *visitor) const;
-  mutable bufferlist bl;
+  mutable pg_log_bl_t bl;
   enum ModID {
     APPEND = 1,
     SETATTRS = 2,
@@ -3297,12 +3372,10 @@ public:
     TRY_DELETE = 6,
     ROLLBACK_EXTENTS = 7
   };
-  ObjectModDesc() : can_local_rollback(true), rollback_info_completed(false) {
-    bl.reassign_to_mempool(mempool::mempool_osd_pglog);
-  }
+  ObjectModDesc() : can_local_rollback(true), rollback_info_completed(false) {}
   void claim(ObjectModDesc &other) {
     bl.clear();
-    bl.claim(other.bl);
+    bl.swap(other.bl);
     can_local_rollback = other.can_local_rollback;
     rollback_info_completed = other.rollback_info_completed;
   }
@@ -3313,7 +3386,8 @@ public:
       mark_unrollbackable();
       return;
     }
-    bl.claim_append(other.bl);
+    if (other.bl.length())
+      bl.get_mutable().claim_append(other.bl.get_mutable());
     rollback_info_completed = other.rollback_info_completed;
   }
   void swap(ObjectModDesc &other) {
@@ -3327,41 +3401,45 @@ public:
   void append_id(ModID id) {
     using ceph::encode;
     uint8_t _id(id);
-    encode(_id, bl);
+    encode(_id, bl.get_mutable());
   }
   void append(uint64_t old_size) {
     if (!can_local_rollback || rollback_info_completed)
       return;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(APPEND);
-    encode(old_size, bl);
-    ENCODE_FINISH(bl);
+    encode(old_size, b);
+    ENCODE_FINISH(b);
   }
   void setattrs(map<string, boost::optional<bufferlist> > &old_attrs) {
     if (!can_local_rollback || rollback_info_completed)
       return;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(SETATTRS);
-    encode(old_attrs, bl);
-    ENCODE_FINISH(bl);
+    encode(old_attrs, b);
+    ENCODE_FINISH(b);
   }
   bool rmobject(version_t deletion_version) {
     if (!can_local_rollback || rollback_info_completed)
       return false;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(DELETE);
-    encode(deletion_version, bl);
-    ENCODE_FINISH(bl);
+    encode(deletion_version, b);
+    ENCODE_FINISH(b);
     rollback_info_completed = true;
     return true;
   }
   bool try_rmobject(version_t deletion_version) {
     if (!can_local_rollback || rollback_info_completed)
       return false;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(TRY_DELETE);
-    encode(deletion_version, bl);
-    ENCODE_FINISH(bl);
+    encode(deletion_version, b);
+    ENCODE_FINISH(b);
     rollback_info_completed = true;
     return true;
   }
@@ -3369,17 +3447,19 @@ public:
     if (!can_local_rollback || rollback_info_completed)
       return;
     rollback_info_completed = true;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(CREATE);
-    ENCODE_FINISH(bl);
+    ENCODE_FINISH(b);
   }
   void update_snaps(const set<snapid_t> &old_snaps) {
     if (!can_local_rollback || rollback_info_completed)
       return;
-    ENCODE_START(1, 1, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(1, 1, b);
     append_id(UPDATE_SNAPS);
-    encode(old_snaps, bl);
-    ENCODE_FINISH(bl);
+    encode(old_snaps, b);
+    ENCODE_FINISH(b);
   }
   void rollback_extents(
     version_t gen, const vector<pair<uint64_t, uint64_t> > &extents) {
@@ -3387,11 +3467,12 @@ public:
     ceph_assert(!rollback_info_completed);
     if (max_required_version < 2)
       max_required_version = 2;
-    ENCODE_START(2, 2, bl);
+    bufferlist &b = bl.get_mutable();
+    ENCODE_START(2, 2, b);
     append_id(ROLLBACK_EXTENTS);
-    encode(gen, bl);
-    encode(extents, bl);
-    ENCODE_FINISH(bl);
+    encode(gen, b);
+    encode(extents, b);
+    ENCODE_FINISH(b);
   }
 
   // cannot be rolled back
@@ -3416,8 +3497,7 @@ public:
    * message buffer
    */
   void trim_bl() const {
-    if (bl.length() > 0)
-      bl.rebuild();
+    bl.rebuild();
   }
   void encode(bufferlist &bl) const;
   void decode(bufferlist::const_iterator &bl);
@@ -3474,7 +3554,7 @@ struct pg_log_entry_t {
 
   // describes state for a locally-rollbackable entry
   ObjectModDesc mod_desc;
-  bufferlist snaps;   // only for clone entries
+  pg_log_bl_t snaps;   // only for clone entries
   hobject_t  soid;
   osd_reqid_t reqid;  // caller+tid to uniquely identify request
   mempool::osd_pglog::vector<pair<osd_reqid_t, version_t> > extra_reqids;
@@ -3489,9 +3569,7 @@ struct pg_log_entry_t {
 
   pg_log_entry_t()
    : user_version(0), return_code(0), op(0),
-     invalid_hash(false), invalid_pool(false) {
-    snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
-  }
+     invalid_hash(false), invalid_pool(false) {}
   pg_log_entry_t(int _op, const hobject_t& _soid,
                 const eversion_t& v, const eversion_t& pv,
                 version_t uv,
@@ -3499,9 +3577,7 @@ struct pg_log_entry_t {
                 int return_code)
    : soid(_soid), reqid(rid), version(v), prior_version(pv), user_version(uv),
      mtime(mt), return_code(return_code), op(_op),
-     invalid_hash(false), invalid_pool(false) {
-    snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
-  }
+     invalid_hash(false), invalid_pool(false) {}
       
   bool is_clone() const { return op == CLONE; }
   bool is_modify() const { return op == MODIFY; }
@@ -3628,8 +3704,11 @@ public:
   // the actual log
   mempool::osd_pglog::list<pg_log_entry_t> log;
 
-  // entries just for dup op detection ordered oldest to newest
-  mempool::osd_pglog::list<pg_log_dup_t> dups;
+  // entries just for dup op detection ordered oldest to newest; dups
+  // are only added or removed at either end, so they are kept packed
+  // in a deque rather than a node per entry, and pointers to them
+  // (see PGLog::IndexedLog::dup_index) stay valid
+  mempool::osd_pglog::deque<pg_log_dup_t> dups;
 
   pg_log_t() = default;
   pg_log_t(const eversion_t &last_update,
@@ -3637,7 +3716,7 @@ public:
 	   const eversion_t &can_rollback_to,
 	   const eversion_t &rollback_info_trimmed_to,
 	   mempool::osd_pglog::list<pg_log_entry_t> &&entries,
-	   mempool::osd_pglog::list<pg_log_dup_t> &&dup_entries)
+	   mempool::osd_pglog::deque<pg_log_dup_t> &&dup_entries)
     : head(last_update), tail(log_tail), can_rollback_to(can_rollback_to),
       rollback_info_trimmed_to(rollback_info_trimmed_to),
       log(std::move(entries)), dups(std::move(dup_entries)) {}
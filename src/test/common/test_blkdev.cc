@@ -127,4 +127,15 @@ TEST(blkdev, is_rotational)
   ASSERT_TRUE(block_device_is_rotational("sdb"));
 }
 
+TEST(blkdev, numa_node)
+{
+  const char* env = getenv("CEPH_ROOT");
+  ASSERT_NE(env, nullptr) << "Environment Variable CEPH_ROOT not found!";
+  string root = string(env) + "/src/test/common/test_blkdev_sys_block";
+  set_block_device_sandbox_dir(root.c_str());
+
+  ASSERT_EQ(1, block_device_numa_node("sda"));
+  ASSERT_GT(0, block_device_numa_node("sdb"));
+}
+
 
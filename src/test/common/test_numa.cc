@@ -0,0 +1,34 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <errno.h>
+#include <gtest/gtest.h>
+
+#include "common/numa.h"
+#include "include/stringify.h"
+
+TEST(numa, cpu_set_list)
+{
+  cpu_set_t cpu_set;
+  size_t size = 0;
+  ASSERT_EQ(0, parse_cpu_set_list("0-3,8,10-11\n", &size, &cpu_set));
+  ASSERT_EQ(12u, size);
+  ASSERT_TRUE(CPU_ISSET(0, &cpu_set));
+  ASSERT_TRUE(CPU_ISSET(3, &cpu_set));
+  ASSERT_FALSE(CPU_ISSET(4, &cpu_set));
+  ASSERT_TRUE(CPU_ISSET(8, &cpu_set));
+  ASSERT_FALSE(CPU_ISSET(9, &cpu_set));
+  ASSERT_EQ("0-3,8,10-11", cpu_set_to_str_list(size, &cpu_set));
+
+  ASSERT_EQ(0, parse_cpu_set_list("5", &size, &cpu_set));
+  ASSERT_EQ(6u, size);
+  ASSERT_EQ("5", cpu_set_to_str_list(size, &cpu_set));
+
+  ASSERT_EQ(-EINVAL, parse_cpu_set_list("a", &size, &cpu_set));
+  ASSERT_EQ(-EINVAL, parse_cpu_set_list("3-1", &size, &cpu_set));
+  ASSERT_EQ(-EINVAL, parse_cpu_set_list("1;2", &size, &cpu_set));
+  ASSERT_EQ(-EINVAL, parse_cpu_set_list(
+	      stringify(CPU_SETSIZE).c_str(), &size, &cpu_set));
+  ASSERT_EQ(-EINVAL, parse_cpu_set_list(
+	      ("0-" + stringify(CPU_SETSIZE)).c_str(), &size, &cpu_set));
+}
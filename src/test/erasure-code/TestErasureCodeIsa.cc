@@ -874,6 +874,55 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  // the parity update must match a full re-encoding, both for the
+  // matrix codec and for the (k,1) xor codec
+  for (const char *m : { "1", "3" }) {
+    ErasureCodeIsaDefault Isa(tcache);
+    ErasureCodeProfile profile;
+    profile["k"] = "4";
+    profile["m"] = m;
+    EXPECT_EQ(0, Isa.init(profile, &cerr));
+    EXPECT_TRUE(Isa.supports_parity_delta());
+
+    const int k = 4;
+    const int chunks = Isa.get_chunk_count();
+    unsigned object_size = Isa.get_alignment() * k;
+    bufferlist in;
+    for (unsigned i = 0; i < object_size; i++)
+      in.append((char) (i * 13 + 5));
+    set<int> want_to_encode;
+    for (int i = 0; i < chunks; i++)
+      want_to_encode.insert(i);
+    map<int, bufferlist> encoded;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, in, &encoded));
+    unsigned length = encoded[0].length();
+
+    // overwrite data chunk 2 and re-encode from scratch
+    bufferlist out;
+    out.substr_of(in, 0, 2 * length);
+    out.append(string(length, 'X'));
+    bufferlist tail;
+    tail.substr_of(in, 3 * length, length);
+    out.append(tail);
+    map<int, bufferlist> expected;
+    EXPECT_EQ(0, Isa.encode(want_to_encode, out, &expected));
+
+    map<int, bufferlist> delta;
+    bufferptr d(length);
+    for (unsigned j = 0; j < length; j++)
+      d[j] = encoded[2][j] ^ expected[2][j];
+    delta[2].push_back(d);
+    map<int, bufferlist> parity;
+    for (int i = k; i < chunks; i++)
+      parity[i] = encoded[i];
+    EXPECT_EQ(0, Isa.apply_parity_delta(delta, &parity));
+    for (int i = k; i < chunks; i++)
+      EXPECT_TRUE(parity[i].contents_equal(expected[i]));
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
@@ -277,6 +277,73 @@ TEST(ErasureCodeTest, encode)
   }
 }
 
+template <typename T>
+void check_parity_delta(const char *w)
+{
+  T jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "4";
+  profile["m"] = "2";
+  profile["w"] = w;
+  EXPECT_EQ(0, jerasure.init(profile, &cerr));
+  EXPECT_TRUE(jerasure.supports_parity_delta());
+
+  unsigned object_size = jerasure.get_alignment() * 4;
+  bufferlist in;
+  for (unsigned i = 0; i < object_size; i++)
+    in.append((char)(i * 7 + 3));
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < jerasure.get_chunk_count(); i++)
+    want_to_encode.insert(i);
+  map<int, bufferlist> encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, in, &encoded));
+  unsigned length = encoded[0].length();
+
+  // overwrite data chunks 1 and 3 and re-encode from scratch
+  bufferlist out;
+  out.substr_of(in, 0, length);
+  out.append(string(length, 'Y'));
+  bufferlist middle;
+  middle.substr_of(in, 2 * length, length);
+  out.append(middle);
+  out.append(string(length, 'Z'));
+  map<int, bufferlist> expected;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, out, &expected));
+
+  map<int, bufferlist> delta;
+  for (int i : { 1, 3 }) {
+    bufferptr d(length);
+    for (unsigned j = 0; j < length; j++)
+      d[j] = encoded[i][j] ^ expected[i][j];
+    delta[i].push_back(d);
+  }
+  map<int, bufferlist> parity;
+  parity[4] = encoded[4];
+  parity[5] = encoded[5];
+  EXPECT_EQ(0, jerasure.apply_parity_delta(delta, &parity));
+  EXPECT_TRUE(parity[4].contents_equal(expected[4]));
+  EXPECT_TRUE(parity[5].contents_equal(expected[5]));
+  // the original coding chunks are left untouched
+  EXPECT_FALSE(encoded[4].contents_equal(expected[4]));
+
+  // all coding chunks must be provided
+  parity.erase(5);
+  EXPECT_EQ(-EINVAL, jerasure.apply_parity_delta(delta, &parity));
+}
+
+TEST(ErasureCodeTest, parity_delta)
+{
+  for (const char *w : { "8", "16", "32" }) {
+    check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>(w);
+    check_parity_delta<ErasureCodeJerasureReedSolomonRAID6>(w);
+  }
+
+  ErasureCodeJerasureCauchyGood jerasure;
+  EXPECT_FALSE(jerasure.supports_parity_delta());
+  map<int, bufferlist> delta, parity;
+  EXPECT_EQ(-EOPNOTSUPP, jerasure.apply_parity_delta(delta, &parity));
+}
+
 TEST(ErasureCodeTest, create_rule)
 {
   std::unique_ptr<CrushWrapper> c = std::make_unique<CrushWrapper>();
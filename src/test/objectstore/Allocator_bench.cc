@@ -329,10 +329,111 @@ TEST_P(AllocTest, test_alloc_bench_10_300)
   doOverwriteTest(capacity, prefill, overwrite);
 }
 
+/*
+ * Replays the same deterministic trace against every allocator. The trace
+ * mimics an aged RBD OSD: the device is first filled with a mix of 4M
+ * object writes and small 4K-64K writes, then most of it is churned with
+ * small overwrites that release random fragments, and finally large
+ * (up to 4M) extents are requested like _do_write_big does.
+ */
+TEST_P(AllocTest, test_alloc_bench_fragmented_trace)
+{
+  uint64_t capacity = uint64_t(256) * 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 4096;
+  uint64_t max_alloc_size = 4 * _1m;
+  PExtentVector tmp;
+  AllocTracker at(capacity, alloc_unit);
+
+  init_alloc(capacity, alloc_unit);
+  alloc->init_add_free(0, capacity);
+
+  gen_type rng(0x1234); // fixed seed, the trace must be identical per run
+  boost::uniform_int<> small(0, 4); // 4K-64K
+  boost::uniform_int<> kind(0, 9);
+
+  auto do_alloc = [&](uint64_t want, uint64_t max) {
+    tmp.clear();
+    auto r = alloc->allocate(want, alloc_unit, max, 0, &tmp);
+    if (r > 0) {
+      for (auto& a : tmp) {
+	bool full = !at.push(a.offset, a.length);
+	EXPECT_EQ(full, false);
+      }
+    }
+    return r;
+  };
+  auto do_release = [&](uint64_t want_release) {
+    uint64_t released = 0;
+    do {
+      uint64_t o = 0;
+      uint32_t l = 0;
+      interval_set<uint64_t> release_set;
+      if (!at.pop_random(rng, &o, &l, want_release - released)) {
+	break;
+      }
+      release_set.insert(o, l);
+      alloc->release(release_set);
+      released += l;
+    } while (released < want_release);
+  };
+
+  utime_t start = ceph_clock_now();
+  // prefill 80%, one in five writes is a small one
+  for (uint64_t i = 0; i < capacity / 10 * 8; ) {
+    uint64_t want = kind(rng) < 2 ? alloc_unit << small(rng) : 4 * _1m;
+    auto r = do_alloc(want, max_alloc_size);
+    if (r < (int64_t)want) {
+      break;
+    }
+    i += r;
+  }
+  utime_t prefilled = ceph_clock_now();
+
+  // churn 50% of the capacity with small overwrites
+  uint64_t failed = 0;
+  for (uint64_t i = 0; i < capacity / 2; ) {
+    uint64_t want = alloc_unit << small(rng);
+    do_release(want);
+    auto r = do_alloc(want, max_alloc_size);
+    if (r < (int64_t)want) {
+      ++failed;
+      break;
+    }
+    i += r;
+  }
+  utime_t churned = ceph_clock_now();
+
+  // big writes on the aged free space
+  uint64_t big_allocs = 0;
+  uint64_t big_extents = 0;
+  for (uint64_t i = 0; i < capacity / 20; ) {
+    do_release(4 * _1m);
+    auto r = do_alloc(4 * _1m, max_alloc_size);
+    if (r < (int64_t)(4 * _1m)) {
+      ++failed;
+      break;
+    }
+    ++big_allocs;
+    big_extents += tmp.size();
+    i += r;
+  }
+  utime_t end = ceph_clock_now();
+
+  std::cout << "prefill in " << prefilled - start
+	    << ", churn in " << churned - prefilled
+	    << ", big writes in " << end - churned << std::endl;
+  std::cout << "Avail " << alloc->get_free() / _1m << " MB"
+	    << ", fragmentation " << alloc->get_fragmentation(alloc_unit)
+	    << ", extents per 4M write "
+	    << (big_allocs ? (double)big_extents / big_allocs : 0.0)
+	    << ", failures " << failed << std::endl;
+  dump_mempools();
+}
+
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "avl"));
 
 #else
 
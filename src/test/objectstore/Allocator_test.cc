@@ -318,10 +318,50 @@ TEST_P(AllocTest, test_alloc_bug_24598)
   EXPECT_EQ(1u, tmp.size());
 }
 
+TEST_P(AllocTest, test_alloc_foreach)
+{
+  uint64_t capacity = 1024 * 1024 * 1024;
+  uint64_t alloc_unit = 0x1000;
+
+  init_alloc(capacity, alloc_unit);
+
+  interval_set<uint64_t> expected;
+  alloc->init_add_free(0, 0x100000);
+  expected.insert(0, 0x100000);
+  alloc->init_add_free(0x200000, 0x3000);
+  expected.insert(0x200000, 0x3000);
+  alloc->init_add_free(0x300000, 0x20000000);
+  expected.insert(0x300000, 0x20000000);
+
+  PExtentVector extents;
+  EXPECT_EQ(0x10000, alloc->allocate(0x10000, alloc_unit, 0, &extents));
+  for (auto& e : extents) {
+    expected.erase(e.offset, e.length);
+  }
+
+  interval_set<uint64_t> seen;
+  alloc->foreach([&](uint64_t offset, uint64_t length) {
+      seen.insert(offset, length);
+    });
+  EXPECT_EQ(expected, seen);
+  EXPECT_EQ(alloc->get_free(), seen.size());
+
+  // feeding the result into a fresh allocator reproduces the same state
+  init_alloc(capacity, alloc_unit);
+  for (auto p = seen.begin(); p != seen.end(); ++p) {
+    alloc->init_add_free(p.get_start(), p.get_len());
+  }
+  interval_set<uint64_t> reloaded;
+  alloc->foreach([&](uint64_t offset, uint64_t length) {
+      reloaded.insert(offset, length);
+    });
+  EXPECT_EQ(seen, reloaded);
+}
+
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap"));
+  ::testing::Values("stupid", "bitmap", "avl"));
 
 #else
 
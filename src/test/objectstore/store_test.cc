@@ -35,6 +35,7 @@
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/errno.h"
+#include "common/ceph_json.h"
 #include "include/stringify.h"
 #include "include/coredumpctl.h"
 
@@ -3351,6 +3352,104 @@ TEST_P(StoreTest, ManyObjectTest) {
   }
 }
 
+TEST_P(StoreTest, CollectionRemoveRange) {
+  int r = 0;
+  spg_t pgid(pg_t(1, 0), shard_id_t::NO_SHARD);
+  coll_t cid(pgid);
+  ghobject_t pgmeta = pgid.make_pgmeta_oid();
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.touch(cid, pgmeta);
+    map<string, bufferlist> km;
+    km["info"].append("pgmeta");
+    t.omap_setkeys(cid, pgmeta, km);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // mix small and big omaps so both removal paths are exercised; give
+  // every object data as well, as PG objects usually have
+  for (int i = 0; i < 40; ++i) {
+    ObjectStore::Transaction t;
+    ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					CEPH_NOSNAP),
+			      string(), i, 1, ""));
+    bufferlist bl;
+    bl.append(std::string(8192, 'a' + (i % 26)));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    map<string, bufferlist> km;
+    int nkeys = (i % 2) ? 200 : 2;
+    for (int k = 0; k < nkeys; ++k) {
+      km["key" + stringify(k)].append("value");
+    }
+    t.omap_setkeys(cid, hoid, km);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  const PerfCounters* logger = nullptr;
+  uint64_t rmrange = 0;
+  if (string(GetParam()) == "bluestore") {
+    logger = store->get_perf_counters();
+    rmrange = logger->get(l_bluestore_bulk_remove_omap_rmrange);
+  }
+
+  vector<ghobject_t> ls;
+  ghobject_t next;
+  r = store->collection_list(ch, ghobject_t(), ghobject_t::get_max(), 20,
+			     &ls, &next);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(20u, ls.size());
+  {
+    ObjectStore::Transaction t;
+    t.collection_remove_range(cid, ls.front(), next);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (auto& oid : ls) {
+    if (oid != pgmeta) {
+      ASSERT_FALSE(store->exists(ch, oid));
+    }
+  }
+  ls.clear();
+  r = store->collection_list(ch, ghobject_t(), ghobject_t::get_max(),
+			     INT_MAX, &ls, nullptr);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(21u, ls.size()); // 20 objects and pgmeta
+
+  {
+    ObjectStore::Transaction t;
+    t.collection_remove_range(cid, ghobject_t(), ghobject_t::get_max());
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ls.clear();
+  r = store->collection_list(ch, ghobject_t(), ghobject_t::get_max(),
+			     INT_MAX, &ls, nullptr);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(1u, ls.size());
+  ASSERT_EQ(pgmeta, ls.front());
+  if (logger) {
+    // every object with a big omap went through a range delete
+    ASSERT_EQ(rmrange + 20, logger->get(l_bluestore_bulk_remove_omap_rmrange));
+  }
+  {
+    bufferlist h;
+    map<string, bufferlist> km;
+    r = store->omap_get(ch, pgmeta, &h, &km);
+    ASSERT_EQ(r, 0);
+    ASSERT_EQ(1u, km.size());
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, pgmeta);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 
 class ObjectGenerator {
 public:
@@ -4481,6 +4580,7 @@ TEST_P(StoreTestSpecificAUSize, SyntheticMatrixPreferDeferred) {
     { "bluestore_max_blob_size", "262144", 0 },
     { "bluestore_compression_mode", "force", "none", 0},
     { "bluestore_prefer_deferred_size", "32768", "0", 0},
+    { "bluestore_deferred_batch_adaptive", "true", "false", 0},
     { 0 },
   };
   do_matrix(m, std::bind(&StoreTest::doSyntheticTest, this, _1, _2, _3, _4));
@@ -6115,6 +6215,445 @@ TEST_P(StoreTestSpecificAUSize, OnodeSizeTracking) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, ClockCache) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  SetVal(g_conf(), "bluestore_cache_type", "clock");
+  SetVal(g_conf(), "bluestore_cache_clock_trim_batch", "4");
+  StartDeferred(block_size);
+  // small enough that the trimmer has to evict while we run
+  SetVal(g_conf(), "bluestore_cache_size_hdd", "4000000");
+  SetVal(g_conf(), "bluestore_cache_size_ssd", "4000000");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  const unsigned num_objs = 200;
+  for (unsigned i = 0; i < num_objs; ++i) {
+    ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(std::string(block_size * 4, 'a' + (i % 26)));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (unsigned pass = 0; pass < 3; ++pass) {
+    for (unsigned i = 0; i < num_objs; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					  CEPH_NOSNAP)));
+      bufferlist bl, expected;
+      expected.append(std::string(block_size * 4, 'a' + (i % 26)));
+      r = store->read(ch, hoid, 0, expected.length(), bl);
+      ASSERT_EQ(r, (int)expected.length());
+      ASSERT_TRUE(bl_eq(expected, bl));
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < num_objs; ++i) {
+      t.remove(cid, ghobject_t(hobject_t(sobject_t("Object " + stringify(i),
+						     CEPH_NOSNAP))));
+    }
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, TxcTrace) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  SetVal(g_conf(), "bluestore_txc_trace_size", "16");
+  StartDeferred(block_size);
+
+  int r;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // more txcs than the ring holds, so it wraps
+  for (unsigned i = 0; i < 40; ++i) {
+    ghobject_t hoid(hobject_t(sobject_t("Object " + stringify(i),
+					CEPH_NOSNAP)));
+    bufferlist bl;
+    bl.append(std::string(block_size, 'a' + (i % 26)));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_TRUE(bstore);
+  {
+    JSONFormatter f;
+    f.open_object_section("trace");
+    bstore->dump_txc_trace(&f);
+    f.close_section();
+    stringstream ss;
+    f.flush(ss);
+    JSONParser parser;
+    ASSERT_TRUE(parser.parse(ss.str().c_str(), ss.str().size()));
+    JSONObj *txcs = parser.find_obj("txcs");
+    ASSERT_TRUE(txcs);
+    unsigned n = 0;
+    for (auto it = txcs->find_first(); !it.end(); ++it) {
+      ASSERT_TRUE((*it)->find_obj("state_lat_usec"));
+      ASSERT_TRUE((*it)->find_obj("state_lat_usec")->find_obj("kv_committing"));
+      ++n;
+    }
+    // the last txcs may still be finishing
+    ASSERT_GT(n, 0u);
+    ASSERT_LE(n, 16u);
+  }
+  {
+    JSONFormatter f;
+    f.open_object_section("hist");
+    bstore->dump_txc_histograms(&f);
+    f.close_section();
+    stringstream ss;
+    f.flush(ss);
+    JSONParser parser;
+    ASSERT_TRUE(parser.parse(ss.str().c_str(), ss.str().size()));
+    JSONObj *h = parser.find_obj("txc_histograms");
+    ASSERT_TRUE(h);
+    string num_txcs = h->find_obj("num_txcs")->get_data();
+    ASSERT_NE("0", num_txcs);
+    JSONObj *done = h->find_obj("states")->find_obj("done");
+    ASSERT_TRUE(done);
+    ASSERT_EQ(num_txcs, done->find_obj("count")->get_data());
+    ASSERT_TRUE(h->find_obj("osrs"));
+  }
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < 40; ++i) {
+      t.remove(cid, ghobject_t(hobject_t(sobject_t("Object " + stringify(i),
+						     CEPH_NOSNAP))));
+    }
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, DeferredBatchAdaptive) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 65536;
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", "65536");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "4");
+  SetVal(g_conf(), "bluestore_deferred_batch_adaptive", "true");
+  SetVal(g_conf(), "bluestore_deferred_batch_max_wait", "0.05");
+  StartDeferred(block_size);
+
+  BlueStore* bstore = dynamic_cast<BlueStore*>(store.get());
+  ASSERT_TRUE(bstore);
+  const unsigned num_colls = 8;
+  vector<coll_t> cids;
+  vector<ObjectStore::CollectionHandle> chs;
+  ghobject_t hoid(hobject_t(sobject_t("Object 1", CEPH_NOSNAP)));
+  int r;
+  for (unsigned i = 0; i < num_colls; ++i) {
+    cids.push_back(coll_t(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD)));
+    chs.push_back(store->create_new_collection(cids.back()));
+    ObjectStore::Transaction t;
+    t.create_collection(cids.back(), 0);
+    bufferlist bl;
+    bl.append(std::string(block_size, 'a'));
+    t.write(cids.back(), hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, chs.back(), std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (auto& ch : chs) {
+    ch->flush();
+  }
+  const int base = bstore->get_deferred_batch_target();
+  ASSERT_EQ(4, base);
+
+  // small overwrites from several sequencers keep batches in flight,
+  // which raises the number of txcs the next batch waits for
+  int max_target = base;
+  bufferlist bl;
+  bl.append(std::string(4096, 'b'));
+  for (unsigned i = 0; i < 2000; ++i) {
+    ObjectStore::Transaction t;
+    unsigned c = i % num_colls;
+    t.write(cids[c], hoid, (i * 4096) % block_size, bl.length(), bl);
+    r = queue_transaction(store, chs[c], std::move(t));
+    ASSERT_EQ(r, 0);
+    max_target = std::max(max_target, bstore->get_deferred_batch_target());
+  }
+  cerr << "max deferred batch target " << max_target << std::endl;
+  ASSERT_GT(max_target, base);
+
+  // once idle it falls back to the base size, and partial batches are
+  // submitted instead of waiting for txcs that never come
+  auto wait_idle = [&]() {
+    for (unsigned i = 0; i < 100; ++i) {
+      if (bstore->get_deferred_queue_size() == 0 &&
+	  bstore->get_deferred_batch_target() == base) {
+	return true;
+      }
+      usleep(10000);
+    }
+    return false;
+  };
+  for (auto& ch : chs) {
+    ch->flush();
+  }
+  ASSERT_TRUE(wait_idle());
+  {
+    ObjectStore::Transaction t;
+    t.write(cids[0], hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, chs[0], std::move(t));
+    ASSERT_EQ(r, 0);
+    chs[0]->flush();
+  }
+  ASSERT_TRUE(wait_idle());
+
+  for (unsigned i = 0; i < num_colls; ++i) {
+    ObjectStore::Transaction t;
+    t.remove(cids[i], hoid);
+    t.remove_collection(cids[i]);
+    r = queue_transaction(store, chs[i], std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, DecompressedCache) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  StartDeferred(block_size);
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_default_buffered_read", "false");
+  SetVal(g_conf(), "bluestore_default_buffered_write", "false");
+  SetVal(g_conf(), "bluestore_cache_decompressed", "true");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t("test_hint", "", CEPH_NOSNAP, 0, -1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (char c : { 'a', 'b' }) {
+    bufferlist bl;
+    bl.append(std::string(block_size * 16, c));
+    {
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, 0, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    // the first read decompresses and caches, the second hits the cache
+    uint64_t hits = logger->get(l_bluestore_decompress_cache_hit_bytes);
+    for (int i = 0; i < 2; ++i) {
+      bufferlist in;
+      r = store->read(ch, hoid, 0, bl.length(), in);
+      ASSERT_EQ(r, (int)bl.length());
+      ASSERT_TRUE(bl_eq(bl, in));
+    }
+    ASSERT_EQ(logger->get(l_bluestore_decompress_cache_hit_bytes),
+	      hits + bl.length());
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, DefragOnWrite) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  StartDeferred(block_size);
+  SetVal(g_conf(), "bluestore_compression_mode", "none");
+  SetVal(g_conf(), "bluestore_defrag_extent_threshold", "4");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t("test_hint", "", CEPH_NOSNAP, 0, -1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist expected;
+  expected.append(std::string(block_size * 16, 'a'));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, expected.length(), expected);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // punch every other block with new data, one transaction each
+  for (unsigned i = 0; i < 16; i += 2) {
+    bufferlist bl;
+    bl.append(std::string(block_size, 'b' + i));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, i * block_size, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    bufferlist tail;
+    tail.substr_of(expected, (i + 1) * block_size,
+		   expected.length() - (i + 1) * block_size);
+    bufferlist head;
+    head.substr_of(expected, 0, i * block_size);
+    expected.clear();
+    expected.claim_append(head);
+    expected.claim_append(bl);
+    expected.claim_append(tail);
+  }
+
+  uint64_t candidates = logger->get(l_bluestore_defrag_candidates);
+  uint64_t objects = logger->get(l_bluestore_defrag_objects);
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, expected.length(), in);
+    ASSERT_EQ(r, (int)expected.length());
+    ASSERT_TRUE(bl_eq(expected, in));
+  }
+  ASSERT_EQ(logger->get(l_bluestore_defrag_candidates), candidates + 1);
+
+  // the next write rewrites the object
+  {
+    bufferlist bl;
+    bl.append(std::string(block_size, 'z'));
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, expected.length(), bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    expected.append(bl);
+  }
+  ASSERT_EQ(logger->get(l_bluestore_defrag_objects), objects + 1);
+  ASSERT_GT(logger->get(l_bluestore_defrag_extents_removed), 0u);
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, expected.length(), in);
+    ASSERT_EQ(r, (int)expected.length());
+    ASSERT_TRUE(bl_eq(expected, in));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, ReadSlicedBytes) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  size_t block_size = 4096;
+  StartDeferred(block_size);
+  SetVal(g_conf(), "bluestore_compression_mode", "none");
+  SetVal(g_conf(), "bluestore_default_buffered_read", "false");
+  SetVal(g_conf(), "bluestore_default_buffered_write", "false");
+  g_conf().apply_changes(nullptr);
+
+  int r;
+  coll_t cid;
+  ghobject_t hoid(hobject_t("test_hint", "", CEPH_NOSNAP, 0, -1, ""));
+  const PerfCounters* logger = store->get_perf_counters();
+
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  bufferlist bl;
+  bl.append(std::string(block_size * 16, 'a'));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    // leave a hole between the two extents
+    t.write(cid, hoid, bl.length() * 2, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  {
+    // data read from the device is sliced, never copied
+    uint64_t sliced = logger->get(l_bluestore_read_sliced_bytes);
+    uint64_t copied = logger->get(l_bluestore_read_copied_bytes);
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl.length(), in);
+    ASSERT_EQ(r, (int)bl.length());
+    ASSERT_TRUE(bl_eq(bl, in));
+    ASSERT_EQ(logger->get(l_bluestore_read_sliced_bytes),
+	      sliced + bl.length());
+    ASSERT_EQ(logger->get(l_bluestore_read_copied_bytes), copied);
+  }
+  {
+    // the hole has to be zero filled
+    uint64_t sliced = logger->get(l_bluestore_read_sliced_bytes);
+    uint64_t copied = logger->get(l_bluestore_read_copied_bytes);
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl.length() * 3, in);
+    ASSERT_EQ(r, (int)bl.length() * 3);
+    ASSERT_EQ(logger->get(l_bluestore_read_sliced_bytes),
+	      sliced + bl.length() * 2);
+    ASSERT_EQ(logger->get(l_bluestore_read_copied_bytes),
+	      copied + bl.length());
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    cerr << "Cleaning" << std::endl;
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwrite) {
 
   if (string(GetParam()) != "bluestore")
@@ -7253,6 +7792,223 @@ TEST_P(StoreTestSpecificAUSize, BluestoreTinyDevFailure2) {
   store->mount();
 }
 
+TEST_P(StoreTestSpecificAUSize, BluestoreTierTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_block_size",
+    stringify(4ull * 1024 * 1024 * 1024).c_str());
+  SetVal(g_conf(), "bluestore_block_db_size",
+    stringify(1024 * 1024 * 1024).c_str());
+  SetVal(g_conf(), "bluestore_block_db_create", "true");
+  SetVal(g_conf(), "bluestore_tier", "true");
+  SetVal(g_conf(), "bluestore_tier_promote_reads", "2");
+  SetVal(g_conf(), "bluestore_tier_db_min_free_ratio", "0");
+  StartDeferred(0x1000);
+
+  int r;
+  auto logger = store->get_perf_counters();
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("hot", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  bufferlist bl, bl2;
+  bl.append(string(0x2000, 'a'));
+  bl2.append(string(0x2000, 'b'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  for (int i = 0; i < 2; ++i) {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl.length(), in);
+    ASSERT_EQ((int)bl.length(), r);
+    ASSERT_TRUE(bl_eq(bl, in));
+  }
+  // wait for the tier thread to pick it up and commit the copy
+  for (int i = 0; i < 100 && !logger->get(l_bluestore_tier_promote); ++i) {
+    usleep(100000);
+  }
+  ASSERT_EQ(1u, logger->get(l_bluestore_tier_promote));
+  ASSERT_EQ(bl.length(), logger->get(l_bluestore_tier_bytes));
+  bufferlist tail;
+  tail.substr_of(bl, 0x1000, 0x1000);
+  for (int i = 0; i < 100 && !logger->get(l_bluestore_tier_hit); ++i) {
+    bufferlist in;
+    r = store->read(ch, hoid, 0x1000, 0x1000, in);
+    ASSERT_EQ(0x1000, r);
+    ASSERT_TRUE(bl_eq(tail, in));
+    usleep(10000);
+  }
+  ASSERT_LT(0u, logger->get(l_bluestore_tier_hit));
+
+  // the copy must survive a remount and go away on overwrite
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  ASSERT_EQ(bl.length(), logger->get(l_bluestore_tier_bytes));
+  {
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl2.length(), bl2);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ASSERT_EQ(0u, logger->get(l_bluestore_tier_bytes));
+  {
+    bufferlist in;
+    r = store->read(ch, hoid, 0, bl2.length(), in);
+    ASSERT_EQ((int)bl2.length(), r);
+    ASSERT_TRUE(bl_eq(bl2, in));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTestSpecificAUSize, BluestoreTierOverwriteTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_block_size",
+    stringify(4ull * 1024 * 1024 * 1024).c_str());
+  SetVal(g_conf(), "bluestore_block_db_size",
+    stringify(1024 * 1024 * 1024).c_str());
+  SetVal(g_conf(), "bluestore_block_db_create", "true");
+  SetVal(g_conf(), "bluestore_tier", "true");
+  SetVal(g_conf(), "bluestore_tier_promote_reads", "2");
+  SetVal(g_conf(), "bluestore_tier_db_min_free_ratio", "0");
+  StartDeferred(0x1000);
+
+  int r;
+  auto logger = store->get_perf_counters();
+  coll_t cid;
+  ghobject_t hoid(hobject_t(sobject_t("hot", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  // every overwrite keeps the size and drops the copy while the read
+  // counts that follow ask for a new one, so reads race promotions
+  // whose copy is not committed yet against keys of older contents
+  const unsigned len = 0x2000;
+  for (unsigned i = 0; i < 200; ++i) {
+    bufferlist bl;
+    bl.append(string(len, 'a' + i % 26));
+    {
+      ObjectStore::Transaction t;
+      t.write(cid, hoid, 0, bl.length(), bl);
+      r = queue_transaction(store, ch, std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+    for (unsigned j = 0; j < 8; ++j) {
+      bufferlist in;
+      r = store->read(ch, hoid, 0, len, in);
+      ASSERT_EQ((int)len, r);
+      ASSERT_TRUE(bl_eq(bl, in)) << "stale read after overwrite " << i;
+      if (j % 2) {
+	usleep(1000);
+      }
+    }
+  }
+  ASSERT_LT(0u, logger->get(l_bluestore_tier_promote));
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
+TEST_P(StoreTest, BluestoreAllocSnapshotTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  int r;
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  ASSERT_TRUE(bstore);
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  auto write_objects = [&](unsigned first, unsigned step) {
+    ObjectStore::Transaction t;
+    for (unsigned i = first; i < 32; i += step) {
+      ghobject_t hoid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+      bufferlist bl;
+      bl.append(string(0x10000 * (i % 4 + 1), 'a' + i % 26));
+      t.write(cid, hoid, 0, bl.length(), bl);
+    }
+    return queue_transaction(store, ch, std::move(t));
+  };
+  auto remove_objects = [&](unsigned first, unsigned step) {
+    ObjectStore::Transaction t;
+    for (unsigned i = first; i < 32; i += step) {
+      ghobject_t hoid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+      t.remove(cid, hoid);
+    }
+    return queue_transaction(store, ch, std::move(t));
+  };
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // leave holes behind so the free space is fragmented
+  ASSERT_EQ(0, write_objects(0, 1));
+  ASSERT_EQ(0, remove_objects(0, 2));
+
+  stringstream ss;
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  // the snapshot is only trusted while older versions are locked out
+  EXPECT_EQ(0, bstore->check_alloc_snapshot(ss));
+  EXPECT_EQ(0, bstore->rebuild_alloc_snapshot(ss));
+  EXPECT_EQ(0, bstore->check_alloc_snapshot(ss));
+
+  // an allocator loaded from the snapshot must stay in sync with the
+  // freelist, which the snapshot written at the next umount reflects
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  ASSERT_EQ(0, write_objects(0, 2));
+  ASSERT_EQ(0, remove_objects(1, 4));
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(0, bstore->check_alloc_snapshot(ss));
+
+  // mounting discards the snapshot, which is only rewritten if enabled
+  SetVal(g_conf(), "bluestore_alloc_snapshot", "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  EXPECT_EQ(store->mount(), 0);
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(-ENOENT, bstore->check_alloc_snapshot(ss));
+  cout << ss.str();
+  ASSERT_NE(string::npos, ss.str().find("no allocator snapshot"));
+
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    for (unsigned i = 0; i < 32; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+      t.remove(cid, hoid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, SpuriousReadErrorTest) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -7315,6 +8071,60 @@ TEST_P(StoreTest, SpuriousReadErrorTest) {
   }
 }
 
+TEST_P(StoreTest, BluestoreParallelDeepFsckTest) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_fsck_on_mount", "false");
+  SetVal(g_conf(), "bluestore_fsck_on_umount", "false");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  BlueStore* bstore = dynamic_cast<BlueStore*> (store.get());
+  ASSERT_TRUE(bstore);
+  const unsigned num_objects = 32;
+  coll_t cid;
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    for (unsigned i = 0; i < num_objects; ++i) {
+      ghobject_t hoid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+      bufferlist bl;
+      bl.append(string(0x10000, 'a' + i % 26));
+      t.write(cid, hoid, 0, bl.length(), bl);
+    }
+    int r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  bstore->inject_leaked(0x30000);
+  EXPECT_EQ(store->umount(), 0);
+
+  // the metadata error is found no matter how the data is read
+  auto deep_fsck = [&](const char *threads) {
+    SetVal(g_conf(), "bluestore_fsck_threads", threads);
+    g_ceph_context->_conf.apply_changes(nullptr);
+    return bstore->fsck(true);
+  };
+  ASSERT_EQ(1, deep_fsck("1"));
+  ASSERT_EQ(1, deep_fsck("4"));
+
+  // every object fails its read, and each failure is counted once
+  SetVal(g_conf(), "bluestore_retry_disk_reads", "0");
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "1");
+  ASSERT_EQ(1 + (int)num_objects, deep_fsck("1"));
+  ASSERT_EQ(1 + (int)num_objects, deep_fsck("4"));
+  // a shallow fsck does not read the data
+  ASSERT_EQ(1, bstore->fsck(false));
+
+  SetVal(g_conf(), "bluestore_debug_inject_csum_err_probability", "0");
+  SetVal(g_conf(), "bluestore_fsck_threads", "1");
+  g_ceph_context->_conf.apply_changes(nullptr);
+  ASSERT_EQ(0, bstore->repair(false));
+  ASSERT_EQ(0, bstore->fsck(true));
+  EXPECT_EQ(store->mount(), 0);
+}
+
 #endif  // WITH_BLUESTORE
 
 int main(int argc, char **argv) {
@@ -14,6 +14,7 @@
 #include "include/stringify.h"
 #include "include/scope_guard.h"
 #include "common/errno.h"
+#include "common/perf_counters.h"
 #include <gtest/gtest.h>
 
 #include "os/bluestore/BlueFS.h"
@@ -103,6 +104,72 @@ TEST(BlueFS, write_read) {
   rm_temp_bdev(fn);
 }
 
+TEST(BlueFS, read_random_readahead) {
+  uint64_t size = 1048576 * 128;
+  string fn = get_temp_bdev(size);
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+  const unsigned chunk = 4096;
+  const unsigned num_chunks = 1024;
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.mkdir("dir"));
+    ASSERT_EQ(0, fs.open_for_write("dir", "file", &h, false));
+    for (unsigned i = 0; i < num_chunks; ++i) {
+      string s(chunk, (char)('a' + i % 26));
+      h->append(s.c_str(), s.size());
+    }
+    fs.fsync(h);
+    fs.close_writer(h);
+  }
+  {
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("dir", "file", &h, true));
+    char buf[chunk];
+    PerfCounters *logger = fs.get_perf_counters();
+    const uint64_t total = num_chunks * chunk;
+    const uint64_t window = g_conf()->bluefs_readahead_max;
+    // sequential scan, which turns read-ahead on
+    uint64_t ra = logger->get(l_bluefs_readahead_bytes);
+    uint64_t hit = logger->get(l_bluefs_readahead_hit_bytes);
+    for (unsigned i = 0; i < num_chunks; ++i) {
+      ASSERT_EQ((int)chunk, fs.read_random(h, i * chunk, chunk, buf));
+      ASSERT_EQ(string(chunk, (char)('a' + i % 26)), string(buf, chunk));
+    }
+    // everything but the first reads and the first window came from
+    // prefetched data, and nothing was read twice
+    ASSERT_GE(logger->get(l_bluefs_readahead_hit_bytes) - hit,
+	      total - 64 * 1024 - 2 * chunk);
+    ASSERT_LE(logger->get(l_bluefs_readahead_bytes) - ra, total);
+    // random reads drop it again
+    for (int c = num_chunks - 1; c >= 0; c -= 7) {
+      ASSERT_EQ((int)chunk, fs.read_random(h, c * chunk, chunk, buf));
+      ASSERT_EQ(string(chunk, (char)('a' + c % 26)), string(buf, chunk));
+    }
+    // unaligned sequential reads straddle the prefetched windows
+    ra = logger->get(l_bluefs_readahead_bytes);
+    hit = logger->get(l_bluefs_readahead_hit_bytes);
+    uint64_t off = 100;
+    while (off + 1000 < num_chunks * chunk) {
+      ASSERT_EQ(1000, fs.read_random(h, off, 1000, buf));
+      for (unsigned j = 0; j < 1000; ++j) {
+	ASSERT_EQ((char)('a' + (off + j) / chunk % 26), buf[j]);
+      }
+      off += 1000;
+    }
+    ASSERT_GE(logger->get(l_bluefs_readahead_hit_bytes) - hit,
+	      total - 64 * 1024 - 2 * chunk);
+    ASSERT_LE(logger->get(l_bluefs_readahead_bytes) - ra, total + window);
+    delete h;
+  }
+  fs.umount();
+  rm_temp_bdev(fn);
+}
+
 TEST(BlueFS, small_appends) {
   uint64_t size = 1048576 * 128;
   string fn = get_temp_bdev(size);
@@ -345,6 +412,79 @@ TEST(BlueFS, test_flush_3) {
   rm_temp_bdev(fn);
 }
 
+TEST(BlueFS, test_flush_partial_tail_with_readers) {
+  uint64_t size = 1048576 * 128;
+  string fn = get_temp_bdev(size);
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, fn, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.mkdir("dir"));
+
+  const unsigned ro_size = 65536;
+  std::unique_ptr<char[]> ro_data = gen_buffer(ro_size);
+  {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir", "ro", &h, false));
+    h->append(ro_data.get(), ro_size);
+    ASSERT_EQ(0, fs.fsync(h));
+    fs.close_writer(h);
+  }
+
+  // unaligned appends leave a partial tail block behind every fsync, so
+  // each flush waits for the previous aio with the lock dropped while
+  // the other writers flush and the readers read
+  const unsigned num_appends = 200;
+  const unsigned append_size = 1000;
+  std::unique_ptr<char[]> data = gen_buffer(num_appends * append_size);
+  std::atomic<bool> done = {false};
+  auto writer = [&](string file) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir", file, &h, false));
+    for (unsigned i = 0; i < num_appends; ++i) {
+      h->append(data.get() + i * append_size, append_size);
+      ASSERT_EQ(0, fs.fsync(h));
+    }
+    fs.close_writer(h);
+  };
+  auto reader = [&]() {
+    while (!done) {
+      BlueFS::FileReader *h;
+      ASSERT_EQ(0, fs.open_for_read("dir", "ro", &h));
+      bufferlist bl;
+      BlueFS::FileReaderBuffer buf(4096);
+      ASSERT_EQ((int)ro_size, fs.read(h, &buf, 0, ro_size, &bl, NULL));
+      ASSERT_EQ(0, memcmp(ro_data.get(), bl.c_str(), ro_size));
+      delete h;
+    }
+  };
+  std::vector<std::thread> write_threads, read_threads;
+  for (int i = 0; i < NUM_WRITERS; ++i) {
+    write_threads.push_back(std::thread(writer, "file." + stringify(i)));
+  }
+  for (int i = 0; i < 2; ++i) {
+    read_threads.push_back(std::thread(reader));
+  }
+  join_all(write_threads);
+  done = true;
+  join_all(read_threads);
+
+  for (int i = 0; i < NUM_WRITERS; ++i) {
+    BlueFS::FileReader *h;
+    ASSERT_EQ(0, fs.open_for_read("dir", "file." + stringify(i), &h));
+    bufferlist bl;
+    BlueFS::FileReaderBuffer buf(4096);
+    const unsigned len = num_appends * append_size;
+    ASSERT_EQ((int)len, fs.read(h, &buf, 0, len, &bl, NULL));
+    ASSERT_EQ(0, memcmp(data.get(), bl.c_str(), len));
+    delete h;
+  }
+  fs.umount();
+  rm_temp_bdev(fn);
+}
+
 TEST(BlueFS, test_simple_compaction_sync) {
   g_ceph_context->_conf.set_val(
     "bluefs_compact_log_sync",
@@ -306,6 +306,89 @@ TEST(bluestore_blob_t, calc_csum)
   }
 }
 
+TEST(bluestore_blob_t, csum_fragmented)
+{
+  // the same data as one contiguous buffer and as odd-sized fragments, so
+  // that blocks are hashed both straight from memory and via the iterator
+  bufferptr bp(65536);
+  for (unsigned i = 0; i < bp.length(); ++i)
+    bp.c_str()[i] = (i * 7) & 0xff;
+  bufferlist contig, frag;
+  contig.append(bp);
+  for (unsigned off = 0; off < bp.length(); off += 3001) {
+    frag.append(bp.c_str() + off, std::min(3001u, bp.length() - off));
+  }
+  ASSERT_FALSE(frag.is_contiguous());
+
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX;
+       ++csum_type) {
+    for (unsigned order = 9; order <= 14; ++order) {
+      bluestore_blob_t a, b;
+      a.init_csum(csum_type, order, contig.length());
+      b.init_csum(csum_type, order, contig.length());
+      a.calc_csum(0, contig);
+      b.calc_csum(0, frag);
+      ASSERT_EQ(0, a.csum_data.cmp(b.csum_data));
+
+      int bad_off;
+      uint64_t bad_csum;
+      ASSERT_EQ(0, a.verify_csum(0, frag, &bad_off, &bad_csum));
+      ASSERT_EQ(-1, bad_off);
+
+      // corrupt a block that straddles two fragments
+      bufferlist bad;
+      bad.append(bp.c_str(), 3001);
+      bad.append("x", 1);
+      bad.append(bp.c_str() + 3002, bp.length() - 3002);
+      ASSERT_EQ(0, a.verify_csum(0, bad, &bad_off, &bad_csum));
+      ASSERT_EQ((int)(3001 & ~((1u << order) - 1)), bad_off);
+    }
+  }
+}
+
+TEST(bluestore_blob_t, csum_verify_bench)
+{
+  // contiguous buffers take the direct path; fragments one byte shorter
+  // than the csum block force every block through the iterator
+  bufferptr bp(4194304);
+  for (char *a = bp.c_str(); a < bp.c_str() + bp.length(); ++a)
+    *a = (unsigned long)a & 0xff;
+  bufferlist contig;
+  contig.append(bp);
+  int count = 64;
+  for (unsigned csum_type = Checksummer::CSUM_NONE + 1;
+       csum_type < Checksummer::CSUM_MAX;
+       ++csum_type) {
+    for (unsigned order = 9; order <= 16; ++order) {
+      unsigned frag_len = (1u << order) - 1;
+      bufferlist frag;
+      for (unsigned off = 0; off < bp.length(); off += frag_len) {
+	frag.append(bp, off, std::min(frag_len, bp.length() - off));
+      }
+      bluestore_blob_t b;
+      b.init_csum(csum_type, order, contig.length());
+      b.calc_csum(0, contig);
+      for (auto bl : { &frag, &contig }) {
+	int bad_off;
+	uint64_t bad_csum;
+	auto start = ceph::mono_clock::now();
+	for (int i = 0; i < count; ++i) {
+	  b.verify_csum(0, *bl, &bad_off, &bad_csum);
+	}
+	auto dur = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	  ceph::mono_clock::now() - start);
+	double mbsec = (double)count * (double)bl->length() / 1000000.0 /
+	  (double)dur.count() * 1000000000.0;
+	cout << "csum_type " << Checksummer::get_csum_type_string(csum_type)
+	     << " order " << order
+	     << (bl == &contig ? " contiguous " : " fragmented ")
+	     << mbsec << " MB/sec" << std::endl;
+      }
+    }
+  }
+}
+
 TEST(bluestore_blob_t, csum_bench)
 {
   bufferlist bl;
@@ -1542,6 +1625,48 @@ TEST(BlueStoreRepairer, StoreSpaceTracker)
   ASSERT_TRUE(bmap2.is_used(hoid, 0x3223b19ffff));
 }
 
+TEST(ClockCache, trim_all_pinned)
+{
+  // small batches and a skip limit above the ring size, so only the
+  // one-pass bound can end the sweep
+  g_ceph_context->_conf.set_val("bluestore_cache_clock_trim_batch", "1");
+  g_ceph_context->_conf.set_val("bluestore_cache_trim_max_skip_pinned",
+				"1000");
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  BlueStore store(g_ceph_context, "", 4096);
+  BlueStore::Cache *cache = BlueStore::Cache::create(
+    g_ceph_context, "clock", NULL);
+  BlueStore::CollectionRef coll(
+    new BlueStore::Collection(&store, cache, coll_t()));
+
+  const unsigned num = 100;
+  vector<BlueStore::OnodeRef> pinned;
+  for (unsigned i = 0; i < num; ++i) {
+    ghobject_t oid(hobject_t(sobject_t("obj" + stringify(i), CEPH_NOSNAP)));
+    BlueStore::OnodeRef o(
+      new BlueStore::Onode(coll.get(), oid, stringify(i).c_str()));
+    pinned.push_back(coll->onode_map.add(oid, o));
+    cache->_touch_onode(pinned.back());
+  }
+  ASSERT_EQ(num, cache->_get_num_onodes());
+
+  // every onode is pinned and referenced: trim must still return
+  cache->trim(0, 0);
+  ASSERT_EQ(num, cache->_get_num_onodes());
+  cache->trim(0, 0);
+  ASSERT_EQ(num, cache->_get_num_onodes());
+
+  // once unpinned (and with their reference bits cleared) they all go
+  pinned.clear();
+  cache->trim(0, 0);
+  ASSERT_EQ(0u, cache->_get_num_onodes());
+
+  g_ceph_context->_conf.rm_val("bluestore_cache_clock_trim_batch");
+  g_ceph_context->_conf.rm_val("bluestore_cache_trim_max_skip_pinned");
+  g_ceph_context->_conf.apply_changes(nullptr);
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
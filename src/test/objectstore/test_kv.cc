@@ -17,6 +17,8 @@
 #include <iostream>
 #include <time.h>
 #include <sys/mount.h>
+#include <algorithm>
+#include <thread>
 #include "kv/KeyValueDB.h"
 #include "include/Context.h"
 #include "common/ceph_argparse.h"
@@ -119,6 +121,137 @@ TEST_P(KVTest, OpenWriteRead) {
   fini();
 }
 
+TEST_P(KVTest, GetBatch) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("value");
+    t->set("prefix", "key", value);
+    t->set("prefix", "key3", value);
+    t->set("other", "key2", value);
+    t->set("prefix", "empty", bufferlist());
+    db->submit_transaction_sync(t);
+  }
+  {
+    vector<string> keys = { "key3", "key2", "empty", "key", "missing" };
+    vector<bufferlist> values;
+    vector<bool> found;
+    ASSERT_EQ(0, db->get_batch("prefix", keys, &values, &found));
+    ASSERT_EQ(keys.size(), values.size());
+    ASSERT_EQ(keys.size(), found.size());
+    ASSERT_TRUE(found[0]);
+    ASSERT_EQ(string("value"), values[0].to_str());
+    ASSERT_FALSE(found[1]);  // lives under another prefix
+    ASSERT_TRUE(found[2]);
+    ASSERT_EQ(0u, values[2].length());
+    ASSERT_TRUE(found[3]);
+    ASSERT_EQ(string("value"), values[3].to_str());
+    ASSERT_FALSE(found[4]);
+
+    keys.clear();
+    ASSERT_EQ(0, db->get_batch("prefix", keys, &values, &found));
+    ASSERT_TRUE(values.empty());
+    ASSERT_TRUE(found.empty());
+  }
+  fini();
+}
+
+TEST_P(KVTest, IterateAcrossPrefixes) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("value");
+    t->set("a", "2", value);
+    t->set("a", "1", value);
+    t->set("ab", "0", value);
+    t->set("c", "9", value);
+    db->submit_transaction_sync(t);
+  }
+  vector<pair<string,string>> expected = {
+    {"a", "1"}, {"a", "2"}, {"ab", "0"}, {"c", "9"} };
+  {
+    KeyValueDB::WholeSpaceIterator it = db->get_wholespace_iterator();
+    vector<pair<string,string>> got;
+    for (it->seek_to_first(); it->valid(); it->next()) {
+      got.push_back(it->raw_key());
+    }
+    ASSERT_EQ(expected, got);
+    got.clear();
+    for (it->seek_to_last(); it->valid(); it->prev()) {
+      got.push_back(it->raw_key());
+    }
+    std::reverse(got.begin(), got.end());
+    ASSERT_EQ(expected, got);
+
+    ASSERT_EQ(0, it->upper_bound("a", "2"));
+    ASSERT_EQ(make_pair(string("ab"), string("0")), it->raw_key());
+    ASSERT_EQ(0, it->lower_bound("b", ""));
+    ASSERT_EQ(make_pair(string("c"), string("9")), it->raw_key());
+  }
+  {
+    // keep iterating while the current key is removed underneath us
+    KeyValueDB::Iterator it = db->get_iterator("a");
+    ASSERT_EQ(0, it->seek_to_first());
+    ASSERT_EQ("1", it->key());
+    KeyValueDB::Transaction t = db->get_transaction();
+    t->rmkey("a", "1");
+    db->submit_transaction_sync(t);
+    it->next();
+    ASSERT_TRUE(it->valid());
+    ASSERT_EQ("2", it->key());
+    it->next();
+    ASSERT_FALSE(it->valid());
+  }
+  fini();
+}
+
+TEST_P(KVTest, ConcurrentReadWrite) {
+  ASSERT_EQ(0, db->create_and_open(cout));
+  const int num_keys = 1000;
+  std::atomic<bool> stop = { false };
+  std::thread writer([&] {
+    for (int i = 0; i < num_keys; ++i) {
+      KeyValueDB::Transaction t = db->get_transaction();
+      bufferlist value;
+      value.append(stringify(i));
+      // both halves of a transaction must become visible together
+      t->set("p", stringify(i), value);
+      t->set("q", stringify(i), value);
+      db->submit_transaction(t);
+    }
+    stop = true;
+  });
+  std::vector<std::thread> readers;
+  std::atomic<int> bad = { 0 };
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      while (!stop) {
+	KeyValueDB::Iterator it = db->get_iterator("q");
+	string last;
+	for (it->seek_to_first(); it->valid(); it->next()) {
+	  if (!last.empty() && it->key() <= last) {
+	    ++bad;
+	  }
+	  last = it->key();
+	  bufferlist v;
+	  if (db->get("p", it->key(), &v) < 0 ||
+	      _bl_to_str(v) != it->key()) {
+	    ++bad;
+	  }
+	}
+      }
+    });
+  }
+  writer.join();
+  for (auto& t : readers) {
+    t.join();
+  }
+  ASSERT_EQ(0, bad);
+  fini();
+}
+
 TEST_P(KVTest, PutReopen) {
   ASSERT_EQ(0, db->create_and_open(cout));
   {
@@ -417,6 +550,101 @@ TEST_P(KVTest, RocksDBIteratorTest) {
   fini();
 }
 
+TEST_P(KVTest, RocksDBMigrateToCF) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  std::vector<KeyValueDB::ColumnFamily> cfs;
+  cfs.push_back(KeyValueDB::ColumnFamily(
+    "cf1", "block_cache_ratio=0.1;write_buffer_size=1048576"));
+  ASSERT_EQ(0, db->init(g_conf()->bluestore_rocksdb_options));
+  cout << "creating db without column families" << std::endl;
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("value");
+    for (int i = 0; i < 3000; ++i) {
+      t->set("cf1", stringify(i), value);
+    }
+    t->set("prefix", "key", value);
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  cout << "migrating prefix cf1 into its own column family" << std::endl;
+  ASSERT_EQ(0, db->migrate_to_column_family(cfs.front(), cout));
+  ASSERT_TRUE(db->is_column_family("cf1"));
+  // a second run finds no key of the prefix left in the default column
+  // family, so it has nothing to move
+  {
+    stringstream ss;
+    ASSERT_EQ(0, db->migrate_to_column_family(cfs.front(), ss));
+    cout << ss.str();
+    ASSERT_NE(string::npos, ss.str().find("moved 0 keys"));
+  }
+  fini();
+
+  init();
+  ASSERT_EQ(0, db->open(cout, cfs));
+  ASSERT_TRUE(db->is_column_family("cf1"));
+  {
+    KeyValueDB::Iterator iter = db->get_iterator("cf1");
+    int n = 0;
+    for (iter->seek_to_first(); iter->valid(); iter->next()) {
+      ASSERT_EQ("value", _bl_to_str(iter->value()));
+      ++n;
+    }
+    ASSERT_EQ(3000, n);
+    bufferlist v;
+    ASSERT_EQ(0, db->get("prefix", "key", &v));
+    ASSERT_EQ("value", _bl_to_str(v));
+  }
+  fini();
+}
+
+TEST_P(KVTest, RocksDBPrefixStats) {
+  if(string(GetParam()) != "rocksdb")
+    return;
+
+  ASSERT_EQ(0, db->create_and_open(cout));
+  {
+    KeyValueDB::Transaction t = db->get_transaction();
+    bufferlist value;
+    value.append("value");
+    t->set("O", "a", value);
+    t->set("O", "b", value);
+    t->set("O", "c", value);
+    t->rmkey("O", "c");
+    t->set("unlisted", "a", value);
+    ASSERT_EQ(0, db->submit_transaction_sync(t));
+  }
+  bufferlist v;
+  ASSERT_EQ(0, db->get("O", "a", &v));
+  ASSERT_EQ(-ENOENT, db->get("O", "c", &v));
+  {
+    KeyValueDB::Iterator it = db->get_iterator("O");
+    it->seek_to_first();
+  }
+
+  auto dump = [](const string& logger) {
+    JSONFormatter f;
+    g_ceph_context->get_perfcounters_collection()->dump_formatted(
+      &f, false, logger);
+    stringstream ss;
+    f.flush(ss);
+    return ss.str();
+  };
+  string o = dump("rocksdb_prefix_O");
+  ASSERT_NE(string::npos, o.find("\"set\":3"));
+  ASSERT_NE(string::npos, o.find("\"set_bytes\":15"));
+  ASSERT_NE(string::npos, o.find("\"rmkey\":1"));
+  ASSERT_NE(string::npos, o.find("\"get\":2"));
+  ASSERT_NE(string::npos, o.find("\"get_bytes\":5"));
+  ASSERT_NE(string::npos, o.find("\"seek\":1"));
+  string other = dump("rocksdb_prefix_other");
+  ASSERT_NE(string::npos, other.find("\"set\":1"));
+  fini();
+}
+
 TEST_P(KVTest, RocksDBCFMerge) {
   if(string(GetParam()) != "rocksdb")
     return;
@@ -17,6 +17,7 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "test/erasure-code/ErasureCodeExample.h"
 #include "gtest/gtest.h"
 
 TEST(ECUtil, stripe_info_t)
@@ -58,3 +59,241 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+TEST(ECUtil, offset_len_to_chunk_extents)
+{
+  const uint64_t csize = 65536;
+  ECUtil::stripe_info_t s(4, 4 * csize);
+
+  // a small read only touches one chunk, widened to the alignment
+  {
+    map<int, interval_set<uint64_t> > out;
+    s.offset_len_to_chunk_extents(make_pair(csize + 100, (uint64_t)10),
+				  4096, &out);
+    ASSERT_EQ(1u, out.size());
+    ASSERT_EQ(1u, out[1].num_intervals());
+    ASSERT_EQ(0u, out[1].range_start());
+    ASSERT_EQ(4096u, out[1].range_end());
+  }
+
+  // crossing chunk and stripe boundaries
+  {
+    map<int, interval_set<uint64_t> > out;
+    s.offset_len_to_chunk_extents(
+      make_pair(4 * csize - 8192, (uint64_t)16384), 4096, &out);
+    ASSERT_EQ(2u, out.size());
+    ASSERT_EQ(csize - 8192, out[3].range_start());
+    ASSERT_EQ(csize, out[3].range_end());
+    ASSERT_EQ(csize, out[0].range_start());
+    ASSERT_EQ(csize + 8192, out[0].range_end());
+  }
+
+  // consecutive stripes are merged, overlapping pieces are not counted twice
+  {
+    map<int, interval_set<uint64_t> > out;
+    s.offset_len_to_chunk_extents(make_pair((uint64_t)0, 8 * csize), 4096,
+				  &out);
+    s.offset_len_to_chunk_extents(make_pair(8 * csize - 1, (uint64_t)2),
+				  4096, &out);
+    ASSERT_EQ(4u, out.size());
+    ASSERT_EQ(1u, out[0].num_intervals());
+    ASSERT_EQ(2 * csize + 4096, (uint64_t)out[0].size());
+    for (int i = 1; i < 3; ++i) {
+      ASSERT_EQ(1u, out[i].num_intervals());
+      ASSERT_EQ(2 * csize, (uint64_t)out[i].size());
+    }
+    ASSERT_EQ(1u, out[3].num_intervals());
+    ASSERT_EQ(0u, out[3].range_start());
+    ASSERT_EQ(2 * csize, out[3].range_end());
+  }
+
+  // an alignment of a whole chunk reads full chunks
+  {
+    map<int, interval_set<uint64_t> > out;
+    s.offset_len_to_chunk_extents(make_pair(2 * csize + 1, (uint64_t)1),
+				  csize, &out);
+    ASSERT_EQ(1u, out.size());
+    ASSERT_EQ(0u, out[2].range_start());
+    ASSERT_EQ(csize, out[2].range_end());
+  }
+}
+
+
+namespace {
+// an object striped over the two data chunks and the XOR coding chunk of
+// ErasureCodeExample, read the way CallClientPartialContexts does
+struct PartialReadObject {
+  static constexpr uint64_t csize = 8192;
+  static constexpr uint64_t align = 4096;
+  ErasureCodeInterfaceRef ec_impl;
+  ECUtil::stripe_info_t sinfo;
+  bufferptr data;
+  map<int, bufferptr> shards;
+  map<int, extent_set> last_plan;
+
+  explicit PartialReadObject(uint64_t stripes)
+    : ec_impl(new ErasureCodeExample),
+      sinfo(2, 2 * csize),
+      data(stripes * 2 * csize) {
+    for (unsigned i = 0; i < data.length(); ++i) {
+      data.c_str()[i] = (char)(i * 31 + i / 7);
+    }
+    for (int i = 0; i < 3; ++i) {
+      shards[i] = bufferptr(stripes * csize);
+    }
+    for (uint64_t s = 0; s < stripes; ++s) {
+      for (uint64_t j = 0; j < csize; ++j) {
+	char a = data.c_str()[s * 2 * csize + j];
+	char b = data.c_str()[s * 2 * csize + csize + j];
+	shards[0].c_str()[s * csize + j] = a;
+	shards[1].c_str()[s * csize + j] = b;
+	shards[2].c_str()[s * csize + j] = a ^ b;
+      }
+    }
+  }
+
+  // plan the read of [off, off + len) from the shards in have, read what
+  // the plan asks for, then decode and reassemble it
+  int read(uint64_t off, uint64_t len, const set<int> &have,
+	   bufferlist *out) {
+    extent_set extents;
+    extents.insert(off, len);
+    map<int, extent_set> wanted;
+    ECBackend::partial_read_chunks(sinfo, ec_impl->get_chunk_mapping(),
+				   align, extents, &wanted);
+    map<int, vector<pair<int, int>>> sources;
+    last_plan.clear();
+    int r = ECBackend::plan_partial_read(ec_impl, wanted, have, &sources,
+					 &last_plan);
+    if (r < 0)
+      return r;
+    map<int, extent_map> chunks;
+    for (auto &&i : last_plan) {
+      EXPECT_TRUE(have.count(i.first));
+      for (auto j = i.second.begin(); j != i.second.end(); ++j) {
+	bufferlist bl;
+	bl.append(bufferptr(shards[i.first], j.get_start(), j.get_len()));
+	chunks[i.first].insert(j.get_start(), j.get_len(), std::move(bl));
+      }
+    }
+    r = ECBackend::decode_partial(ec_impl, wanted, &chunks);
+    if (r < 0)
+      return r;
+    extent_map result;
+    uint64_t bytes = ECBackend::assemble_partial(
+      sinfo, ec_impl->get_chunk_mapping(), extents, chunks, &result);
+    EXPECT_EQ(len, bytes);
+    auto range = result.get_containing_range(off, len);
+    if (range.first == range.second)
+      return -EIO;
+    *out = range.first.get_val();
+    return 0;
+  }
+
+  bool matches(uint64_t off, uint64_t len, const bufferlist &bl) {
+    bufferlist expected;
+    expected.append(data.c_str() + off, len);
+    return bl.contents_equal(expected);
+  }
+};
+}
+
+TEST(ECBackend, partial_read_unaligned)
+{
+  PartialReadObject o(4);
+  const set<int> all = {0, 1, 2};
+  bufferlist bl;
+  ASSERT_EQ(0, o.read(100, 5000, all, &bl));
+  ASSERT_TRUE(o.matches(100, 5000, bl));
+  // only the aligned range of the first chunk is read
+  ASSERT_EQ(1u, o.last_plan.size());
+  ASSERT_EQ(0u, o.last_plan[0].range_start());
+  ASSERT_EQ(8192u, o.last_plan[0].range_end());
+
+  bl.clear();
+  ASSERT_EQ(0, o.read(o.csize + 4097, 1, all, &bl));
+  ASSERT_TRUE(o.matches(o.csize + 4097, 1, bl));
+  ASSERT_EQ(1u, o.last_plan.size());
+  ASSERT_EQ(4096u, o.last_plan[1].range_start());
+  ASSERT_EQ(8192u, o.last_plan[1].range_end());
+}
+
+TEST(ECBackend, partial_read_cross_stripe)
+{
+  PartialReadObject o(4);
+  const set<int> all = {0, 1, 2};
+  const uint64_t off = 2 * o.csize - 100;
+  const uint64_t len = 2 * o.csize + 200;
+  bufferlist bl;
+  ASSERT_EQ(0, o.read(off, len, all, &bl));
+  ASSERT_TRUE(o.matches(off, len, bl));
+  // the data chunks are read directly, the coding chunk is not needed
+  ASSERT_EQ(2u, o.last_plan.size());
+  ASSERT_FALSE(o.last_plan.count(2));
+
+  bl.clear();
+  ASSERT_EQ(0, o.read(0, 4 * 2 * o.csize, all, &bl));
+  ASSERT_TRUE(o.matches(0, 4 * 2 * o.csize, bl));
+}
+
+TEST(ECBackend, partial_read_degraded)
+{
+  PartialReadObject o(4);
+  const set<int> have = {0, 2};
+  bufferlist bl;
+
+  // entirely within the missing chunk
+  ASSERT_EQ(0, o.read(o.csize + 100, 3000, have, &bl));
+  ASSERT_TRUE(o.matches(o.csize + 100, 3000, bl));
+  ASSERT_EQ(2u, o.last_plan.size());
+  ASSERT_EQ(o.last_plan[0], o.last_plan[2]);
+
+  // across both chunks and a stripe boundary
+  bl.clear();
+  ASSERT_EQ(0, o.read(o.csize - 10, 3 * o.csize, have, &bl));
+  ASSERT_TRUE(o.matches(o.csize - 10, 3 * o.csize, bl));
+
+  // not enough shards to decode
+  ASSERT_GT(0, o.read(0, 100, {2}, &bl));
+}
+
+TEST(ECBackend, partial_read_replan)
+{
+  PartialReadObject o(4);
+  const uint64_t off = 100;
+  const uint64_t len = 3 * o.csize;
+  bufferlist bl;
+
+  // the first plan reads both data chunks
+  ASSERT_EQ(0, o.read(off, len, {0, 1, 2}, &bl));
+  ASSERT_TRUE(o.last_plan.count(0));
+  ASSERT_FALSE(o.last_plan.count(2));
+
+  // shard 0 returns an error: the read is planned again without it, and
+  // its ranges are decoded from the others
+  bl.clear();
+  ASSERT_EQ(0, o.read(off, len, {1, 2}, &bl));
+  ASSERT_FALSE(o.last_plan.count(0));
+  ASSERT_TRUE(o.last_plan.count(2));
+  ASSERT_TRUE(o.matches(off, len, bl));
+}
+
+TEST(ECBackend, decode_partial_eio)
+{
+  ErasureCodeInterfaceRef ec_impl(new ErasureCodeExample);
+  map<int, extent_set> wanted;
+  wanted[0].insert(0, 4096);
+
+  map<int, extent_map> chunks;
+  ASSERT_EQ(-EIO, ECBackend::decode_partial(ec_impl, wanted, &chunks));
+
+  bufferlist bl;
+  bl.append_zero(4096);
+  chunks[1].insert(0, 4096, bl);
+  ASSERT_EQ(-EIO, ECBackend::decode_partial(ec_impl, wanted, &chunks));
+
+  // a short read does not cover the range either
+  bufferlist shortbl;
+  shortbl.append_zero(1024);
+  chunks[2].insert(0, 1024, shortbl);
+  ASSERT_EQ(-EIO, ECBackend::decode_partial(ec_impl, wanted, &chunks));
+}
@@ -182,3 +182,65 @@ TEST_F(MClockOpClassQueueTest, TestRemoveByClass) {
   r = q.dequeue();
   ASSERT_EQ(104u, r.get_map_epoch());
 }
+
+
+TEST(MClockOpClassClientInfoMgrTest, TestProfile) {
+  using ceph::mclock::osd_op_type_t;
+
+  g_ceph_context->_conf.set_val("osd_mclock_profile", "balanced");
+  g_ceph_context->_conf.set_val("osd_mclock_cost_per_io_usec", "100");
+  g_ceph_context->_conf.set_val("osd_mclock_cost_per_byte_usec", "0.01");
+  ceph::mclock::OpClassClientInfoMgr mgr(g_ceph_context, false);
+
+  // 10000 small IOs per second, a 1 MiB op is worth 105 of them
+  ASSERT_EQ(1u, mgr.calc_cost(0));
+  ASSERT_EQ(105u, mgr.calc_cost(1 << 20));
+
+  auto recov = mgr.get_client_info(osd_op_type_t::bg_recovery);
+  ASSERT_DOUBLE_EQ(4000.0, recov->reservation);
+  ASSERT_DOUBLE_EQ(7000.0, recov->limit);
+  auto scrub = mgr.get_client_info(osd_op_type_t::bg_scrub);
+  ASSERT_DOUBLE_EQ(0.0, scrub->reservation);
+  ASSERT_DOUBLE_EQ(2000.0, scrub->limit);
+
+  // each of 4 op queue shards gets a quarter of the device
+  ceph::mclock::OpClassClientInfoMgr sharded(g_ceph_context, false, 4);
+  auto sharded_recov = sharded.get_client_info(osd_op_type_t::bg_recovery);
+  ASSERT_DOUBLE_EQ(1000.0, sharded_recov->reservation);
+  ASSERT_DOUBLE_EQ(1750.0, sharded_recov->limit);
+
+  // switching profile updates the ClientInfo the queue points to
+  g_ceph_context->_conf.set_val("osd_mclock_profile", "high_recovery_ops");
+  mgr.update();
+  ASSERT_EQ(recov, mgr.get_client_info(osd_op_type_t::bg_recovery));
+  ASSERT_DOUBLE_EQ(6000.0, recov->reservation);
+  ASSERT_DOUBLE_EQ(0.0, recov->limit);
+
+  g_ceph_context->_conf.set_val("osd_mclock_profile", "custom");
+  mgr.update();
+  ASSERT_DOUBLE_EQ(g_ceph_context->_conf->osd_op_queue_mclock_recov_res,
+		   recov->reservation);
+
+  g_ceph_context->_conf.rm_val("osd_mclock_cost_per_io_usec");
+  g_ceph_context->_conf.rm_val("osd_mclock_cost_per_byte_usec");
+}
+
+TEST(MClockOpClassClientInfoMgrTest, TestCostLimits) {
+  // a zero or negative cost per io is rejected by the options
+  ASSERT_NE(0, g_ceph_context->_conf.set_val("osd_mclock_cost_per_io_usec_ssd",
+					     "0"));
+  ASSERT_NE(0, g_ceph_context->_conf.set_val("osd_mclock_cost_per_io_usec_hdd",
+					     "-1"));
+  ASSERT_NE(0, g_ceph_context->_conf.set_val(
+	      "osd_mclock_cost_per_byte_usec_ssd", "-1"));
+
+  // an absurdly expensive op saturates instead of wrapping around
+  g_ceph_context->_conf.set_val("osd_mclock_cost_per_io_usec", "0.000001");
+  g_ceph_context->_conf.set_val("osd_mclock_cost_per_byte_usec", "1000");
+  ceph::mclock::OpClassClientInfoMgr mgr(g_ceph_context, false);
+  ASSERT_EQ(1u, mgr.calc_cost(0));
+  ASSERT_EQ(std::numeric_limits<unsigned>::max(), mgr.calc_cost(1 << 30));
+
+  g_ceph_context->_conf.rm_val("osd_mclock_cost_per_io_usec");
+  g_ceph_context->_conf.rm_val("osd_mclock_cost_per_byte_usec");
+}
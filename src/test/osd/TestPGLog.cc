@@ -25,6 +25,7 @@
 #include "osd/PGLog.h"
 #include "osd/OSDMap.h"
 #include "include/coredumpctl.h"
+#include "common/ceph_json.h"
 #include "../objectstore/store_test_fixture.h"
 
 
@@ -2454,6 +2455,8 @@ public:
     EXPECT_EQ(log.dups.size(), log.dup_index.size());
     for (auto& i : log.dups) {
       EXPECT_EQ(1u, log.dup_index.count(i.reqid));
+      // the index must point into log.dups, not at a copy
+      EXPECT_EQ(&i, log.dup_index[i.reqid]);
     }
   }
 
@@ -2984,6 +2987,70 @@ TEST(pg_log_dup_t, get_key_name) {
   EXPECT_EQ("dup_0000001234.00000000000000005678", a_key_name);
 }
 
+// the osd_pglog bytes reported by dump_mempools
+static uint64_t dump_mempools_osd_pglog_bytes()
+{
+  JSONFormatter f;
+  f.open_object_section("dump_mempools");
+  mempool::dump(&f);
+  f.close_section();
+  stringstream ss;
+  f.flush(ss);
+  JSONParser parser;
+  EXPECT_TRUE(parser.parse(ss.str().c_str(), ss.str().size()));
+  JSONObj *pool = parser.find_obj("mempool")->find_obj("by_pool")
+    ->find_obj("osd_pglog");
+  return std::stoull(pool->find_obj("bytes")->get_data());
+}
+
+TEST(pg_log_entry_t, mempool_bytes) {
+  const unsigned n = 1000;
+  const uint64_t before = dump_mempools_osd_pglog_bytes();
+  {
+    mempool::osd_pglog::list<pg_log_entry_t> log;
+    for (unsigned i = 1; i <= n; ++i) {
+      log.push_back(pg_log_entry_t(
+	pg_log_entry_t::MODIFY, PGLogTestBase::mk_obj(i),
+	eversion_t(1, i), eversion_t(1, i - 1), i,
+	osd_reqid_t(entity_name_t::CLIENT(777), 8, i), utime_t(), 0));
+      log.back().mark_unrollbackable();
+    }
+    // without rollback info or snaps an entry costs only its list node
+    const uint64_t plain = dump_mempools_osd_pglog_bytes();
+    EXPECT_EQ(n * (sizeof(pg_log_entry_t) + 2 * sizeof(void*)),
+	      plain - before);
+    EXPECT_EQ(sizeof(void*), sizeof(pg_log_bl_t));
+
+    // snaps are allocated from osd_pglog when an entry has some
+    unsigned i = 0;
+    for (auto &e : log) {
+      if (++i % 2)
+	continue;
+      e.op = pg_log_entry_t::CLONE;
+      vector<snapid_t> snaps = {snapid_t(i)};
+      encode(snaps, e.snaps.get_mutable());
+      e.snaps.reassign_to_mempool(mempool::mempool_osd_pglog);
+    }
+    const uint64_t cloned = dump_mempools_osd_pglog_bytes();
+    EXPECT_LE(plain + n / 2 * sizeof(pg_log_bl_t::slot_t), cloned);
+
+    // and survive a round trip
+    bufferlist bl;
+    encode(*std::next(log.begin()), bl);
+    pg_log_entry_t e;
+    auto p = bl.cbegin();
+    decode(e, p);
+    ASSERT_TRUE(e.is_clone());
+    vector<snapid_t> snaps;
+    auto q = e.snaps.get().cbegin();
+    decode(snaps, q);
+    ASSERT_EQ(vector<snapid_t>{snapid_t(2)}, snaps);
+    ASSERT_EQ(0u, e.mod_desc.bl.length());
+  }
+  // and all of it is released with the log
+  EXPECT_EQ(before, dump_mempools_osd_pglog_bytes());
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
@@ -122,3 +122,63 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+TEST(ectransaction, parity_delta_candidates)
+{
+  hobject_t h;
+  ECUtil::stripe_info_t sinfo(4, 16384);
+  auto get_hinfo = [&](const hobject_t &i) {
+    ECUtil::HashInfoRef ref(new ECUtil::HashInfo(6));
+    ref->set_projected_total_logical_size(sinfo, 1 << 20);
+    return ref;
+  };
+
+  // a small overwrite within a single chunk
+  auto small_write = [&]() {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(1024);
+    t->write(h, 16384 + 512, a.length(), a, 0);
+    return t;
+  };
+
+  auto plan = ECTransaction::get_write_plan(
+    sinfo, small_write(), get_hinfo, &dpp);
+  generic_derr << "to_read " << plan.to_read << dendl;
+  ASSERT_EQ(1u, plan.to_read.size());
+  ASSERT_EQ(0u, plan.delta_candidates.size());
+  ASSERT_EQ(1024u, plan.overwrite_bytes);
+
+  plan = ECTransaction::get_write_plan(
+    sinfo, small_write(), get_hinfo, &dpp, 2);
+  ASSERT_EQ(1u, plan.to_read.size());
+  ASSERT_EQ(1u, plan.delta_candidates.size());
+  ASSERT_EQ(1024u, plan.delta_candidates[h].size());
+  ASSERT_EQ(1u, ECTransaction::get_delta_chunks(
+	      sinfo, plan.delta_candidates[h]).size());
+  ASSERT_EQ(1u, ECTransaction::get_delta_stripes(
+	      sinfo, plan.delta_candidates[h]));
+
+  // touching three of the four data chunks reads more than the stripe
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(8192);
+    t->write(h, 16384 + 4095, a.length(), a, 0);
+    plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(1u, plan.to_read.size());
+    ASSERT_EQ(0u, plan.delta_candidates.size());
+  }
+
+  // appends are never candidates
+  {
+    PGTransactionUPtr t(new PGTransaction);
+    bufferlist a;
+    a.append_zero(1024);
+    t->write(h, (1 << 20) - 512, a.length(), a, 0);
+    plan = ECTransaction::get_write_plan(
+      sinfo, std::move(t), get_hinfo, &dpp, 2);
+    ASSERT_EQ(0u, plan.delta_candidates.size());
+  }
+}
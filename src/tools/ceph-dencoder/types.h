@@ -152,6 +152,7 @@ TYPE(bluestore_blob_use_tracker_t)
 TYPE(bluestore_onode_t)
 TYPE(bluestore_deferred_op_t)
 TYPE(bluestore_deferred_transaction_t)
+TYPE(bluestore_alloc_snapshot_t)
 // TYPE(bluestore_compression_header_t) there is no encode here
 
 #include "os/bluestore/bluefs_types.h"